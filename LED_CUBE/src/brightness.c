@@ -0,0 +1,93 @@
+/*
+ * brightness.c
+ *
+ * Description: Ambient-adaptive global brightness controller.
+ */
+
+#include "brightness.h"
+
+// Ambient lux -> target scaler, interpolated linearly between points
+static const struct {
+    uint32_t lux;
+    uint16_t scaler;
+} brightnessCurve[] = {
+    {0,    BRIGHTNESS_MIN},
+    {10,   64},
+    {50,   128},
+    {200,  200},
+    {1000, BRIGHTNESS_FULL}
+};
+
+#define CURVE_POINTS (sizeof(brightnessCurve) / sizeof(brightnessCurve[0]))
+
+static uint16_t current = BRIGHTNESS_FULL;
+static uint16_t manual = BRIGHTNESS_FULL;
+static uint8_t autoMode = 1;
+
+/**
+ * Enables or disables automatic brightness.
+ *
+ * Parameters:
+ * on - 1 for automatic, 0 for manual.
+ */
+void brightness_set_auto(int on) {
+    autoMode = on ? 1 : 0;
+}
+
+/**
+ * Sets the manual brightness and switches to manual mode.
+ *
+ * Parameters:
+ * scaler - Brightness, 0 to BRIGHTNESS_FULL.
+ */
+void brightness_set_manual(uint16_t scaler) {
+    manual = (scaler > BRIGHTNESS_FULL) ? BRIGHTNESS_FULL : scaler;
+    autoMode = 0;
+}
+
+/**
+ * Maps an ambient level to its target scaler.
+ */
+static uint16_t target_for(uint32_t lux) {
+    if (lux >= brightnessCurve[CURVE_POINTS - 1].lux) {
+        return brightnessCurve[CURVE_POINTS - 1].scaler;
+    }
+    for (unsigned i = 1; i < CURVE_POINTS; i++) {
+        if (lux < brightnessCurve[i].lux) {
+            uint32_t x0 = brightnessCurve[i - 1].lux, x1 = brightnessCurve[i].lux;
+            int32_t y0 = brightnessCurve[i - 1].scaler, y1 = brightnessCurve[i].scaler;
+            return (uint16_t)(y0 + ((y1 - y0) * (int32_t)(lux - x0)) / (int32_t)(x1 - x0));
+        }
+    }
+    return BRIGHTNESS_FULL;
+}
+
+/**
+ * Feeds one ambient measurement and moves the scaler towards its target by at most
+ * BRIGHTNESS_MAX_STEP.
+ *
+ * Parameters:
+ * lux - Ambient illuminance.
+ *
+ * Returns:
+ * uint16_t - The scaler to apply, 0 to BRIGHTNESS_FULL.
+ */
+uint16_t brightness_update(uint32_t lux) {
+    uint16_t target = autoMode ? target_for(lux) : manual;
+
+    if (target > current + BRIGHTNESS_MAX_STEP) {
+        current += BRIGHTNESS_MAX_STEP;
+    } else if (target + BRIGHTNESS_MAX_STEP < current) {
+        current -= BRIGHTNESS_MAX_STEP;
+    } else {
+        current = target;
+    }
+    return current;
+}
+
+/**
+ * Returns the current scaler, 0 to BRIGHTNESS_FULL.
+ */
+uint16_t brightness_get(void) {
+    return current;
+}
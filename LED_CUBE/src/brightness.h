@@ -0,0 +1,53 @@
+/*
+ * brightness.h
+ *
+ * Description: Ambient-adaptive global brightness controller.
+ * Ambient illuminance from the colour sensor is mapped to a brightness scaler that the
+ * LED refresh applies to the PWM levels, so no framebuffer content is rewritten. Changes
+ * are rate limited to avoid visible flicker.
+ */
+
+#ifndef SRC_BRIGHTNESS_H_
+#define SRC_BRIGHTNESS_H_
+
+#include "stdint.h"
+
+#define BRIGHTNESS_FULL      256 // Scaler for full brightness (Q8)
+#define BRIGHTNESS_MIN       24  // Never dimmer than this
+#define BRIGHTNESS_MAX_STEP  6   // Largest scaler change per update
+#define BRIGHTNESS_PERIOD_MS 100 // Update interval
+
+/**
+ * Enables or disables automatic brightness. When disabled the scaler holds the
+ * manual value from brightness_set_manual().
+ *
+ * Parameters:
+ * on - 1 for automatic, 0 for manual.
+ */
+void brightness_set_auto(int on);
+
+/**
+ * Sets the manual brightness and switches to manual mode.
+ *
+ * Parameters:
+ * scaler - Brightness, 0 to BRIGHTNESS_FULL.
+ */
+void brightness_set_manual(uint16_t scaler);
+
+/**
+ * Feeds one ambient measurement and moves the scaler towards its target.
+ *
+ * Parameters:
+ * lux - Ambient illuminance.
+ *
+ * Returns:
+ * uint16_t - The scaler to apply, 0 to BRIGHTNESS_FULL.
+ */
+uint16_t brightness_update(uint32_t lux);
+
+/**
+ * Returns the current scaler, 0 to BRIGHTNESS_FULL.
+ */
+uint16_t brightness_get(void);
+
+#endif /* SRC_BRIGHTNESS_H_ */
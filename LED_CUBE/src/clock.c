@@ -0,0 +1,188 @@
+/*
+ * clock.c
+ *
+ * Description: System clock profiles and queries, read back from the RCC configuration.
+ */
+
+#include "clock.h"
+#include "stm32f4xx.h"
+#include "i2c.h"
+#include "uart.h"
+#include "led.h"
+
+// RCC_CFGR prescaler field values
+#define HPRE_DIV1  0x0UL
+#define HPRE_DIV4  0x9UL
+#define PPRE_DIV1  0x0UL
+#define PPRE_DIV2  0x4UL
+
+// PWR_CR VOS field values
+#define VOS_SCALE3 0x1UL // HCLK up to 64 MHz
+#define VOS_SCALE1 0x3UL // HCLK up to 100 MHz
+
+// PLL for 100 MHz from HSI: VCO in 16 / 8 = 2 MHz, VCO 2 * 200 = 400 MHz, SYSCLK 400 / 4
+#define PLL_M 8
+#define PLL_N 200
+#define PLL_P 4
+#define PLL_Q 9 // 44 MHz for the unused USB/SDIO clock; must stay at or below 48 MHz
+
+typedef struct {
+    const char *name;
+    uint8_t pll;     // SYSCLK from the PLL rather than HSI
+    uint8_t hpre;    // AHB prescaler
+    uint8_t ppre1;   // APB1 prescaler (APB1 at most 50 MHz)
+    uint8_t latency; // Flash wait states for HCLK at 2.7-3.6 V
+    uint8_t vos;     // Regulator voltage scale
+} clock_profile_def_t;
+
+static const clock_profile_def_t profiles[CLOCK_PROFILE_COUNT] = {
+    [CLOCK_PROFILE_RESET] = {.name = "reset", .pll = 0, .hpre = HPRE_DIV1, .ppre1 = PPRE_DIV1, .latency = 0, .vos = VOS_SCALE3},
+    [CLOCK_PROFILE_PERF]  = {.name = "perf",  .pll = 1, .hpre = HPRE_DIV1, .ppre1 = PPRE_DIV2, .latency = 3, .vos = VOS_SCALE1},
+    [CLOCK_PROFILE_LOW]   = {.name = "low",   .pll = 0, .hpre = HPRE_DIV4, .ppre1 = PPRE_DIV1, .latency = 0, .vos = VOS_SCALE3},
+};
+
+static clock_profile_t current = CLOCK_PROFILE_RESET;
+
+/**
+ * Sets the flash wait states with the ART accelerator's prefetch and caches enabled,
+ * waiting until the new latency is in effect.
+ */
+static void set_flash_latency(uint32_t latency) {
+    FLASH->ACR = FLASH_ACR_PRFTEN | FLASH_ACR_ICEN | FLASH_ACR_DCEN | latency;
+    while ((FLASH->ACR & FLASH_ACR_LATENCY) != latency);
+}
+
+/**
+ * Selects the SYSCLK source and waits until the switch has happened.
+ */
+static void select_sysclk(uint32_t sw, uint32_t sws) {
+    RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_SW) | sw;
+    while ((RCC->CFGR & RCC_CFGR_SWS) != sws);
+}
+
+/**
+ * Moves the clock tree to a profile. Flash latency goes up before the clock does and
+ * down after it; the voltage scale can only change while the PLL is off.
+ */
+static void apply_profile(const clock_profile_def_t *p) {
+    uint32_t prescalers = ((uint32_t)p->hpre << RCC_CFGR_HPRE_Pos) | ((uint32_t)p->ppre1 << RCC_CFGR_PPRE1_Pos) |
+                          (PPRE_DIV1 << RCC_CFGR_PPRE2_Pos);
+
+    // Run from HSI at the slowest settings of either profile while the PLL changes
+    RCC->CR |= RCC_CR_HSION;
+    while (!(RCC->CR & RCC_CR_HSIRDY));
+    if (p->latency > (FLASH->ACR & FLASH_ACR_LATENCY)) {
+        set_flash_latency(p->latency);
+    }
+
+    select_sysclk(RCC_CFGR_SW_HSI, RCC_CFGR_SWS_HSI);
+    RCC->CR &= ~RCC_CR_PLLON;
+    while (RCC->CR & RCC_CR_PLLRDY);
+
+    RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+    PWR->CR = (PWR->CR & ~PWR_CR_VOS) | ((uint32_t)p->vos << PWR_CR_VOS_Pos);
+
+    if (p->pll) {
+        RCC->PLLCFGR = RCC_PLLCFGR_PLLSRC_HSI | (PLL_M << RCC_PLLCFGR_PLLM_Pos) | (PLL_N << RCC_PLLCFGR_PLLN_Pos) |
+                       ((PLL_P / 2 - 1) << RCC_PLLCFGR_PLLP_Pos) | (PLL_Q << RCC_PLLCFGR_PLLQ_Pos);
+        RCC->CR |= RCC_CR_PLLON;
+        while (!(RCC->CR & RCC_CR_PLLRDY));
+        while (!(PWR->CSR & PWR_CSR_VOSRDY));
+        RCC->CFGR = (RCC->CFGR & ~(RCC_CFGR_HPRE | RCC_CFGR_PPRE1 | RCC_CFGR_PPRE2)) | prescalers;
+        select_sysclk(RCC_CFGR_SW_PLL, RCC_CFGR_SWS_PLL);
+    } else {
+        RCC->CFGR = (RCC->CFGR & ~(RCC_CFGR_HPRE | RCC_CFGR_PPRE1 | RCC_CFGR_PPRE2)) | prescalers;
+    }
+    set_flash_latency(p->latency);
+}
+
+/**
+ * Switches the system clock to a profile, then re-derives the SysTick reload, the I2C
+ * timings, the USART2 baud rate and the LED PWM timer for the new clocks. Pending UART
+ * output is sent and I2C transfers are finished first. Call from the main context.
+ *
+ * Parameters:
+ * profile - The profile to switch to.
+ */
+void clock_set_profile(clock_profile_t profile) {
+    i2c_bus_t *const buses[] = {&i2c_bus1, &i2c_bus3};
+
+    if (profile >= CLOCK_PROFILE_COUNT) {
+        return;
+    }
+    // No byte or bus transaction may straddle the switch
+    uart_tx_flush();
+    for (unsigned i = 0; i < sizeof(buses) / sizeof(buses[0]); i++) {
+        if (i2c_get_speed(buses[i]) != 0) { // Only buses that have been initialized
+            i2c_wait_idle(buses[i]);
+        }
+    }
+
+    apply_profile(&profiles[profile]);
+    current = profile;
+
+    SystemCoreClockUpdate();
+    if (SysTick->CTRL & SysTick_CTRL_ENABLE_Msk) {
+        // SysTick_Config() drops the tick to the lowest priority; keep the one it had
+        uint32_t prio = NVIC_GetPriority(SysTick_IRQn);
+        SysTick_Config(SystemCoreClock / 1000); // Keep the 1 ms tick
+        NVIC_SetPriority(SysTick_IRQn, prio);
+    }
+    for (unsigned i = 0; i < sizeof(buses) / sizeof(buses[0]); i++) {
+        if (i2c_get_speed(buses[i]) != 0) {
+            i2c_set_speed(buses[i], i2c_get_speed(buses[i]));
+        }
+    }
+    USART2_ClockChanged();
+    LED_ClockChanged();
+}
+
+/**
+ * Brings the clock tree back to the active profile after Stop mode, which wakes on
+ * HSI with the PLL off. The prescalers survive Stop, so peripheral timings do not
+ * need re-deriving. Safe with interrupts masked.
+ */
+void clock_restore(void) {
+    apply_profile(&profiles[current]);
+}
+
+/**
+ * Returns the active clock profile.
+ */
+clock_profile_t clock_profile(void) {
+    return current;
+}
+
+/**
+ * Returns a profile's name.
+ */
+const char *clock_profile_name(clock_profile_t profile) {
+    return (profile < CLOCK_PROFILE_COUNT) ? profiles[profile].name : "?";
+}
+
+/**
+ * Returns the AHB (HCLK) frequency in Hz.
+ */
+uint32_t clock_hclk_hz(void) {
+    SystemCoreClockUpdate();
+    return SystemCoreClock;
+}
+
+/**
+ * Returns the APB1 (PCLK1) frequency in Hz from HCLK and the PPRE1 prescaler.
+ */
+uint32_t clock_pclk1_hz(void) {
+    uint32_t ppre1 = (RCC->CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos;
+
+    // 0xx: not divided, 1xx: divided by 2, 4, 8, 16
+    return (ppre1 < 4) ? clock_hclk_hz() : clock_hclk_hz() >> (ppre1 - 3);
+}
+
+/**
+ * Returns the clock of the APB1 timers in Hz: PCLK1, doubled whenever APB1 is divided.
+ */
+uint32_t clock_tim_apb1_hz(void) {
+    uint32_t ppre1 = (RCC->CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos;
+
+    return (ppre1 < 4) ? clock_pclk1_hz() : clock_pclk1_hz() * 2;
+}
@@ -0,0 +1,69 @@
+/*
+ * clock.h
+ *
+ * Description: System clock profiles and queries.
+ * Peripheral drivers derive their dividers (USART BRR, I2C CCR) from these values
+ * rather than assuming the 16 MHz reset clock, and clock_set_profile() has them
+ * re-derive their timings after every switch.
+ */
+
+#ifndef SRC_CLOCK_H_
+#define SRC_CLOCK_H_
+
+#include "stdint.h"
+
+#define CLOCK_PROFILE_DEFAULT CLOCK_PROFILE_PERF // Profile set by SystemClock_Config()
+
+/**
+ * Clock profiles. All run from the internal HSI oscillator.
+ */
+typedef enum {
+    CLOCK_PROFILE_RESET, // HSI 16 MHz, APB1 16 MHz, 0 wait states (the reset state)
+    CLOCK_PROFILE_PERF,  // PLL 100 MHz, APB1 50 MHz, 3 wait states, ART prefetch and caches
+    CLOCK_PROFILE_LOW,   // HSI / 4 = 4 MHz, APB1 4 MHz, voltage scale 3, PLL off
+    CLOCK_PROFILE_COUNT
+} clock_profile_t;
+
+/**
+ * Switches the system clock to a profile, then re-derives the SysTick reload, the I2C
+ * timings and the USART2 baud rate for the new clocks. Pending UART output is sent and
+ * I2C transfers are finished first. Call from the main context.
+ *
+ * Parameters:
+ * profile - The profile to switch to.
+ */
+void clock_set_profile(clock_profile_t profile);
+
+/**
+ * Brings the clock tree back to the active profile after Stop mode, which wakes on
+ * HSI with the PLL off. The prescalers survive Stop, so peripheral timings do not
+ * need re-deriving. Safe with interrupts masked.
+ */
+void clock_restore(void);
+
+/**
+ * Returns the active clock profile.
+ */
+clock_profile_t clock_profile(void);
+
+/**
+ * Returns a profile's name.
+ */
+const char *clock_profile_name(clock_profile_t profile);
+
+/**
+ * Returns the AHB (HCLK) frequency in Hz.
+ */
+uint32_t clock_hclk_hz(void);
+
+/**
+ * Returns the APB1 (PCLK1) frequency in Hz, which clocks USART2 and the I2C peripherals.
+ */
+uint32_t clock_pclk1_hz(void);
+
+/**
+ * Returns the clock of the APB1 timers (TIM2-TIM5) in Hz.
+ */
+uint32_t clock_tim_apb1_hz(void);
+
+#endif /* SRC_CLOCK_H_ */
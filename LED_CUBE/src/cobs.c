@@ -0,0 +1,74 @@
+/*
+ * cobs.c
+ *
+ * Description: Consistent Overhead Byte Stuffing.
+ * Each block starts with a code byte n: n - 1 data bytes follow, then an implied zero
+ * unless n is 0xFF. The implied zero of the last block is not part of the packet.
+ */
+
+#include "cobs.h"
+
+/**
+ * Encodes a packet.
+ *
+ * Parameters:
+ * in  - The packet.
+ * len - Its length.
+ * out - Receives COBS_MAX_ENCODED(len) bytes at most; no delimiter is appended.
+ *
+ * Returns:
+ * uint32_t - Number of bytes written.
+ */
+uint32_t cobs_encode(const uint8_t *in, uint32_t len, uint8_t *out) {
+    uint32_t codeIdx = 0, outIdx = 1;
+    uint8_t code = 1;
+
+    for (uint32_t i = 0; i < len; i++) {
+        if (in[i] != 0) {
+            out[outIdx++] = in[i];
+            code++;
+        }
+        if (in[i] == 0 || code == 0xFF) {
+            out[codeIdx] = code;
+            codeIdx = outIdx++;
+            code = 1;
+        }
+    }
+    out[codeIdx] = code;
+    return outIdx;
+}
+
+/**
+ * Feeds one received byte to the decoder.
+ *
+ * Parameters:
+ * dec - Decoder state.
+ * in  - The received byte.
+ * out - Receives a decoded byte when COBS_DATA is returned.
+ *
+ * Returns:
+ * cobs_result_t - What the byte produced.
+ */
+cobs_result_t cobs_decode_byte(cobs_decoder_t *dec, uint8_t in, uint8_t *out) {
+    if (in == COBS_DELIMITER) {
+        cobs_result_t result = (dec->remaining == 0) ? COBS_END : COBS_ERROR;
+        dec->remaining = 0;
+        dec->pendingZero = 0;
+        return result;
+    }
+    if (dec->remaining > 0) {
+        dec->remaining--;
+        *out = in;
+        return COBS_DATA;
+    }
+
+    // Code byte: the previous block's implied zero is real now that more data follows
+    uint8_t zero = dec->pendingZero;
+    dec->remaining = in - 1;
+    dec->pendingZero = (in != 0xFF);
+    if (zero) {
+        *out = 0;
+        return COBS_DATA;
+    }
+    return COBS_NONE;
+}
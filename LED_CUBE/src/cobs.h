@@ -0,0 +1,62 @@
+/*
+ * cobs.h
+ *
+ * Description: Consistent Overhead Byte Stuffing.
+ * Packets are encoded without zero bytes so a single 0x00 can delimit them on a byte
+ * stream. The decoder works one byte at a time, so received data never has to be
+ * buffered in encoded form.
+ */
+
+#ifndef SRC_COBS_H_
+#define SRC_COBS_H_
+
+#include "stdint.h"
+
+#define COBS_DELIMITER 0x00
+#define COBS_MAX_ENCODED(len) ((len) + (len) / 254 + 1) // Worst case, delimiter excluded
+
+/**
+ * Result of feeding one byte to the decoder.
+ */
+typedef enum {
+    COBS_NONE,  // Byte consumed, nothing to output
+    COBS_DATA,  // One decoded byte in *out
+    COBS_END,   // Delimiter: the packet is complete
+    COBS_ERROR  // Delimiter in the middle of a block: the packet is corrupt
+} cobs_result_t;
+
+/**
+ * Incremental decoder state. Zero-initialize before the first byte.
+ */
+typedef struct {
+    uint8_t remaining;   // Data bytes left in the current block
+    uint8_t pendingZero; // The current block ends with an implied zero
+} cobs_decoder_t;
+
+/**
+ * Encodes a packet.
+ *
+ * Parameters:
+ * in  - The packet.
+ * len - Its length.
+ * out - Receives COBS_MAX_ENCODED(len) bytes at most; no delimiter is appended.
+ *
+ * Returns:
+ * uint32_t - Number of bytes written.
+ */
+uint32_t cobs_encode(const uint8_t *in, uint32_t len, uint8_t *out);
+
+/**
+ * Feeds one received byte to the decoder.
+ *
+ * Parameters:
+ * dec - Decoder state.
+ * in  - The received byte.
+ * out - Receives a decoded byte when COBS_DATA is returned.
+ *
+ * Returns:
+ * cobs_result_t - What the byte produced.
+ */
+cobs_result_t cobs_decode_byte(cobs_decoder_t *dec, uint8_t in, uint8_t *out);
+
+#endif /* SRC_COBS_H_ */
@@ -14,61 +14,166 @@
 #include "stdio.h"
 #include "string.h"
 #include "uart.h"
+#include "sensor_state.h"
+#include "color_classify.h"
+#include "color_cal.h"
+#include "color_filter.h"
+#include "color_stats.h"
+#include "color_lux.h"
+#include "timebase.h"
+#include "log.h"
 
-uint16_t r = 0, g = 0, b = 0, c = 0; // Variables to hold color data (red, green, blue, clear)
+static uint32_t classifyCycles; // CPU cycles spent in the last classification
+static color_light_t lastLight;  // Lux and CCT of the last reading
+static uint8_t asyncBuf[8];      // Target of the background read (CDATAL..BDATAH)
+static uint8_t asyncPending;     // Background read started and not yet collected
+static uint32_t sampleCount;     // Readings taken since start-up
+
+// Analog gain factor of each CONTROL AGAIN setting
+static const uint8_t gainFactor[4] = {1, 4, 16, 60};
 
 /**
  * Initializes the TCS34725 color sensor.
  * Sets up the sensor for color detection including power, integration time, and gain control.
  */
 void TCS34725_Init(void) {
-    write_i2c(TCS34725_ADDRESS, (0x80|TCS34725_ENABLE), 0x03); // Power on and enable ADC
-    write_i2c(TCS34725_ADDRESS, (0x80| TCS34725_ATIME), 0xEB);  // Set integration time
-    write_i2c(TCS34725_ADDRESS, (0x80|TCS34725_CONTROL), 0x02); // Set gain control to 16x
+    write_i2c(TCS34725_BUS, TCS34725_ADDRESS, (0x80|TCS34725_ENABLE), 0x03); // Power on and enable ADC
+    write_i2c(TCS34725_BUS, TCS34725_ADDRESS, (0x80| TCS34725_ATIME), TCS34725_ATIME_VALUE);  // Set integration time
+    write_i2c(TCS34725_BUS, TCS34725_ADDRESS, (0x80|TCS34725_CONTROL), TCS34725_GAIN_VALUE); // Set gain control to 16x
 }
 
 /**
  * Reads color data from the TCS34725 sensor and identifies the predominant color.
+ * Readings pass through the temporal filter, so the result only changes once a new
+ * colour has been stable for a while; call it every COLOR_SAMPLE_MS.
  *
  * Returns:
  * PredominantColor - The identified predominant color or UNKNOWN if unable to determine.
  */
 PredominantColor TCS34725_ReadColorAndCheck() {
+    uint16_t r, g, b, c;
+    PredominantColor color = UNKNOWN;
 
     // Read color data from the sensor
-    c = read_i2c_word(TCS34725_ADDRESS, (0x80|TCS34725_CDATAL));
-    r = read_i2c_word(TCS34725_ADDRESS, (0x80|TCS34725_RDATAL));
-    g = read_i2c_word(TCS34725_ADDRESS, (0x80|TCS34725_GDATAL));
-    b = read_i2c_word(TCS34725_ADDRESS, (0x80|TCS34725_BDATAL));
-
-    // Determine the predominant color
-    if(c > 2000) {
-        printf("\n\rUnknown color\n\r");
-        return UNKNOWN;
-    } else if (r > g && r > b) {
-        printf("\n\rDetected color is red\n\r");
-        return RED;
-    } else if (g > r && g > b) {
-        printf("\n\rDetected color is green\n\r");
-        return GREEN;
-    } else if (b > r && b > g) {
-        printf("\n\rDetected color is blue\n\r");
-        return BLUE;
+    TCS34725_ReadColor(&r, &g, &b, &c);
+
+    // Lux and CCT use the raw counts; readings under bad lighting are not classified
+    color_compute_light(r, g, b, c, TCS34725_ATIME_VALUE, gainFactor[TCS34725_GAIN_VALUE & 0x03], &lastLight);
+    color_cal_apply(&r, &g, &b, &c);
+    if (!color_light_ok(&lastLight)) {
+        r = g = b = c = 0; // Below COLOR_CLEAR_MIN, so classified as UNKNOWN
+    }
+    color_stats_add(r, g, b, c, now_ms32());
+
+    // Determine the predominant color, timing the filter and classifier with the DWT cycle counter
+    uint32_t start = DWT->CYCCNT;
+    int changed = color_filter_update(r, g, b, c, now_ms32(), &color);
+    classifyCycles = DWT->CYCCNT - start;
+
+    if (changed) {
+        if (color == UNKNOWN) {
+            LOG0(LOG_COLOR_UNKNOWN);
+        } else {
+            LOG2(LOG_COLOR_DETECTED, color, classifyCycles);
+        }
     }
+
+    // Share the reading with the rest of the firmware
+    sensor_state_t *state = sensor_state_begin();
+    state->r = r;
+    state->g = g;
+    state->b = b;
+    state->c = c;
+    state->lux = lastLight.lux;
+    state->cct = lastLight.cct;
+    state->color = color;
+    sensor_state_publish();
+
+    return color;
+}
+
+/**
+ * Splits the 8 data registers (CDATAL..BDATAH) into channel counts.
+ */
+static void unpack_counts(const uint8_t *buf, uint16_t *r, uint16_t *g, uint16_t *b, uint16_t *c) {
+    *c = buf[0] | (buf[1] << 8);
+    *r = buf[2] | (buf[3] << 8);
+    *g = buf[4] | (buf[5] << 8);
+    *b = buf[6] | (buf[7] << 8);
 }
 
 /**
  * Reads raw color data (red, green, blue, clear) from the TCS34725 sensor.
+ * All four channels come from one auto-increment burst, so they belong to the same
+ * integration cycle.
  *
  * Parameters:
  * r, g, b, c - Pointers to store the read color data.
  */
 void TCS34725_ReadColor(uint16_t *r, uint16_t *g, uint16_t *b, uint16_t *c) {
-    *c = read_i2c_word(TCS34725_ADDRESS, (0x80|TCS34725_CDATAL));
-    *r = read_i2c_word(TCS34725_ADDRESS, (0x80|TCS34725_RDATAL));
-    *g = read_i2c_word(TCS34725_ADDRESS, (0x80|TCS34725_GDATAL));
-    *b = read_i2c_word(TCS34725_ADDRESS, (0x80|TCS34725_BDATAL));
+    uint8_t buf[8];
+
+    read_i2c_burst(TCS34725_BUS, TCS34725_ADDRESS, TCS34725_CMD_AUTOINC | TCS34725_CDATAL, buf, sizeof(buf));
+    unpack_counts(buf, r, g, b, c);
+    sampleCount++;
 
     // Optional: Print color data for debugging
     // printf("\n\rRed: %u, Green: %u, Blue: %u, Clear: %u\n\r", *r, *g, *b, *c);
 }
+
+/**
+ * Tracks the illuminance without classifying and without waiting for the bus.
+ * Collects the background read started by the previous call, if it has finished,
+ * and starts the next one, so the transfer overlaps with whatever runs meanwhile
+ * (gesture polling on the other bus when I2C_SPLIT_BUSES is set).
+ *
+ * Returns:
+ * uint32_t - Ambient illuminance in lux of the latest completed reading.
+ */
+uint32_t TCS34725_ReadLux(void) {
+    if (asyncPending) {
+        i2c_status_t status = i2c_async_poll(TCS34725_BUS);
+        if (status == I2C_BUSY) {
+            return lastLight.lux;
+        }
+        asyncPending = 0;
+        if (status == I2C_DONE) {
+            uint16_t r, g, b, c;
+            unpack_counts(asyncBuf, &r, &g, &b, &c);
+            sampleCount++;
+            color_compute_light(r, g, b, c, TCS34725_ATIME_VALUE, gainFactor[TCS34725_GAIN_VALUE & 0x03], &lastLight);
+
+            sensor_state_t *state = sensor_state_begin();
+            state->lux = lastLight.lux;
+            state->cct = lastLight.cct;
+            sensor_state_publish();
+        }
+    }
+    asyncPending = i2c_read_async(TCS34725_BUS, TCS34725_ADDRESS, TCS34725_CMD_AUTOINC | TCS34725_CDATAL,
+                                  asyncBuf, sizeof(asyncBuf));
+    return lastLight.lux;
+}
+
+/**
+ * Returns the number of readings taken since start-up.
+ */
+uint32_t TCS34725_Samples(void) {
+    return sampleCount;
+}
+
+/**
+ * Returns the CPU cycles spent filtering and classifying the last reading.
+ */
+uint32_t TCS34725_ClassifyCycles(void) {
+    return classifyCycles;
+}
+
+/**
+ * Returns the illuminance and colour temperature of the last reading.
+ *
+ * Parameters:
+ * light - Receives lux, CCT and the saturation flag.
+ */
+void TCS34725_GetLight(color_light_t *light) {
+    *light = lastLight;
+}
@@ -12,10 +12,19 @@
 #define SRC_COLOR_H_
 
 #include "stdint.h"
+#include "color_lux.h"
+#include "i2c.h"
 
 // I2C address for the TCS34725 color sensor
 #define TCS34725_ADDRESS 0x29
 
+// I2C bus the TCS34725 is wired to
+#if I2C_SPLIT_BUSES
+#define TCS34725_BUS (&i2c_bus3)
+#else
+#define TCS34725_BUS (&i2c_bus1)
+#endif
+
 // TCS34725 register addresses
 #define TCS34725_ENABLE  0x00 // Enable register
 #define TCS34725_ATIME   0x01 // Integration time register
@@ -24,9 +33,16 @@
 #define TCS34725_RDATAL  0x16 // Lower byte of red channel data
 #define TCS34725_GDATAL  0x18 // Lower byte of green channel data
 #define TCS34725_BDATAL  0x1A // Lower byte of blue channel data
+#define TCS34725_ID      0x12 // Device ID register
+
+#define TCS34725_CMD_AUTOINC 0xA0 // Command bit with auto-increment protocol
+#define TCS34725_ID_VALUE    0x44 // ID of the TCS34725
+#define TCS34727_ID_VALUE    0x4D // ID of the TCS34727
+
+#define TCS34725_ATIME_VALUE 0xEB // 21 cycles, 50.4 ms integration
+#define TCS34725_GAIN_VALUE  0x02 // AGAIN 16x
 
-// Global variables for color data
-extern uint16_t r, g, b, c; // Red, Green, Blue, and Clear color values
+#define COLOR_SAMPLE_MS  60   // One integration period (ATIME 0xEB = 50.4 ms) plus margin
 
 /**
  * Enumeration for predominant colors.
@@ -35,6 +51,11 @@ typedef enum {
     RED,     // Predominant red color
     GREEN,   // Predominant green color
     BLUE,    // Predominant blue color
+    YELLOW,  // Red and green
+    CYAN,    // Green and blue
+    MAGENTA, // Red and blue
+    WHITE,   // Low saturation
+    ORANGE,  // Between red and yellow
     UNKNOWN  // Color is unknown or not identifiable
 } PredominantColor;
 
@@ -61,6 +82,33 @@ PredominantColor TCS34725_ReadColorAndCheck();
  */
 void TCS34725_ReadColor(uint16_t *r, uint16_t *g, uint16_t *b, uint16_t *c);
 
+/**
+ * Tracks the illuminance without classifying: collects the previous background
+ * read and starts the next one without waiting for the bus.
+ *
+ * Returns:
+ * uint32_t - Ambient illuminance in lux of the latest completed reading.
+ */
+uint32_t TCS34725_ReadLux(void);
+
+/**
+ * Returns the number of readings taken since start-up.
+ */
+uint32_t TCS34725_Samples(void);
+
+/**
+ * Returns the CPU cycles spent filtering and classifying the last reading.
+ */
+uint32_t TCS34725_ClassifyCycles(void);
+
+/**
+ * Returns the illuminance and colour temperature of the last reading.
+ *
+ * Parameters:
+ * light - Receives lux, CCT and the saturation flag.
+ */
+void TCS34725_GetLight(color_light_t *light);
+
 // Optional SysTick_Handler function declaration (commented out as it may not be needed in this context)
 // void SysTick_Handler(void);
 
@@ -0,0 +1,357 @@
+/*
+ * color_cal.c
+ *
+ * Description: TCS34725 calibration profile stored in flash.
+ * Profiles are appended to the CALIB sector one after another and the newest valid
+ * record wins, so the sector is only erased when it is full. Saving can erase the
+ * sector, which stalls flash reads for a second or more, so callers run it from a task
+ * rather than from an interrupt or the console handler.
+ */
+
+#include "color_cal.h"
+#include "color_transform.h"
+#include "crc.h"
+#include "stm32f4xx.h"
+
+#define PROFILE_WORDS (sizeof(color_cal_profile_t) / 4)
+#define FLASH_KEY1    0x45670123
+#define FLASH_KEY2    0xCDEF89AB
+
+extern uint32_t _calib_start; // Defined in STM32F411VETX_FLASH.ld
+extern uint32_t _calib_end;
+
+// Active profile, defaults until a calibration is loaded or captured
+static color_cal_profile_t activeProfile = {
+    .magic = COLOR_CAL_MAGIC,
+    .version = COLOR_CAL_VERSION,
+    .size = sizeof(color_cal_profile_t),
+    .offset = {0, 0, 0, 0},
+    .gain = {COLOR_MATRIX_ONE, COLOR_MATRIX_ONE, COLOR_MATRIX_ONE},
+    .matrix = {{COLOR_MATRIX_ONE, 0, 0}, {0, COLOR_MATRIX_ONE, 0}, {0, 0, COLOR_MATRIX_ONE}}
+};
+static uint32_t *nextSlot; // First erased slot in the CALIB sector
+static uint16_t patches[COLOR_CAL_PATCHES][3]; // Calibrated r, g, b of each reference patch
+static uint8_t patchesCaptured;                 // Bit n set once patch n is captured
+static uint32_t captureSum[4];                  // Raw r, g, b, c summed for the capture in progress
+static uint8_t captureCount;                    // Readings in captureSum
+
+/**
+ * Checks the header and CRC of a stored record.
+ */
+static int profile_valid(const color_cal_profile_t *p) {
+    return p->magic == COLOR_CAL_MAGIC && p->version == COLOR_CAL_VERSION &&
+           p->size == sizeof(color_cal_profile_t) &&
+           crc32_hw((const uint32_t *)p, PROFILE_WORDS - 1) == p->crc;
+}
+
+/**
+ * Finds the first erased slot of the CALIB sector and sets nextSlot. Records are only
+ * appended and the magic word is programmed first, so written slots precede erased ones
+ * and a binary search finds the boundary. The newest valid record is then the first
+ * one that checks out walking back from it, normally the last one written.
+ *
+ * Returns:
+ * The newest valid record, or 0 if there is none.
+ */
+static const color_cal_profile_t *scan_slots(void) {
+    uint32_t *base = &_calib_start;
+    uint32_t lo = 0;
+    uint32_t hi = (uint32_t)(&_calib_end - base) / PROFILE_WORDS;
+
+    crc_init();
+    // Slots below lo are written, slots from hi on are erased
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (base[mid * PROFILE_WORDS] != 0xFFFFFFFF) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    nextSlot = base + lo * PROFILE_WORDS;
+
+    while (lo-- > 0) {
+        const color_cal_profile_t *p = (const color_cal_profile_t *)(base + lo * PROFILE_WORDS);
+        if (profile_valid(p)) {
+            return p;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Loads the newest valid profile from flash and installs it.
+ *
+ * Returns:
+ * 1 if a profile was loaded, 0 if the defaults are in use.
+ */
+int color_cal_load(void) {
+    const color_cal_profile_t *found = scan_slots();
+
+    if (found == 0) {
+        return 0;
+    }
+    activeProfile = *found;
+    color_transform_set_matrix(activeProfile.matrix);
+    return 1;
+}
+
+/**
+ * Waits for the end of a flash operation and reports errors.
+ */
+static int flash_wait(void) {
+    while (FLASH->SR & FLASH_SR_BSY);
+    return (FLASH->SR & (FLASH_SR_PGSERR | FLASH_SR_PGPERR | FLASH_SR_PGAERR | FLASH_SR_WRPERR)) ? 0 : 1;
+}
+
+/**
+ * Stores the active profile in flash as a new record.
+ *
+ * Returns:
+ * 1 on success, 0 on a flash error.
+ */
+int color_cal_save(void) {
+    const uint32_t *src = (const uint32_t *)&activeProfile;
+    int ok = 1;
+
+    if (nextSlot == 0) {
+        scan_slots();
+    }
+    activeProfile.crc = crc32_hw(src, PROFILE_WORDS - 1);
+
+    // Unlock and clear stale error flags
+    if (FLASH->CR & FLASH_CR_LOCK) {
+        FLASH->KEYR = FLASH_KEY1;
+        FLASH->KEYR = FLASH_KEY2;
+    }
+    FLASH->SR = FLASH_SR_PGSERR | FLASH_SR_PGPERR | FLASH_SR_PGAERR | FLASH_SR_WRPERR | FLASH_SR_EOP;
+
+    // Erase the sector when it is full
+    if (nextSlot + PROFILE_WORDS > &_calib_end) {
+        FLASH->CR = (FLASH->CR & ~(FLASH_CR_PSIZE | FLASH_CR_SNB)) | FLASH_CR_PSIZE_1 | FLASH_CR_SER |
+                    (COLOR_CAL_SECTOR << FLASH_CR_SNB_Pos);
+        FLASH->CR |= FLASH_CR_STRT;
+        ok = flash_wait();
+        FLASH->CR &= ~FLASH_CR_SER;
+        nextSlot = &_calib_start;
+    }
+
+    // Program the record word by word
+    if (ok) {
+        FLASH->CR = (FLASH->CR & ~FLASH_CR_PSIZE) | FLASH_CR_PSIZE_1 | FLASH_CR_PG;
+        for (uint32_t i = 0; i < PROFILE_WORDS && ok; i++) {
+            nextSlot[i] = src[i];
+            ok = flash_wait();
+        }
+        FLASH->CR &= ~FLASH_CR_PG;
+    }
+    FLASH->CR |= FLASH_CR_LOCK;
+
+    if (ok) {
+        ok = profile_valid((const color_cal_profile_t *)nextSlot);
+        nextSlot += PROFILE_WORDS;
+    }
+    return ok;
+}
+
+/**
+ * Starts a reference capture, discarding readings collected so far.
+ */
+void color_cal_start_capture(void) {
+    for (int ch = 0; ch < 4; ch++) {
+        captureSum[ch] = 0;
+    }
+    captureCount = 0;
+}
+
+/**
+ * Adds one raw reading to the reference capture in progress. The caller takes one
+ * reading per integration period, so the capture never blocks.
+ *
+ * Parameters:
+ * r, g, b, c - The raw channel counts.
+ *
+ * Returns:
+ * 1 once COLOR_CAL_SAMPLES readings are in, 0 while more are needed.
+ */
+int color_cal_add_reading(uint16_t r, uint16_t g, uint16_t b, uint16_t c) {
+    if (captureCount < COLOR_CAL_SAMPLES) {
+        captureSum[0] += r;
+        captureSum[1] += g;
+        captureSum[2] += b;
+        captureSum[3] += c;
+        captureCount++;
+    }
+    return captureCount >= COLOR_CAL_SAMPLES;
+}
+
+/**
+ * Averages the readings of the capture in progress.
+ */
+static void average_reading(uint32_t avg[4]) {
+    for (int ch = 0; ch < 4; ch++) {
+        avg[ch] = captureCount ? captureSum[ch] / captureCount : 0;
+    }
+}
+
+/**
+ * Captures the black reference (sensor covered) and updates the offsets.
+ */
+void color_cal_capture_black(void) {
+    uint32_t avg[4];
+
+    average_reading(avg);
+    for (int ch = 0; ch < 4; ch++) {
+        activeProfile.offset[ch] = (uint16_t)avg[ch];
+    }
+}
+
+/**
+ * Captures the white reference and updates the gains so that a white card reads
+ * equal red, green and blue at the level of the strongest channel.
+ *
+ * Returns:
+ * 1 on success, 0 if the white reading is not above the black reference.
+ */
+int color_cal_capture_white(void) {
+    uint32_t avg[4];
+    uint32_t span[3];
+    uint32_t target = 0;
+
+    average_reading(avg);
+    for (int ch = 0; ch < 3; ch++) {
+        if (avg[ch] <= activeProfile.offset[ch]) {
+            return 0;
+        }
+        span[ch] = avg[ch] - activeProfile.offset[ch];
+        if (span[ch] > target) {
+            target = span[ch];
+        }
+    }
+    for (int ch = 0; ch < 3; ch++) {
+        uint32_t gain = (target * COLOR_MATRIX_ONE) / span[ch];
+        activeProfile.gain[ch] = (gain > 0xFFFF) ? 0xFFFF : (uint16_t)gain;
+    }
+    return 1;
+}
+
+/**
+ * Captures a reference patch for the correction matrix. The reading is stored after
+ * the offsets and gains, since the matrix is applied to corrected readings.
+ *
+ * Parameters:
+ * patch - 0 for the red, 1 for the green and 2 for the blue patch.
+ *
+ * Returns:
+ * 1 on success, 0 if the patch index is invalid or the reading is not above black.
+ */
+int color_cal_capture_patch(int patch) {
+    uint32_t avg[4];
+    uint16_t ch[4];
+
+    if (patch < 0 || patch >= COLOR_CAL_PATCHES) {
+        return 0;
+    }
+    average_reading(avg);
+    for (int i = 0; i < 4; i++) {
+        ch[i] = (uint16_t)avg[i];
+    }
+    color_cal_apply(&ch[0], &ch[1], &ch[2], &ch[3]);
+    if (ch[0] == 0 && ch[1] == 0 && ch[2] == 0) {
+        return 0;
+    }
+    for (int i = 0; i < 3; i++) {
+        patches[patch][i] = ch[i];
+    }
+    patchesCaptured |= 1 << patch;
+    return 1;
+}
+
+/**
+ * Solves the correction matrix from the three captured patches and installs it.
+ * With the patches as the columns of P, M = S * inverse(P) maps each patch onto its
+ * own channel alone; the diagonal S scales every row to sum to 1.0 so white stays
+ * white. The determinant cancels out of M, so only the adjugate of P is needed and
+ * everything stays in 64-bit integers.
+ *
+ * Returns:
+ * 1 on success, 0 if a patch is missing or the patches are too alike to separate.
+ */
+int color_cal_solve_matrix(void) {
+    int64_t adj[3][3];
+    int64_t det = 0;
+    int16_t m[3][3];
+
+    if (patchesCaptured != (1 << COLOR_CAL_PATCHES) - 1) {
+        return 0;
+    }
+    // adj[i][j] is the cofactor of P[j][i]; P[row][col] is patches[col][row]
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            int r0 = (j + 1) % 3, r1 = (j + 2) % 3, c0 = (i + 1) % 3, c1 = (i + 2) % 3;
+            adj[i][j] = (int64_t)patches[c0][r0] * patches[c1][r1] - (int64_t)patches[c1][r0] * patches[c0][r1];
+        }
+    }
+    for (int k = 0; k < 3; k++) {
+        det += (int64_t)patches[k][0] * adj[k][0];
+    }
+    if (det == 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        int64_t sum = adj[i][0] + adj[i][1] + adj[i][2];
+        // A row sum against the sign of det would turn a patch into a negative colour
+        if (sum == 0 || (sum > 0) != (det > 0)) {
+            return 0;
+        }
+        for (int j = 0; j < 3; j++) {
+            int64_t q = (adj[i][j] * COLOR_MATRIX_ONE) / sum;
+            if (q > INT16_MAX || q < INT16_MIN) {
+                return 0; // Beyond the Q12 range: the patches barely differ
+            }
+            m[i][j] = (int16_t)q;
+        }
+    }
+    color_cal_set_matrix(m);
+    return 1;
+}
+
+/**
+ * Applies the offsets and gains of the active profile to a raw reading in place.
+ *
+ * Parameters:
+ * r, g, b, c - The channel counts to correct.
+ */
+void color_cal_apply(uint16_t *r, uint16_t *g, uint16_t *b, uint16_t *c) {
+    uint16_t *ch[3] = {r, g, b};
+
+    for (int i = 0; i < 3; i++) {
+        uint32_t v = (*ch[i] > activeProfile.offset[i]) ? *ch[i] - activeProfile.offset[i] : 0;
+        v = (v * activeProfile.gain[i]) >> 12;
+        *ch[i] = (v > 0xFFFF) ? 0xFFFF : (uint16_t)v;
+    }
+    *c = (*c > activeProfile.offset[3]) ? *c - activeProfile.offset[3] : 0;
+}
+
+/**
+ * Sets the correction matrix of the active profile and installs it in the colour transform.
+ *
+ * Parameters:
+ * m - Row-major Q12 coefficients.
+ */
+void color_cal_set_matrix(const int16_t m[3][3]) {
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            activeProfile.matrix[i][j] = m[i][j];
+        }
+    }
+    color_transform_set_matrix(activeProfile.matrix);
+}
+
+/**
+ * Returns the active profile.
+ */
+const color_cal_profile_t *color_cal_profile(void) {
+    return &activeProfile;
+}
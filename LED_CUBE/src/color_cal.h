@@ -0,0 +1,127 @@
+/*
+ * color_cal.h
+ *
+ * Description: TCS34725 calibration profile.
+ * A black and a white reference reading give per-channel offsets and gains. Red, green
+ * and blue reference patches then give a 3x3 correction matrix that undoes the overlap
+ * of the sensor's colour filters. Together they form a profile that is stored in the
+ * dedicated CALIB flash sector with a version and a CRC, and loaded at startup.
+ */
+
+#ifndef SRC_COLOR_CAL_H_
+#define SRC_COLOR_CAL_H_
+
+#include "stdint.h"
+
+#define COLOR_CAL_MAGIC   0x43414C31 // "CAL1"
+#define COLOR_CAL_VERSION 1
+#define COLOR_CAL_SAMPLES 8          // Readings averaged per reference capture
+#define COLOR_CAL_SECTOR  7          // Flash sector reserved in STM32F411VETX_FLASH.ld
+#define COLOR_CAL_PATCHES 3          // Reference patches for the matrix: red, green, blue
+
+/**
+ * Calibration profile as stored in flash. The size is a multiple of 4 bytes.
+ */
+typedef struct {
+    uint32_t magic;       // COLOR_CAL_MAGIC
+    uint16_t version;     // COLOR_CAL_VERSION
+    uint16_t size;        // sizeof(color_cal_profile_t)
+    uint16_t offset[4];   // Black level of r, g, b, c
+    uint16_t gain[3];     // Q12 gains of r, g, b (white balance)
+    uint16_t reserved;
+    int16_t matrix[3][3]; // Q12 correction matrix used by color_transform()
+    int16_t pad;
+    uint32_t crc;         // Hardware CRC-32 of all preceding words
+} color_cal_profile_t;
+
+/**
+ * Loads the newest valid profile from flash and installs it.
+ *
+ * Returns:
+ * 1 if a profile was loaded, 0 if the defaults are in use.
+ */
+int color_cal_load(void);
+
+/**
+ * Stores the active profile in flash as a new record.
+ *
+ * Returns:
+ * 1 on success, 0 on a flash error.
+ */
+int color_cal_save(void);
+
+/**
+ * Starts a reference capture, discarding readings collected so far.
+ */
+void color_cal_start_capture(void);
+
+/**
+ * Adds one raw reading to the reference capture in progress. Take one reading per
+ * COLOR_SAMPLE_MS, then finish the capture with one of the functions below.
+ *
+ * Parameters:
+ * r, g, b, c - The raw channel counts.
+ *
+ * Returns:
+ * 1 once COLOR_CAL_SAMPLES readings are in, 0 while more are needed.
+ */
+int color_cal_add_reading(uint16_t r, uint16_t g, uint16_t b, uint16_t c);
+
+/**
+ * Uses the captured readings as the black reference (sensor covered) and updates the offsets.
+ */
+void color_cal_capture_black(void);
+
+/**
+ * Uses the captured readings as the white reference (white card in front of the sensor)
+ * and updates the gains.
+ *
+ * Returns:
+ * 1 on success, 0 if the white reading is not above the black reference.
+ */
+int color_cal_capture_white(void);
+
+/**
+ * Uses the captured readings as a reference patch (a saturated card in front of the
+ * sensor) for the correction matrix. Capture the black and white references first.
+ *
+ * Parameters:
+ * patch - 0 for the red, 1 for the green and 2 for the blue patch.
+ *
+ * Returns:
+ * 1 on success, 0 if the patch index is invalid or the reading is not above black.
+ */
+int color_cal_capture_patch(int patch);
+
+/**
+ * Solves the correction matrix from the three captured patches and installs it. Each
+ * patch is mapped onto its own channel alone, and every row sums to 1.0 so the white
+ * balance is kept.
+ *
+ * Returns:
+ * 1 on success, 0 if a patch is missing or the patches are too alike to separate.
+ */
+int color_cal_solve_matrix(void);
+
+/**
+ * Applies the offsets and gains of the active profile to a raw reading in place.
+ *
+ * Parameters:
+ * r, g, b, c - The channel counts to correct.
+ */
+void color_cal_apply(uint16_t *r, uint16_t *g, uint16_t *b, uint16_t *c);
+
+/**
+ * Sets the correction matrix of the active profile and installs it in the colour transform.
+ *
+ * Parameters:
+ * m - Row-major Q12 coefficients.
+ */
+void color_cal_set_matrix(const int16_t m[3][3]);
+
+/**
+ * Returns the active profile.
+ */
+const color_cal_profile_t *color_cal_profile(void);
+
+#endif /* SRC_COLOR_CAL_H_ */
@@ -0,0 +1,137 @@
+/*
+ * color_classify.c
+ *
+ * Description: Fixed-point colour classifier for TCS34725 readings.
+ * Classification is a hue conversion plus one table lookup; the table is rebuilt only
+ * when the palette changes.
+ */
+
+#include "color_classify.h"
+
+// Default palette, hues in 1/256 turn
+static const color_palette_entry_t defaultPalette[] = {
+    {RED,     0,   12},
+    {ORANGE,  21,  9},
+    {YELLOW,  43,  12},
+    {GREEN,   85,  28},
+    {CYAN,    128, 20},
+    {BLUE,    171, 28},
+    {MAGENTA, 213, 24}
+};
+
+static uint8_t hueLut[COLOR_HUE_STEPS]; // Hue -> PredominantColor
+static uint8_t whiteMaxSat = COLOR_WHITE_MAX_SAT;
+static uint8_t lutReady;
+
+static const char *colorNames[] = {
+    "red", "green", "blue", "yellow", "cyan", "magenta", "white", "orange", "unknown"
+};
+
+/**
+ * Installs a palette and rebuilds the hue lookup table.
+ *
+ * Parameters:
+ * entries  - Chromatic palette entries (WHITE is decided by saturation).
+ * count    - Number of entries, at most COLOR_PALETTE_MAX.
+ * whiteSat - Saturation below which a reading is WHITE, 0 to disable WHITE.
+ */
+void color_palette_set(const color_palette_entry_t *entries, int count, uint8_t whiteSat) {
+    if (count > COLOR_PALETTE_MAX) {
+        count = COLOR_PALETTE_MAX;
+    }
+    for (int h = 0; h < COLOR_HUE_STEPS; h++) {
+        int bestDist = 256;
+        hueLut[h] = UNKNOWN;
+        for (int i = 0; i < count; i++) {
+            int dist = (uint8_t)(h - entries[i].center);
+            if (dist > 128) {
+                dist = 256 - dist; // Hue wraps around
+            }
+            if (dist <= entries[i].width && dist < bestDist) {
+                bestDist = dist;
+                hueLut[h] = entries[i].color;
+            }
+        }
+    }
+    whiteMaxSat = whiteSat;
+    lutReady = 1;
+}
+
+/**
+ * Converts a reading to hue and saturation.
+ * Channels are first normalised by the clear channel (Q10) so the result does not
+ * depend on distance or ambient level.
+ *
+ * Parameters:
+ * r, g, b, c - Raw channel counts.
+ * hsv        - Receives the result.
+ */
+void color_to_hsv(uint16_t r, uint16_t g, uint16_t b, uint16_t c, color_hsv_t *hsv) {
+    uint32_t clear = c ? c : 1;
+    int32_t rn = ((uint32_t)r << 10) / clear;
+    int32_t gn = ((uint32_t)g << 10) / clear;
+    int32_t bn = ((uint32_t)b << 10) / clear;
+    int32_t max = rn, min = rn, delta, hue;
+
+    if (gn > max) max = gn;
+    if (bn > max) max = bn;
+    if (gn < min) min = gn;
+    if (bn < min) min = bn;
+    delta = max - min;
+
+    hsv->clear = c;
+    if (delta == 0 || max == 0) {
+        hsv->hue = 0;
+        hsv->saturation = 0;
+        return;
+    }
+
+    // Each sixth of the circle spans 256 / 6 ~ 43 steps
+    if (max == rn) {
+        hue = (43 * (gn - bn)) / delta;
+    } else if (max == gn) {
+        hue = 85 + (43 * (bn - rn)) / delta;
+    } else {
+        hue = 171 + (43 * (rn - gn)) / delta;
+    }
+    hsv->hue = (uint8_t)(hue & 0xFF);
+    hsv->saturation = (uint8_t)((delta * 255) / max);
+}
+
+/**
+ * Classifies a reading against the active palette.
+ *
+ * Parameters:
+ * r, g, b, c - Raw channel counts.
+ * hsv        - Optional; receives the hue and saturation.
+ *
+ * Returns:
+ * PredominantColor - the palette colour, or UNKNOWN.
+ */
+PredominantColor classify_color(uint16_t r, uint16_t g, uint16_t b, uint16_t c, color_hsv_t *hsv) {
+    color_hsv_t local;
+
+    if (hsv == 0) {
+        hsv = &local;
+    }
+    if (!lutReady) {
+        color_palette_set(defaultPalette, sizeof(defaultPalette) / sizeof(defaultPalette[0]),
+                          COLOR_WHITE_MAX_SAT);
+    }
+
+    color_to_hsv(r, g, b, c, hsv);
+    if (c < COLOR_CLEAR_MIN) {
+        return UNKNOWN;
+    }
+    if (hsv->saturation < whiteMaxSat) {
+        return WHITE;
+    }
+    return (PredominantColor)hueLut[hsv->hue];
+}
+
+/**
+ * Returns a printable name for a colour.
+ */
+const char *color_name(PredominantColor color) {
+    return (color <= UNKNOWN) ? colorNames[color] : "?";
+}
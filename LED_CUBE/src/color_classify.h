@@ -0,0 +1,77 @@
+/*
+ * color_classify.h
+ *
+ * Description: Fixed-point colour classifier for TCS34725 readings.
+ * The red, green and blue channels are normalised by the clear channel, converted to
+ * hue and saturation, and matched against a configurable palette through a hue lookup
+ * table.
+ */
+
+#ifndef SRC_COLOR_CLASSIFY_H_
+#define SRC_COLOR_CLASSIFY_H_
+
+#include "stdint.h"
+#include "color.h"
+
+#define COLOR_HUE_STEPS      256  // Hue resolution (one full turn)
+#define COLOR_CLEAR_MIN      40   // Darker readings are not classified
+#define COLOR_WHITE_MAX_SAT  40   // Saturation (0-255) below which a reading is white
+#define COLOR_PALETTE_MAX    8    // Chromatic entries in a palette
+
+/**
+ * Hue, saturation and brightness of a reading.
+ */
+typedef struct {
+    uint8_t hue;        // 0-255 for 0-360 degrees, 0 = red
+    uint8_t saturation; // 0-255
+    uint16_t clear;     // Clear channel count
+} color_hsv_t;
+
+/**
+ * A chromatic palette entry: readings whose hue is within width of center map to color.
+ */
+typedef struct {
+    PredominantColor color;
+    uint8_t center; // Hue, 0-255
+    uint8_t width;  // Largest accepted hue distance
+} color_palette_entry_t;
+
+/**
+ * Installs a palette and rebuilds the hue lookup table.
+ * Overlapping entries are resolved in favour of the nearest center.
+ *
+ * Parameters:
+ * entries  - Chromatic palette entries (WHITE is decided by saturation).
+ * count    - Number of entries, at most COLOR_PALETTE_MAX.
+ * whiteSat - Saturation below which a reading is WHITE, 0 to disable WHITE.
+ */
+void color_palette_set(const color_palette_entry_t *entries, int count, uint8_t whiteSat);
+
+/**
+ * Converts a reading to hue and saturation.
+ *
+ * Parameters:
+ * r, g, b, c - Raw channel counts.
+ * hsv        - Receives the result.
+ */
+void color_to_hsv(uint16_t r, uint16_t g, uint16_t b, uint16_t c, color_hsv_t *hsv);
+
+/**
+ * Classifies a reading against the active palette (the default palette until
+ * color_palette_set() is called).
+ *
+ * Parameters:
+ * r, g, b, c - Raw channel counts.
+ * hsv        - Optional; receives the hue and saturation.
+ *
+ * Returns:
+ * PredominantColor - the palette colour, or UNKNOWN.
+ */
+PredominantColor classify_color(uint16_t r, uint16_t g, uint16_t b, uint16_t c, color_hsv_t *hsv);
+
+/**
+ * Returns a printable name for a colour.
+ */
+const char *color_name(PredominantColor color);
+
+#endif /* SRC_COLOR_CLASSIFY_H_ */
@@ -0,0 +1,155 @@
+/*
+ * color_filter.c
+ *
+ * Description: Temporal filtering and debouncing of colour readings.
+ */
+
+#include "color_filter.h"
+#include "color_classify.h"
+
+static color_filter_config_t filterCfg = {
+    .mode = COLOR_FILTER_MAJORITY,
+    .window = 5,
+    .emaShift = 2,
+    .stableMs = 150
+};
+
+// Ring buffer of recent readings and classifications
+static uint16_t history[COLOR_FILTER_MAX_WINDOW][4];
+static uint8_t votes[COLOR_FILTER_MAX_WINDOW];
+static uint8_t histHead, histCount;
+static uint32_t emaState[4];    // Q8 channel averages
+static uint8_t emaPrimed;
+
+// Stability tracking
+static PredominantColor candidate = UNKNOWN;
+static uint32_t candidateSince;
+static PredominantColor declared = UNKNOWN;
+
+/**
+ * Installs new settings and clears the filter history.
+ *
+ * Parameters:
+ * cfg - The settings.
+ */
+void color_filter_configure(const color_filter_config_t *cfg) {
+    filterCfg = *cfg;
+    if (filterCfg.window < 1) {
+        filterCfg.window = 1;
+    } else if (filterCfg.window > COLOR_FILTER_MAX_WINDOW) {
+        filterCfg.window = COLOR_FILTER_MAX_WINDOW;
+    }
+    color_filter_reset();
+}
+
+/**
+ * Forgets the buffered readings and the declared colour, so the next colour is only
+ * declared after a fresh stable period.
+ */
+void color_filter_reset(void) {
+    histHead = 0;
+    histCount = 0;
+    emaPrimed = 0;
+    candidate = UNKNOWN;
+    declared = UNKNOWN;
+}
+
+/**
+ * Median of the buffered values of one channel (insertion sort, N <= 9).
+ */
+static uint16_t channel_median(int ch) {
+    uint16_t v[COLOR_FILTER_MAX_WINDOW];
+
+    for (int i = 0; i < histCount; i++) {
+        uint16_t x = history[i][ch];
+        int j = i;
+        while (j > 0 && v[j - 1] > x) {
+            v[j] = v[j - 1];
+            j--;
+        }
+        v[j] = x;
+    }
+    return v[histCount / 2];
+}
+
+/**
+ * Most frequent classification in the buffer, UNKNOWN without a strict majority.
+ */
+static PredominantColor majority_vote(void) {
+    uint8_t count[UNKNOWN + 1] = {0};
+
+    for (int i = 0; i < histCount; i++) {
+        if (++count[votes[i]] * 2 > histCount) {
+            return (PredominantColor)votes[i];
+        }
+    }
+    return UNKNOWN;
+}
+
+/**
+ * Feeds one reading to the filter.
+ *
+ * Parameters:
+ * r, g, b, c - Channel counts (calibrated).
+ * now        - Current time in milliseconds.
+ * stable     - Receives the declared colour (UNKNOWN until one is declared).
+ *
+ * Returns:
+ * 1 if the declared colour changed with this reading, 0 otherwise.
+ */
+int color_filter_update(uint16_t r, uint16_t g, uint16_t b, uint16_t c, uint32_t now,
+                        PredominantColor *stable) {
+    uint16_t in[4] = {r, g, b, c};
+    PredominantColor filtered;
+
+    // Store the reading in the ring buffer
+    for (int ch = 0; ch < 4; ch++) {
+        history[histHead][ch] = in[ch];
+    }
+    votes[histHead] = classify_color(r, g, b, c, 0);
+    histHead = (histHead + 1) % filterCfg.window;
+    if (histCount < filterCfg.window) {
+        histCount++;
+    }
+
+    switch (filterCfg.mode) {
+        case COLOR_FILTER_MEDIAN:
+            filtered = classify_color(channel_median(0), channel_median(1), channel_median(2),
+                                      channel_median(3), 0);
+            break;
+        case COLOR_FILTER_EMA:
+            for (int ch = 0; ch < 4; ch++) {
+                uint32_t x = (uint32_t)in[ch] << 8;
+                if (!emaPrimed) {
+                    emaState[ch] = x;
+                } else if (x >= emaState[ch]) {
+                    emaState[ch] += (x - emaState[ch]) >> filterCfg.emaShift;
+                } else {
+                    emaState[ch] -= (emaState[ch] - x) >> filterCfg.emaShift;
+                }
+            }
+            emaPrimed = 1;
+            filtered = classify_color(emaState[0] >> 8, emaState[1] >> 8, emaState[2] >> 8,
+                                      emaState[3] >> 8, 0);
+            break;
+        case COLOR_FILTER_MAJORITY:
+            filtered = majority_vote();
+            break;
+        default:
+            filtered = (PredominantColor)votes[(histHead + filterCfg.window - 1) % filterCfg.window];
+            break;
+    }
+
+    // Declare a change only once the filtered colour has held for stableMs
+    if (filtered != candidate) {
+        candidate = filtered;
+        candidateSince = now;
+    }
+    int changed = 0;
+    if (candidate != declared && (uint32_t)(now - candidateSince) >= filterCfg.stableMs) {
+        declared = candidate;
+        changed = 1;
+    }
+    *stable = declared;
+    return changed;
+}
@@ -0,0 +1,66 @@
+/*
+ * color_filter.h
+ *
+ * Description: Temporal filtering and debouncing of colour readings.
+ * Readings go through a median-of-N, exponential moving average or majority vote
+ * stage kept in a small ring buffer; a new colour is only declared once the filtered
+ * result has been stable for a configurable time.
+ */
+
+#ifndef SRC_COLOR_FILTER_H_
+#define SRC_COLOR_FILTER_H_
+
+#include "stdint.h"
+#include "color.h"
+
+#define COLOR_FILTER_MAX_WINDOW 9 // Largest ring buffer
+
+/**
+ * Filter stage applied before the stability check.
+ */
+typedef enum {
+    COLOR_FILTER_NONE,     // Classify each reading as it comes
+    COLOR_FILTER_MEDIAN,   // Per-channel median of the last N readings, then classify
+    COLOR_FILTER_EMA,      // Per-channel exponential moving average, then classify
+    COLOR_FILTER_MAJORITY  // Classify each reading, then vote over the last N results
+} color_filter_mode_t;
+
+/**
+ * Filter settings.
+ */
+typedef struct {
+    color_filter_mode_t mode;
+    uint8_t window;     // N for median and majority (1 - COLOR_FILTER_MAX_WINDOW)
+    uint8_t emaShift;   // EMA weight of a new reading is 1 / 2^emaShift
+    uint16_t stableMs;  // Time the filtered colour must hold before it is declared
+} color_filter_config_t;
+
+/**
+ * Installs new settings and clears the filter history.
+ *
+ * Parameters:
+ * cfg - The settings.
+ */
+void color_filter_configure(const color_filter_config_t *cfg);
+
+/**
+ * Forgets the buffered readings and the declared colour. Call before waiting for a
+ * new card, so a colour seen earlier is not reported again.
+ */
+void color_filter_reset(void);
+
+/**
+ * Feeds one reading to the filter.
+ *
+ * Parameters:
+ * r, g, b, c - Channel counts (calibrated).
+ * now        - Current time in milliseconds.
+ * stable     - Receives the declared colour (UNKNOWN until one is declared).
+ *
+ * Returns:
+ * 1 if the declared colour changed with this reading, 0 otherwise.
+ */
+int color_filter_update(uint16_t r, uint16_t g, uint16_t b, uint16_t c, uint32_t now,
+                        PredominantColor *stable);
+
+#endif /* SRC_COLOR_FILTER_H_ */
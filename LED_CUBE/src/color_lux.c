@@ -0,0 +1,78 @@
+/*
+ * color_lux.c
+ *
+ * Description: Illuminance and correlated colour temperature from TCS34725 RGBC data.
+ *
+ * DN40 coefficients for the TCS34725 in open air:
+ *   IR  = (R + G + B - C) / 2,  X' = X - IR
+ *   G'' = 0.136 R' + 1.000 G' - 0.444 B'
+ *   CPL = ATIME_ms * AGAIN / (GA * DF),  ATIME_ms = (256 - ATIME) * 2.4,  GA = 1, DF = 310
+ *   Lux = G'' / CPL
+ *   CCT = 3810 * B' / R' + 1391
+ */
+
+#include "color_lux.h"
+
+#define COEF_R   139  // 0.136 in Q10
+#define COEF_G   1024 // 1.000 in Q10
+#define COEF_B   -455 // -0.444 in Q10
+#define DF       310
+#define CT_COEF  3810
+#define CT_OFFSET 1391
+
+/**
+ * Computes lux and CCT from a reading.
+ *
+ * Parameters:
+ * r, g, b, c - Raw channel counts.
+ * atime      - ATIME register value used for the reading.
+ * gain       - Analog gain factor (1, 4, 16 or 60).
+ * out        - Receives the result.
+ */
+void color_compute_light(uint16_t r, uint16_t g, uint16_t b, uint16_t c, uint8_t atime,
+                         uint8_t gain, color_light_t *out) {
+    uint32_t cycles = 256 - atime;
+    uint32_t maxCount = (cycles * 1024 > 65535) ? 65535 : cycles * 1024;
+    int32_t ir, rp, gp, bp, g2;
+
+    // Digital saturation, and analog (ripple) saturation below 150 ms integration
+    out->saturated = (c >= maxCount) || (cycles < 63 && c >= maxCount - maxCount / 4);
+
+    ir = ((int32_t)r + g + b - c) / 2;
+    if (ir < 0) {
+        ir = 0;
+    }
+    rp = r - ir;
+    gp = g - ir;
+    bp = b - ir;
+
+    g2 = COEF_R * rp + COEF_G * gp + COEF_B * bp; // Q10
+    if (g2 <= 0 || gain == 0) {
+        out->lux = 0;
+    } else {
+        // lux = G'' * DF / (cycles * 2.4 * gain), with 2.4 = 12 / 5
+        out->lux = (uint32_t)(((uint64_t)g2 * DF * 5) / ((uint64_t)cycles * 12 * gain * 1024));
+    }
+
+    // A tiny R' (deep blue light) sends the ratio past 16 bits; report that as undefined
+    out->cct = 0;
+    if (rp > 0 && bp >= 0) {
+        int32_t cct = (CT_COEF * bp) / rp + CT_OFFSET;
+        if (cct <= 65535) {
+            out->cct = (uint16_t)cct;
+        }
+    }
+}
+
+/**
+ * Checks whether a reading was taken under usable lighting.
+ *
+ * Parameters:
+ * light - Result of color_compute_light().
+ *
+ * Returns:
+ * 1 if the reading can be classified, 0 otherwise.
+ */
+int color_light_ok(const color_light_t *light) {
+    return !light->saturated && light->lux >= COLOR_LUX_MIN && light->lux <= COLOR_LUX_MAX;
+}
@@ -0,0 +1,48 @@
+/*
+ * color_lux.h
+ *
+ * Description: Illuminance and correlated colour temperature from TCS34725 RGBC data,
+ * following the ams DN40 method with integer arithmetic.
+ */
+
+#ifndef SRC_COLOR_LUX_H_
+#define SRC_COLOR_LUX_H_
+
+#include "stdint.h"
+
+#define COLOR_LUX_MIN 1   // Darker readings are rejected
+#define COLOR_LUX_MAX 300 // Brighter readings mean no card in front of the sensor
+
+/**
+ * Light measurement derived from one reading.
+ */
+typedef struct {
+    uint32_t lux;      // Illuminance in lux
+    uint16_t cct;      // Correlated colour temperature in kelvin, 0 if undefined
+    uint8_t saturated; // 1 if the reading hit digital or analog saturation
+} color_light_t;
+
+/**
+ * Computes lux and CCT from a reading.
+ *
+ * Parameters:
+ * r, g, b, c - Raw channel counts.
+ * atime      - ATIME register value used for the reading.
+ * gain       - Analog gain factor (1, 4, 16 or 60).
+ * out        - Receives the result.
+ */
+void color_compute_light(uint16_t r, uint16_t g, uint16_t b, uint16_t c, uint8_t atime,
+                         uint8_t gain, color_light_t *out);
+
+/**
+ * Checks whether a reading was taken under usable lighting.
+ *
+ * Parameters:
+ * light - Result of color_compute_light().
+ *
+ * Returns:
+ * 1 if the reading can be classified, 0 otherwise.
+ */
+int color_light_ok(const color_light_t *light);
+
+#endif /* SRC_COLOR_LUX_H_ */
@@ -0,0 +1,154 @@
+/*
+ * color_mux.c
+ *
+ * Description: Several TCS34725 colour sensors behind a TCA9548A I2C multiplexer.
+ * Each reading is a single 8-byte auto-increment burst (CDATAL..BDATAH) instead of
+ * four word reads, and the mux control byte is only written when the channel changes.
+ * Exactly one channel is connected whenever the sensor address is used, as every
+ * sensor, the main one included, answers to it.
+ */
+
+#include "color_mux.h"
+#include "color_classify.h"
+#include "i2c.h"
+
+#define NO_CHANNEL 0xFF
+
+static uint8_t channels[COLOR_MUX_CHANNELS];     // Mux channel of each sensor
+static color_mux_reading_t readings[COLOR_MUX_CHANNELS];
+static int sensorCount;
+static int next;                                  // Next sensor to poll
+static uint8_t selected = NO_CHANNEL;             // Channel currently connected
+
+/**
+ * Connects one mux channel, or none, skipping the write if nothing changes.
+ *
+ * Returns:
+ * int - 1 on success, 0 if the mux did not answer.
+ */
+static int select_channel(uint8_t channel) {
+    if (channel == selected) {
+        return 1;
+    }
+    if (!i2c_write_byte(TCS34725_BUS, COLOR_MUX_ADDRESS, (channel == NO_CHANNEL) ? COLOR_MUX_NONE : (uint8_t)(1 << channel))) {
+        selected = NO_CHANNEL;
+        return 0;
+    }
+    selected = channel;
+    return 1;
+}
+
+/**
+ * Probes the mux and the sensors on the given channels and initializes those found.
+ * Leaves the main sensor's channel connected.
+ *
+ * Parameters:
+ * channelMask - Bit n set to look for a sensor on channel n; the main sensor's channel
+ *               is never probed.
+ *
+ * Returns:
+ * int - Number of sensors found, 0 if the mux does not answer.
+ */
+int color_mux_init(uint8_t channelMask) {
+    sensorCount = 0;
+    next = 0;
+    // The mux state after a warm reset is unknown, so write it whatever selected says
+    selected = NO_CHANNEL;
+    if (!i2c_write_byte(TCS34725_BUS, COLOR_MUX_ADDRESS, COLOR_MUX_NONE)) {
+        return 0;
+    }
+
+    channelMask &= ~(1 << COLOR_MUX_PRIMARY);
+    for (uint8_t ch = 0; ch < COLOR_MUX_CHANNELS; ch++) {
+        if (!(channelMask & (1 << ch)) || !select_channel(ch)) {
+            continue;
+        }
+        // Only this channel is connected, so an ACK comes from its sensor alone and an
+        // empty channel NACKs the address; only then is it safe to read the ID
+        if (!i2c_write_byte(TCS34725_BUS, TCS34725_ADDRESS, 0x80 | TCS34725_ID)) {
+            continue;
+        }
+        uint8_t id = read_i2c(TCS34725_BUS, TCS34725_ADDRESS, 0x80 | TCS34725_ID);
+        if (id != TCS34725_ID_VALUE && id != TCS34727_ID_VALUE) {
+            continue;
+        }
+        write_i2c(TCS34725_BUS, TCS34725_ADDRESS, (0x80|TCS34725_ENABLE), 0x03);
+        write_i2c(TCS34725_BUS, TCS34725_ADDRESS, (0x80|TCS34725_ATIME), TCS34725_ATIME_VALUE);
+        write_i2c(TCS34725_BUS, TCS34725_ADDRESS, (0x80|TCS34725_CONTROL), TCS34725_GAIN_VALUE);
+        readings[sensorCount].color = UNKNOWN;
+        channels[sensorCount++] = ch;
+    }
+    color_mux_release();
+    return sensorCount;
+}
+
+/**
+ * Returns the number of sensors found by color_mux_init().
+ */
+int color_mux_sensors(void) {
+    return sensorCount;
+}
+
+/**
+ * Reads the next sensor in round-robin order.
+ *
+ * Parameters:
+ * now - Timestamp for the reading in milliseconds.
+ *
+ * Returns:
+ * int - Index of the sensor read, or -1 if there are no sensors.
+ */
+int color_mux_poll(uint32_t now) {
+    uint8_t buf[8];
+    int sensor = next;
+
+    if (sensorCount == 0 || !select_channel(channels[sensor])) {
+        return -1;
+    }
+    next = (next + 1) % sensorCount;
+
+    read_i2c_burst(TCS34725_BUS, TCS34725_ADDRESS, TCS34725_CMD_AUTOINC | TCS34725_CDATAL, buf, sizeof(buf));
+
+    color_mux_reading_t *out = &readings[sensor];
+    out->c = buf[0] | (buf[1] << 8);
+    out->r = buf[2] | (buf[3] << 8);
+    out->g = buf[4] | (buf[5] << 8);
+    out->b = buf[6] | (buf[7] << 8);
+    out->color = classify_color(out->r, out->g, out->b, out->c, 0);
+    out->timestamp = now;
+    return sensor;
+}
+
+/**
+ * Reads every sensor once and connects the main sensor's channel again.
+ *
+ * Parameters:
+ * now - Timestamp for the readings in milliseconds.
+ */
+void color_mux_sweep(uint32_t now) {
+    for (int i = 0; i < sensorCount; i++) {
+        color_mux_poll(now);
+    }
+    color_mux_release();
+}
+
+/**
+ * Connects only the main sensor's channel, so color.c can read it again.
+ */
+void color_mux_release(void) {
+    select_channel(COLOR_MUX_PRIMARY);
+}
+
+/**
+ * Returns the per-sensor readings, indexed like the channels found at init.
+ */
+const color_mux_reading_t *color_mux_readings(void) {
+    return readings;
+}
+
+/**
+ * Returns the mux channel of a sensor index.
+ */
+uint8_t color_mux_channel(int sensor) {
+    return channels[sensor];
+}
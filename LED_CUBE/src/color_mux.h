@@ -0,0 +1,85 @@
+/*
+ * color_mux.h
+ *
+ * Description: Several TCS34725 colour sensors behind a TCA9548A I2C multiplexer.
+ * The TCS34725 has a fixed address, so each extra sensor sits on its own mux channel.
+ * So does the main sensor: upstream of the mux it would answer together with whichever
+ * channel is connected. The driver selects channels, reads the sensors round robin with
+ * one burst read each and publishes a per-sensor reading array. Between sweeps only the
+ * main sensor's channel is connected, so color.c reads it as if there were no mux.
+ */
+
+#ifndef SRC_COLOR_MUX_H_
+#define SRC_COLOR_MUX_H_
+
+#include "stdint.h"
+#include "color.h"
+
+#define COLOR_MUX_ADDRESS  0x70 // TCA9548A with A0-A2 low
+#define COLOR_MUX_CHANNELS 8    // Downstream channels, one sensor each
+#define COLOR_MUX_NONE     0x00 // Control byte that disconnects every channel
+#define COLOR_MUX_PRIMARY  0    // Channel of the main sensor read by color.c
+
+/**
+ * Latest reading of one sensor.
+ */
+typedef struct {
+    uint16_t r, g, b, c;      // Raw channel counts
+    PredominantColor color;   // Classification of the counts
+    uint32_t timestamp;       // Time of the reading in milliseconds
+} color_mux_reading_t;
+
+/**
+ * Probes the mux and the sensors on the given channels and initializes those found.
+ * Leaves the main sensor's channel connected, so call it before TCS34725_Init().
+ *
+ * Parameters:
+ * channelMask - Bit n set to look for a sensor on channel n; the main sensor's channel
+ *               is never probed.
+ *
+ * Returns:
+ * int - Number of sensors found, 0 if the mux does not answer.
+ */
+int color_mux_init(uint8_t channelMask);
+
+/**
+ * Returns the number of sensors found by color_mux_init().
+ */
+int color_mux_sensors(void);
+
+/**
+ * Reads the next sensor in round-robin order. The sensor's channel stays connected
+ * until color_mux_release() so consecutive polls skip redundant selections.
+ *
+ * Parameters:
+ * now - Timestamp for the reading in milliseconds.
+ *
+ * Returns:
+ * int - Index of the sensor read, or -1 if there are no sensors.
+ */
+int color_mux_poll(uint32_t now);
+
+/**
+ * Reads every sensor once and connects the main sensor's channel again.
+ *
+ * Parameters:
+ * now - Timestamp for the readings in milliseconds.
+ */
+void color_mux_sweep(uint32_t now);
+
+/**
+ * Connects only the main sensor's channel, so color.c can read it again.
+ */
+void color_mux_release(void);
+
+/**
+ * Returns the per-sensor readings, indexed like the channels found at init.
+ */
+const color_mux_reading_t *color_mux_readings(void);
+
+/**
+ * Returns the mux channel of a sensor index.
+ */
+uint8_t color_mux_channel(int sensor);
+
+#endif /* SRC_COLOR_MUX_H_ */
@@ -0,0 +1,139 @@
+/*
+ * color_stats.c
+ *
+ * Description: Colour analytics over a sliding time window.
+ * Samples live in a ring ordered by time; adding one evicts the expired ones and
+ * updates the counts incrementally, then the summary is rebuilt from the counts.
+ */
+
+#include "color_stats.h"
+#include "color_classify.h"
+
+#define NO_HUE 0xFF // Bin marker for samples without a hue (white or unknown)
+
+typedef struct {
+    uint32_t timestamp;
+    uint8_t color;
+    uint8_t bin;
+} color_sample_t;
+
+static color_sample_t ring[COLOR_STATS_CAPACITY];
+static uint16_t head;  // Oldest sample
+static uint16_t count; // Samples in the ring
+static uint16_t colorCount[UNKNOWN + 1];
+static uint16_t hueCount[COLOR_STATS_HUE_BINS];
+static uint32_t window = COLOR_STATS_WINDOW_MS;
+static color_stats_t summary = {UNKNOWN, UNKNOWN, 0, 0, 0};
+
+/**
+ * Removes the oldest sample from the ring and the counts.
+ */
+static void evict_oldest(void) {
+    color_sample_t *s = &ring[head];
+
+    colorCount[s->color]--;
+    if (s->bin != NO_HUE) {
+        hueCount[s->bin]--;
+    }
+    head = (head + 1) % COLOR_STATS_CAPACITY;
+    count--;
+}
+
+/**
+ * Rebuilds the summary from the counts.
+ */
+static void update_summary(void) {
+    int first = UNKNOWN, second = UNKNOWN;
+    int bestBin = 0;
+
+    for (int i = 0; i < UNKNOWN; i++) {
+        if (colorCount[i] == 0) {
+            continue;
+        }
+        if (first == UNKNOWN || colorCount[i] > colorCount[first]) {
+            second = first;
+            first = i;
+        } else if (second == UNKNOWN || colorCount[i] > colorCount[second]) {
+            second = i;
+        }
+    }
+    for (int i = 1; i < COLOR_STATS_HUE_BINS; i++) {
+        if (hueCount[i] > hueCount[bestBin]) {
+            bestBin = i;
+        }
+    }
+
+    summary.dominant = (PredominantColor)first;
+    summary.secondary = (PredominantColor)second;
+    summary.confidence = (count && first != UNKNOWN) ? (uint8_t)((colorCount[first] * 100U) / count) : 0;
+    summary.dominantHue = (uint8_t)(bestBin * (256 / COLOR_STATS_HUE_BINS) + 128 / COLOR_STATS_HUE_BINS);
+    summary.samples = count;
+}
+
+/**
+ * Sets the window length and discards the collected samples.
+ *
+ * Parameters:
+ * windowMs - Window length in milliseconds.
+ */
+void color_stats_set_window(uint32_t windowMs) {
+    while (count) {
+        evict_oldest();
+    }
+    window = windowMs;
+    update_summary();
+}
+
+/**
+ * Adds a reading, drops samples older than the window and refreshes the summary.
+ * Dark readings are kept as UNKNOWN so they lower the confidence.
+ *
+ * Parameters:
+ * r, g, b, c - Calibrated channel counts.
+ * now        - Timestamp of the reading in milliseconds.
+ */
+void color_stats_add(uint16_t r, uint16_t g, uint16_t b, uint16_t c, uint32_t now) {
+    color_hsv_t hsv;
+    PredominantColor color = classify_color(r, g, b, c, &hsv);
+    color_sample_t *s;
+
+    while (count && (now - ring[head].timestamp > window || count == COLOR_STATS_CAPACITY)) {
+        evict_oldest();
+    }
+
+    s = &ring[(head + count) % COLOR_STATS_CAPACITY];
+    s->timestamp = now;
+    s->color = color;
+    s->bin = (color == WHITE || color == UNKNOWN) ? NO_HUE : hsv.hue / (256 / COLOR_STATS_HUE_BINS);
+    colorCount[color]++;
+    if (s->bin != NO_HUE) {
+        hueCount[s->bin]++;
+    }
+    count++;
+
+    update_summary();
+}
+
+/**
+ * Returns the cached summary.
+ *
+ * Parameters:
+ * out - Receives the summary.
+ */
+void color_stats_get(color_stats_t *out) {
+    *out = summary;
+}
+
+/**
+ * Returns the cached dominant colour.
+ */
+PredominantColor color_stats_dominant(void) {
+    return summary.dominant;
+}
+
+/**
+ * Returns the cached secondary colour.
+ */
+PredominantColor color_stats_secondary(void) {
+    return summary.secondary;
+}
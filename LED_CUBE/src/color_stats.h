@@ -0,0 +1,66 @@
+/*
+ * color_stats.h
+ *
+ * Description: Colour analytics over a sliding time window.
+ * Keeps a hue histogram and per-colour counts of the TCS34725 samples from the last
+ * few seconds and caches the dominant and secondary colour, so queries are O(1) and
+ * never touch the sensor.
+ */
+
+#ifndef SRC_COLOR_STATS_H_
+#define SRC_COLOR_STATS_H_
+
+#include "stdint.h"
+#include "color.h"
+
+#define COLOR_STATS_CAPACITY  128  // Samples held (~7.6 s at COLOR_SAMPLE_MS)
+#define COLOR_STATS_HUE_BINS  16   // Hue histogram bins (16 hue steps each)
+#define COLOR_STATS_WINDOW_MS 5000 // Default window length
+
+/**
+ * Summary of the samples in the window.
+ */
+typedef struct {
+    PredominantColor dominant;  // Most frequent colour, UNKNOWN if none
+    PredominantColor secondary; // Second most frequent colour, UNKNOWN if none
+    uint8_t confidence;         // Share of the window taken by dominant, 0-100
+    uint8_t dominantHue;        // Centre of the fullest hue bin, 0-255
+    uint16_t samples;           // Samples in the window
+} color_stats_t;
+
+/**
+ * Sets the window length and discards the collected samples.
+ *
+ * Parameters:
+ * windowMs - Window length in milliseconds.
+ */
+void color_stats_set_window(uint32_t windowMs);
+
+/**
+ * Adds a reading, drops samples older than the window and refreshes the summary.
+ *
+ * Parameters:
+ * r, g, b, c - Calibrated channel counts.
+ * now        - Timestamp of the reading in milliseconds.
+ */
+void color_stats_add(uint16_t r, uint16_t g, uint16_t b, uint16_t c, uint32_t now);
+
+/**
+ * Returns the cached summary.
+ *
+ * Parameters:
+ * out - Receives the summary.
+ */
+void color_stats_get(color_stats_t *out);
+
+/**
+ * Returns the cached dominant colour.
+ */
+PredominantColor color_stats_dominant(void);
+
+/**
+ * Returns the cached secondary colour.
+ */
+PredominantColor color_stats_secondary(void);
+
+#endif /* SRC_COLOR_STATS_H_ */
@@ -0,0 +1,98 @@
+/*
+ * color_transform.c
+ *
+ * Description: Colour transform from TCS34725 readings to LED drive levels.
+ */
+
+#include "color_transform.h"
+
+// Correction matrix in Q12, identity until a calibration is installed
+static int16_t colorMatrix[3][3] = {
+    {COLOR_MATRIX_ONE, 0, 0},
+    {0, COLOR_MATRIX_ONE, 0},
+    {0, 0, COLOR_MATRIX_ONE}
+};
+
+// Perceived intensity -> linear duty, gamma 2.2
+static const uint8_t gammaLut[256] = {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+      3,   3,   3,   3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,   6,
+      6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  11,  11,  11,  12,
+     12,  13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,
+     20,  20,  21,  22,  22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,  29,
+     30,  30,  31,  32,  33,  33,  34,  35,  35,  36,  37,  38,  39,  39,  40,  41,
+     42,  43,  43,  44,  45,  46,  47,  48,  49,  49,  50,  51,  52,  53,  54,  55,
+     56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,
+     73,  74,  75,  76,  77,  78,  79,  81,  82,  83,  84,  85,  87,  88,  89,  90,
+     91,  93,  94,  95,  97,  98,  99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+    113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+    137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+    163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+    192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+    223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255
+};
+
+/**
+ * Sets the correction matrix applied to raw (r, g, b) columns.
+ *
+ * Parameters:
+ * m - Row-major Q12 coefficients, COLOR_MATRIX_ONE is 1.0.
+ */
+void color_transform_set_matrix(const int16_t m[3][3]) {
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            colorMatrix[i][j] = m[i][j];
+        }
+    }
+}
+
+/**
+ * Copies the active correction matrix.
+ *
+ * Parameters:
+ * m - Destination for the row-major Q12 coefficients.
+ */
+void color_transform_get_matrix(int16_t m[3][3]) {
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            m[i][j] = colorMatrix[i][j];
+        }
+    }
+}
+
+/**
+ * Converts a raw reading to gamma-corrected LED duties.
+ * The corrected components are scaled so the largest one becomes 255, which keeps
+ * the hue and saturation of the card independent of its distance to the sensor.
+ *
+ * Parameters:
+ * r, g, b - Raw channel counts.
+ * out     - Receives the LED duties (0-255 each).
+ */
+void color_transform(uint16_t r, uint16_t g, uint16_t b, rgb_t *out) {
+    int32_t in[3] = {r, g, b};
+    int32_t lin[3];
+    int32_t max = 0;
+
+    for (int i = 0; i < 3; i++) {
+        // A Q12 coefficient times a 16-bit count alone can reach 2^31, so sum in 64 bits
+        int64_t acc = (int64_t)colorMatrix[i][0] * in[0] + (int64_t)colorMatrix[i][1] * in[1] +
+                      (int64_t)colorMatrix[i][2] * in[2];
+        lin[i] = (int32_t)(acc >> 12);
+        if (lin[i] < 0) {
+            lin[i] = 0;
+        }
+        if (lin[i] > max) {
+            max = lin[i];
+        }
+    }
+
+    if (max == 0) {
+        out->r = out->g = out->b = 0;
+        return;
+    }
+    out->r = gammaLut[(lin[0] * 255) / max];
+    out->g = gammaLut[(lin[1] * 255) / max];
+    out->b = gammaLut[(lin[2] * 255) / max];
+}
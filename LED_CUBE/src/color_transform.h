@@ -0,0 +1,51 @@
+/*
+ * color_transform.h
+ *
+ * Description: Colour transform from TCS34725 readings to LED drive levels.
+ * A 3x3 white-balance/correction matrix is applied to the raw channels, the result is
+ * scaled so the strongest component is at full range, and a gamma table converts the
+ * perceived intensity to a linear LED duty. All arithmetic is integer.
+ */
+
+#ifndef SRC_COLOR_TRANSFORM_H_
+#define SRC_COLOR_TRANSFORM_H_
+
+#include "stdint.h"
+
+#define COLOR_MATRIX_ONE 4096 // 1.0 in the Q12 matrix format
+
+/**
+ * An 8-bit per component colour.
+ */
+typedef struct {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+} rgb_t;
+
+/**
+ * Sets the correction matrix applied to raw (r, g, b) columns.
+ *
+ * Parameters:
+ * m - Row-major Q12 coefficients, COLOR_MATRIX_ONE is 1.0.
+ */
+void color_transform_set_matrix(const int16_t m[3][3]);
+
+/**
+ * Copies the active correction matrix.
+ *
+ * Parameters:
+ * m - Destination for the row-major Q12 coefficients.
+ */
+void color_transform_get_matrix(int16_t m[3][3]);
+
+/**
+ * Converts a raw reading to gamma-corrected LED duties.
+ *
+ * Parameters:
+ * r, g, b - Raw channel counts.
+ * out     - Receives the LED duties (0-255 each).
+ */
+void color_transform(uint16_t r, uint16_t g, uint16_t b, rgb_t *out);
+
+#endif /* SRC_COLOR_TRANSFORM_H_ */
@@ -0,0 +1,639 @@
+/*
+ * console.c
+ *
+ * Description: Interactive command console on USART2.
+ * A line editor with echo and backspace feeds a table-driven command parser.
+ */
+
+#include "console.h"
+#include "stm32f4xx.h"
+#include "string.h"
+#include "stdlib.h"
+#include "uart.h"
+#include "i2c.h"
+#include "led.h"
+#include "gesture.h"
+#include "brightness.h"
+#include "color_cal.h"
+#include "color_classify.h"
+#include "color_stats.h"
+#include "sensor_state.h"
+#include "stream.h"
+#include "log.h"
+#include "telemetry.h"
+#include "sched.h"
+#include "clock.h"
+#include "timebase.h"
+#include "power.h"
+
+static char line[CONSOLE_LINE_MAX];
+static uint8_t lineLen;
+static uint8_t lastWasCr;       // Swallow the LF of a CR LF pair
+static uint8_t inPoll;          // Guards against re-entry through Delay_ms()
+
+static int calSaveTask = -1;    // Queued calibration save, -1 when none
+static int calCaptureTask = -1; // Reference capture in progress, -1 when none
+static uint8_t calCapture;      // Index into calTargets of the capture in progress
+static uint32_t baudPending;    // Rate to switch to once the output has drained, 0 when none
+
+static volatile uint8_t patternPending;
+static gesture_ext_t patternGesture;
+static PredominantColor patternColor;
+
+static void cmd_help(int argc, char **argv);
+static void cmd_status(int argc, char **argv);
+static void cmd_bright(int argc, char **argv);
+static void cmd_pattern(int argc, char **argv);
+static void cmd_i2c(int argc, char **argv);
+static void cmd_baud(int argc, char **argv);
+static void cmd_prof(int argc, char **argv);
+static void cmd_gthresh(int argc, char **argv);
+static void cmd_truecolor(int argc, char **argv);
+static void cmd_cal(int argc, char **argv);
+static void cmd_stream(int argc, char **argv);
+static void cmd_telem(int argc, char **argv);
+static void cmd_tasks(int argc, char **argv);
+static void cmd_clock(int argc, char **argv);
+static void cmd_power(int argc, char **argv);
+
+static const console_cmd_t commands[] = {
+    {"help",      cmd_help,      "list commands"},
+    {"status",    cmd_status,    "show the latest sensor readings"},
+    {"bright",    cmd_bright,    "bright <0-256|auto>: LED brightness"},
+    {"pattern",   cmd_pattern,   "pattern <up|down|left|right> [colour]: show a pattern"},
+    {"i2c",       cmd_i2c,       "i2c <1|3> [hz]: show or set a bus speed"},
+    {"baud",      cmd_baud,      "baud <rate>: console baud rate"},
+    {"prof",      cmd_prof,      "dump profiling counters"},
+    {"gthresh",   cmd_gthresh,   "gthresh <enter> <exit>: gesture proximity thresholds"},
+    {"truecolor", cmd_truecolor, "truecolor <on|off>: mirror the sensed colour"},
+    {"cal",       cmd_cal,       "cal <black|white|red|green|blue|matrix|save>: colour calibration"},
+    {"stream",    cmd_stream,    "stream [baud]: show frames sent by a host (tools/cube_stream)"},
+    {"telem",     cmd_telem,     "telem <on|off|ms>: binary telemetry (tools/telemetry_csv)"},
+    {"tasks",     cmd_tasks,     "list scheduler tasks"},
+    {"clock",     cmd_clock,     "clock [perf|low|reset]: show or switch the clock profile"},
+    {"power",     cmd_power,     "power [reset|stop <on|off>]: time spent in each power state"},
+};
+
+#define COMMAND_COUNT (sizeof(commands) / sizeof(commands[0]))
+
+/**
+ * Writes a string to the console. Replies are built from strings and numbers
+ * instead of printf(), which keeps the C library's formatter out of the image.
+ *
+ * Parameters:
+ * s - The text, NUL-terminated.
+ */
+void console_print(const char *s) {
+    _write(1, (char *)s, (int)strlen(s));
+}
+
+/**
+ * Writes an unsigned number in decimal to the console.
+ *
+ * Parameters:
+ * value - The number.
+ * width - Minimum field width, filled with leading spaces.
+ */
+void console_print_u32(uint32_t value, uint8_t width) {
+    char buf[11];
+    int n = sizeof(buf);
+
+    do {
+        buf[--n] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (n > 0 && (int)sizeof(buf) - n < width) {
+        buf[--n] = ' ';
+    }
+    _write(1, &buf[n], (int)sizeof(buf) - n);
+}
+
+/**
+ * Writes a string left-aligned in a field of at least width characters.
+ */
+static void print_padded(const char *s, uint8_t width) {
+    size_t len = strlen(s);
+
+    console_print(s);
+    while (len++ < width) {
+        console_print(" ");
+    }
+}
+
+/**
+ * Writes a number as a fixed count of hexadecimal digits, with leading zeros.
+ */
+static void print_hex(uint32_t value, uint8_t digits) {
+    static const char hex[] = "0123456789abcdef";
+    char buf[8];
+
+    for (int i = digits - 1; i >= 0; i--) {
+        buf[i] = hex[value & 0x0F];
+        value >>= 4;
+    }
+    _write(1, buf, digits);
+}
+
+/**
+ * Parses a colour name, returning UNKNOWN if it is not one.
+ */
+static PredominantColor parse_color(const char *name) {
+    for (int c = 0; c < UNKNOWN; c++) {
+        if (strcmp(name, color_name((PredominantColor)c)) == 0) {
+            return (PredominantColor)c;
+        }
+    }
+    return UNKNOWN;
+}
+
+static void cmd_help(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    for (unsigned i = 0; i < COMMAND_COUNT; i++) {
+        console_print("  ");
+        print_padded(commands[i].name, 10);
+        console_print(" ");
+        console_print(commands[i].help);
+        console_print("\n\r");
+    }
+}
+
+/**
+ * Writes the brightness line of "status" and "bright".
+ */
+static void print_brightness(void) {
+    console_print("brightness ");
+    console_print_u32(brightness_get(), 0);
+    console_print("/");
+    console_print_u32(BRIGHTNESS_FULL, 0);
+    console_print("\n\r");
+}
+
+static void cmd_status(int argc, char **argv) {
+    sensor_state_t snap;
+
+    (void)argc;
+    (void)argv;
+    sensor_state_read(&snap);
+    console_print("colour ");
+    console_print(color_name(snap.color));
+    console_print("  rgbc ");
+    console_print_u32(snap.r, 0);
+    console_print(" ");
+    console_print_u32(snap.g, 0);
+    console_print(" ");
+    console_print_u32(snap.b, 0);
+    console_print(" ");
+    console_print_u32(snap.c, 0);
+    console_print("  lux ");
+    console_print_u32(snap.lux, 0);
+    console_print("  cct ");
+    console_print_u32(snap.cct, 0);
+    console_print(" K  (");
+    console_print_u32(sensor_state_age_ms(&snap), 0);
+    console_print(" ms old)\n\rgestures ");
+    console_print_u32(snap.gestCnt, 0);
+    console_print("  (up ");
+    console_print_u32(snap.UCount, 0);
+    console_print(", down ");
+    console_print_u32(snap.DCount, 0);
+    console_print(", left ");
+    console_print_u32(snap.LCount, 0);
+    console_print(", right ");
+    console_print_u32(snap.RCount, 0);
+    console_print(")  last ");
+    console_print(gesture_ext_name(snap.gesture));
+    console_print("\n\rdominant ");
+    console_print(color_name(color_stats_dominant()));
+    console_print(", secondary ");
+    console_print(color_name(color_stats_secondary()));
+    console_print("  ");
+    print_brightness();
+}
+
+static void cmd_bright(int argc, char **argv) {
+    if (argc < 2) {
+        print_brightness();
+    } else if (strcmp(argv[1], "auto") == 0) {
+        brightness_set_auto(1);
+    } else {
+        brightness_set_manual((uint16_t)atoi(argv[1]));
+    }
+}
+
+static void cmd_pattern(int argc, char **argv) {
+    static const char *names[] = {"up", "down", "left", "right"};
+    static const gesture_ext_t gestures[] = {GESTURE_EXT_UP, GESTURE_EXT_DOWN, GESTURE_EXT_LEFT, GESTURE_EXT_RIGHT};
+
+    if (argc < 2) {
+        console_print("usage: pattern <up|down|left|right> [colour]\n\r");
+        return;
+    }
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(argv[1], names[i]) == 0) {
+            patternGesture = gestures[i];
+            patternColor = (argc > 2) ? parse_color(argv[2]) : UNKNOWN;
+            patternPending = 1;
+            return;
+        }
+    }
+    console_print("unknown pattern ");
+    console_print(argv[1]);
+    console_print("\n\r");
+}
+
+static void cmd_i2c(int argc, char **argv) {
+    i2c_bus_t *bus;
+    int n = (argc > 1) ? atoi(argv[1]) : 0;
+
+    if (n != 1 && n != 3) {
+        console_print("usage: i2c <1|3> [hz]\n\r");
+        return;
+    }
+    if (n == 3 && !I2C_SPLIT_BUSES) {
+        console_print("i2c3 is not used (I2C_SPLIT_BUSES is 0)\n\r");
+        return;
+    }
+    bus = (n == 3) ? &i2c_bus3 : &i2c_bus1;
+    if (argc > 2 && i2c_busy(bus)) {
+        console_print("busy\n\r"); // Changing the speed would wait for the transfer
+        return;
+    }
+    if (argc > 2 && !i2c_set_speed(bus, (uint32_t)atol(argv[2]))) {
+        console_print("speed out of range (10000-400000)\n\r");
+    }
+    console_print((n == 3) ? "i2c3 at " : "i2c1 at ");
+    console_print_u32(i2c_get_speed(bus), 0);
+    console_print(" Hz\n\r");
+}
+
+/**
+ * Writes the current baud rate.
+ */
+static void print_baud(void) {
+    console_print("baud ");
+    console_print_u32(USART2_GetBaud(), 0);
+    console_print("\n\r");
+}
+
+/**
+ * One-shot task that switches the baud rate once the output queued at the old rate
+ * has drained. It checks again later instead of waiting, so other tasks keep running.
+ */
+static void baud_task(void) {
+    uint32_t baud = baudPending;
+
+    if (!uart_tx_idle() && sched_after("baud", baud_task, CONSOLE_BAUD_POLL_MS) >= 0) {
+        return;
+    }
+    baudPending = 0;
+    if (!USART2_SetBaud(baud)) {
+        console_print("rate out of reach\n\r");
+    }
+    print_baud();
+}
+
+static void cmd_baud(int argc, char **argv) {
+    long baud = (argc > 1) ? atol(argv[1]) : 0;
+
+    if (argc < 2) {
+        print_baud();
+    } else if (baud <= 0) {
+        console_print("rate out of reach\n\r");
+    } else if (baudPending != 0 || sched_after("baud", baud_task, 0) < 0) {
+        console_print("busy\n\r"); // The previous change has not happened yet
+    } else {
+        baudPending = (uint32_t)baud;
+        console_print("switching to ");
+        console_print_u32(baudPending, 0);
+        console_print(" baud\n\r");
+    }
+}
+
+/**
+ * Writes one line of the profiling dump.
+ */
+static void print_counter(const char *label, uint32_t value, const char *unit) {
+    print_padded(label, 16);
+    console_print_u32(value, 0);
+    console_print(unit);
+    console_print("\n\r");
+}
+
+static void cmd_prof(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    print_counter("uptime", now_ms32(), " ms");
+    print_counter("classify", TCS34725_ClassifyCycles(), " cycles");
+    print_counter("gesture match", gesture_template_cycles(), " cycles");
+    print_counter("colour samples", TCS34725_Samples(), "");
+    print_counter("gesture sets", apds9960_datasets(), "");
+    print_counter("uart tx dropped", uart_tx_dropped(), "");
+    print_counter("uart rx lost", uart_rx_overruns(), "");
+    print_counter("log dropped", log_dropped(), "");
+}
+
+static void cmd_gthresh(int argc, char **argv) {
+    apds9960_config_t cfg;
+
+    if (argc > 2) {
+        apds9960_set_thresholds((uint8_t)atoi(argv[1]), (uint8_t)atoi(argv[2]));
+    }
+    apds9960_get_config(&cfg);
+    console_print("enter ");
+    console_print_u32(cfg.enterThresh, 0);
+    console_print(" exit ");
+    console_print_u32(cfg.exitThresh, 0);
+    console_print("\n\r");
+}
+
+static void cmd_truecolor(int argc, char **argv) {
+    if (argc > 1) {
+        LED_SetTrueColorMode(strcmp(argv[1], "on") == 0);
+    }
+    console_print(LED_TrueColorMode() ? "truecolor on\n\r" : "truecolor off\n\r");
+}
+
+/**
+ * One-shot task that stores the calibration. Saving may erase the flash sector, which
+ * stalls the core, so it runs after the command has been answered.
+ */
+static void cal_save_task(void) {
+    calSaveTask = -1;
+    console_print(color_cal_save() ? "calibration saved\n\r" : "calibration save failed\n\r");
+}
+
+// Reference captures: black, white, then the COLOR_CAL_PATCHES patches
+static const char *const calTargets[2 + COLOR_CAL_PATCHES] = {"black", "white", "red", "green", "blue"};
+
+/**
+ * Periodic task that takes one colour reading per integration period for the reference
+ * capture in progress, and applies and reports the capture once all readings are in.
+ */
+static void cal_capture_task(void) {
+    uint16_t r, g, b, c;
+
+    TCS34725_ReadColor(&r, &g, &b, &c);
+    if (!color_cal_add_reading(r, g, b, c)) {
+        return;
+    }
+    sched_cancel(calCaptureTask);
+    calCaptureTask = -1;
+
+    if (calCapture == 0) {
+        color_cal_capture_black();
+        console_print("black level captured\n\r");
+    } else if (calCapture == 1) {
+        console_print(color_cal_capture_white() ? "white balance captured\n\r" : "white reading too dark\n\r");
+    } else {
+        console_print(calTargets[calCapture]);
+        console_print(color_cal_capture_patch(calCapture - 2) ? " patch captured\n\r" : " patch too dark\n\r");
+    }
+}
+
+static void cmd_cal(int argc, char **argv) {
+    if (argc < 2) {
+        console_print("usage: cal <black|white|red|green|blue|matrix|save>\n\r");
+    } else if (strcmp(argv[1], "matrix") == 0) {
+        console_print(color_cal_solve_matrix() ? "correction matrix installed\n\r" :
+                      "capture distinct red, green and blue patches first\n\r");
+    } else if (strcmp(argv[1], "save") == 0) {
+        if (calSaveTask >= 0) {
+            console_print("busy\n\r"); // The previous save has not run yet
+            return;
+        }
+        calSaveTask = sched_after("calsave", cal_save_task, 0);
+        console_print((calSaveTask < 0) ? "busy\n\r" : "saving calibration\n\r");
+    } else {
+        for (uint8_t i = 0; i < sizeof(calTargets) / sizeof(calTargets[0]); i++) {
+            if (strcmp(argv[1], calTargets[i]) != 0) {
+                continue;
+            }
+            if (calCaptureTask >= 0) {
+                console_print("busy\n\r"); // The previous capture has not finished yet
+                return;
+            }
+            color_cal_start_capture();
+            calCapture = i;
+            calCaptureTask = sched_add("calcap", cal_capture_task, COLOR_SAMPLE_MS, 0);
+            if (calCaptureTask < 0) {
+                console_print("busy\n\r");
+                return;
+            }
+            // The first reading must come from an integration that started after the command
+            sched_restart(calCaptureTask, COLOR_SAMPLE_MS);
+            console_print("capturing ");
+            console_print(calTargets[i]);
+            console_print("\n\r");
+            return;
+        }
+        console_print("unknown reference\n\r");
+    }
+}
+
+static void cmd_stream(int argc, char **argv) {
+    uint32_t baud = (argc > 1) ? (uint32_t)atol(argv[1]) : STREAM_BAUD;
+
+    if (!stream_start(baud)) {
+        console_print("rate out of reach\n\r");
+    }
+}
+
+static void cmd_telem(int argc, char **argv) {
+    if (argc > 1) {
+        if (strcmp(argv[1], "on") == 0) {
+            telemetry_set_period(TELEMETRY_PERIOD_MS);
+        } else {
+            telemetry_set_period((uint32_t)atol(argv[1])); // "off" parses as 0
+        }
+    }
+    console_print(telemetry_period() ? "telemetry on, every " : "telemetry off, every ");
+    console_print_u32(telemetry_period(), 0);
+    console_print(" ms\n\r");
+}
+
+static void cmd_tasks(int argc, char **argv) {
+    sched_info_t info;
+
+    (void)argc;
+    (void)argv;
+    for (int id = 0; id < SCHED_MAX_TASKS; id++) {
+        if (sched_task_info(id, &info)) {
+            console_print("  ");
+            print_padded(info.name, 10);
+            console_print(" every ");
+            console_print_u32(info.periodMs, 5);
+            console_print(" ms  events ");
+            print_hex(info.events, 4);
+            console_print("  runs ");
+            console_print_u32(info.runs, 0);
+            console_print("\n\r");
+        }
+    }
+}
+
+static void cmd_clock(int argc, char **argv) {
+    if (argc > 1) {
+        clock_profile_t p;
+
+        for (p = 0; p < CLOCK_PROFILE_COUNT; p++) {
+            if (strcmp(argv[1], clock_profile_name(p)) == 0) {
+                break;
+            }
+        }
+        if (p == CLOCK_PROFILE_COUNT) {
+            console_print("unknown profile\n\r");
+            return;
+        }
+        clock_set_profile(p);
+    }
+    console_print("clock ");
+    console_print(clock_profile_name(clock_profile()));
+    console_print(": hclk ");
+    console_print_u32(clock_hclk_hz(), 0);
+    console_print(" Hz, pclk1 ");
+    console_print_u32(clock_pclk1_hz(), 0);
+    console_print(" Hz, ");
+    print_baud();
+}
+
+static void cmd_power(int argc, char **argv) {
+    power_stats_t stats;
+    uint64_t total = 0;
+
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        power_reset_stats();
+    } else if (argc > 2 && strcmp(argv[1], "stop") == 0) {
+        power_stop_enable(strcmp(argv[2], "on") == 0);
+    }
+    power_get_stats(&stats);
+    for (int s = 0; s < POWER_STATES; s++) {
+        total += stats.us[s];
+    }
+    for (int s = 0; s < POWER_STATES; s++) {
+        uint32_t permille = total ? (uint32_t)(stats.us[s] * 1000 / total) : 0;
+        console_print("  ");
+        print_padded(power_state_name(s), 5);
+        console_print_u32((uint32_t)(stats.us[s] / 1000), 11);
+        console_print(" ms  ");
+        console_print_u32(permille / 10, 3);
+        console_print(".");
+        console_print_u32(permille % 10, 0);
+        console_print("%\n\r");
+    }
+    console_print(power_stop_enabled() ? "stop on, " : "stop off, ");
+    console_print_u32(stats.stops, 0);
+    console_print(" entries, rtc ");
+    console_print(power_rtc_source());
+    console_print("\n\r");
+}
+
+/**
+ * Splits the line into words and runs the matching command.
+ */
+static void run_line(void) {
+    char *argv[CONSOLE_ARGS_MAX];
+    int argc = 0;
+    char *p = line;
+
+    line[lineLen] = '\0';
+    while (*p && argc < CONSOLE_ARGS_MAX) {
+        while (*p == ' ') {
+            *p++ = '\0';
+        }
+        if (*p) {
+            argv[argc++] = p;
+            while (*p && *p != ' ') {
+                p++;
+            }
+        }
+    }
+    if (argc == 0) {
+        return;
+    }
+    for (unsigned i = 0; i < COMMAND_COUNT; i++) {
+        if (strcmp(argv[0], commands[i].name) == 0) {
+            commands[i].handler(argc, argv);
+            return;
+        }
+    }
+    console_print("unknown command ");
+    console_print(argv[0]);
+    console_print(", try help\n\r");
+}
+
+/**
+ * Prints the banner and first prompt.
+ */
+void console_init(void) {
+    console_print("\n\rConsole ready, type help\n\r> ");
+}
+
+/**
+ * Processes the characters received since the last call and runs a completed command.
+ */
+void console_poll(void) {
+    int ch;
+
+    if (inPoll) {
+        return;
+    }
+    if (stream_active()) {
+        // The receiver belongs to the stream until the host sends an exit packet
+        if (stream_poll()) {
+            return;
+        }
+        console_print("> ");
+    }
+    inPoll = 1;
+
+    while ((ch = uart_rx_getc()) >= 0) {
+        if (ch == '\n' && lastWasCr) {
+            lastWasCr = 0;
+            continue;
+        }
+        lastWasCr = (ch == '\r');
+        if (ch == '\r' || ch == '\n') {
+            console_print("\n\r");
+            run_line();
+            lineLen = 0;
+            console_print("> ");
+        } else if (ch == '\b' || ch == 0x7F) {
+            if (lineLen > 0) {
+                lineLen--;
+                console_print("\b \b");
+            }
+        } else if (ch >= ' ' && lineLen < CONSOLE_LINE_MAX - 1) {
+            line[lineLen++] = (char)ch;
+            UART2_TxChar((char)ch);
+        }
+    }
+    inPoll = 0;
+}
+
+/**
+ * Returns 1 while a pattern requested with the "pattern" command is waiting to be shown.
+ */
+int console_pattern_pending(void) {
+    return patternPending;
+}
+
+/**
+ * Takes a pattern requested with the "pattern" command.
+ *
+ * Parameters:
+ * gesture - Receives the gesture whose pattern to show.
+ * color   - Receives the requested colour, UNKNOWN to keep the current one.
+ *
+ * Returns:
+ * int - 1 if a request was pending, 0 otherwise.
+ */
+int console_take_pattern(gesture_ext_t *gesture, PredominantColor *color) {
+    if (!patternPending) {
+        return 0;
+    }
+    *gesture = patternGesture;
+    *color = patternColor;
+    patternPending = 0;
+    return 1;
+}
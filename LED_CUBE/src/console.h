@@ -0,0 +1,75 @@
+/*
+ * console.h
+ *
+ * Description: Interactive command console on USART2.
+ * Characters arrive through the RXNE interrupt; console_poll() edits the current line
+ * and runs a command when Enter is pressed. Polling is cheap and never waits, so it
+ * is called from the idle loop of Delay_ms() and never holds up LED refresh or sensor
+ * reads.
+ */
+
+#ifndef SRC_CONSOLE_H_
+#define SRC_CONSOLE_H_
+
+#include "stdint.h"
+#include "color.h"
+#include "gesture_template.h"
+
+#define CONSOLE_LINE_MAX 64 // Longest command line
+#define CONSOLE_ARGS_MAX 6  // Words per command line
+#define CONSOLE_BAUD_POLL_MS 5 // Check interval while a baud change waits for the output to drain
+
+/**
+ * A console command: handler receives the words of the line, argv[0] being the name.
+ */
+typedef struct {
+    const char *name;
+    void (*handler)(int argc, char **argv);
+    const char *help;
+} console_cmd_t;
+
+/**
+ * Prints the banner and first prompt.
+ */
+void console_init(void);
+
+/**
+ * Processes the characters received since the last call and runs a completed command.
+ */
+void console_poll(void);
+
+/**
+ * Writes a string to the console.
+ *
+ * Parameters:
+ * s - The text, NUL-terminated.
+ */
+void console_print(const char *s);
+
+/**
+ * Writes an unsigned number in decimal to the console.
+ *
+ * Parameters:
+ * value - The number.
+ * width - Minimum field width, filled with leading spaces.
+ */
+void console_print_u32(uint32_t value, uint8_t width);
+
+/**
+ * Returns 1 while a pattern requested with the "pattern" command is waiting to be shown.
+ */
+int console_pattern_pending(void);
+
+/**
+ * Takes a pattern requested with the "pattern" command.
+ *
+ * Parameters:
+ * gesture - Receives the gesture whose pattern to show.
+ * color   - Receives the requested colour, UNKNOWN to keep the current one.
+ *
+ * Returns:
+ * int - 1 if a request was pending, 0 otherwise.
+ */
+int console_take_pattern(gesture_ext_t *gesture, PredominantColor *color);
+
+#endif /* SRC_CONSOLE_H_ */
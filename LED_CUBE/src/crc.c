@@ -0,0 +1,33 @@
+/*
+ * crc.c
+ *
+ * Description: CRC-32 using the STM32 hardware CRC unit.
+ */
+
+#include "crc.h"
+#include "stm32f4xx.h"
+
+/**
+ * Enables the CRC unit clock.
+ */
+void crc_init(void) {
+    RCC->AHB1ENR |= RCC_AHB1ENR_CRCEN;
+}
+
+/**
+ * Computes the CRC-32 of a block of words.
+ *
+ * Parameters:
+ * data  - The words to checksum.
+ * words - Number of words.
+ *
+ * Returns:
+ * uint32_t - The CRC.
+ */
+uint32_t crc32_hw(const uint32_t *data, uint32_t words) {
+    CRC->CR = CRC_CR_RESET;
+    for (uint32_t i = 0; i < words; i++) {
+        CRC->DR = data[i];
+    }
+    return CRC->DR;
+}
@@ -0,0 +1,30 @@
+/*
+ * crc.h
+ *
+ * Description: CRC-32 using the STM32 hardware CRC unit
+ * (polynomial 0x04C11DB7, initial value 0xFFFFFFFF, 32-bit words, no reflection).
+ */
+
+#ifndef SRC_CRC_H_
+#define SRC_CRC_H_
+
+#include "stdint.h"
+
+/**
+ * Enables the CRC unit clock.
+ */
+void crc_init(void);
+
+/**
+ * Computes the CRC-32 of a block of words.
+ *
+ * Parameters:
+ * data  - The words to checksum.
+ * words - Number of words.
+ *
+ * Returns:
+ * uint32_t - The CRC.
+ */
+uint32_t crc32_hw(const uint32_t *data, uint32_t words);
+
+#endif /* SRC_CRC_H_ */
@@ -0,0 +1,117 @@
+/*
+ * frame_codec.c
+ *
+ * Description: Delta/RLE codec for cube frames.
+ * The encoder keeps runs of one or two unchanged bytes inside a literal, where they
+ * cost no more than closing the literal and skipping them.
+ */
+
+#include "frame_codec.h"
+
+#define SKIP_MIN 3 // Shortest unchanged run worth a skip token inside changed data
+
+/**
+ * Returns the XOR of a frame byte against the reference.
+ */
+static inline uint8_t diff_at(const uint8_t *frame, const uint8_t *ref, int i) {
+    return ref ? frame[i] ^ ref[i] : frame[i];
+}
+
+/**
+ * Encodes a frame against a reference.
+ *
+ * Parameters:
+ * frame - The frame to encode.
+ * ref   - The frame the decoder holds, or NULL for a key frame.
+ * out   - Receives at most FRAME_CODEC_MAX_ENCODED bytes.
+ *
+ * Returns:
+ * uint16_t - Encoded length; 0 if the frames are identical.
+ */
+uint16_t frame_encode(const uint8_t *frame, const uint8_t *ref, uint8_t *out) {
+    uint16_t n = 0;
+    int i = 0;
+
+    while (i < FRAME_CODEC_FRAME_BYTES) {
+        int run = 0;
+
+        // Unchanged bytes
+        while (i + run < FRAME_CODEC_FRAME_BYTES && diff_at(frame, ref, i + run) == 0) {
+            run++;
+        }
+        if (i + run == FRAME_CODEC_FRAME_BYTES) {
+            break; // Trailing unchanged bytes are implied
+        }
+        i += run;
+        while (run > 0) {
+            int chunk = (run > FRAME_CODEC_RUN_MAX) ? FRAME_CODEC_RUN_MAX : run;
+            out[n++] = (uint8_t)(chunk - 1);
+            run -= chunk;
+        }
+
+        // Changed bytes, absorbing short unchanged gaps
+        int start = i, zeros = 0;
+        while (i < FRAME_CODEC_FRAME_BYTES && i - start < FRAME_CODEC_RUN_MAX) {
+            if (diff_at(frame, ref, i) == 0) {
+                if (++zeros == SKIP_MIN) {
+                    break;
+                }
+            } else {
+                zeros = 0;
+            }
+            i++;
+        }
+        if (zeros == SKIP_MIN || i == FRAME_CODEC_FRAME_BYTES) {
+            i -= (zeros == SKIP_MIN) ? SKIP_MIN - 1 : zeros; // Leave the gap to a skip token
+        }
+        out[n++] = (uint8_t)(0x80 + (i - start) - 1);
+        for (int k = start; k < i; k++) {
+            out[n++] = diff_at(frame, ref, k);
+        }
+    }
+    return n;
+}
+
+/**
+ * Decodes a frame. Runs in time bounded by the frame size and allocates nothing;
+ * out may equal ref to update a frame in place.
+ *
+ * Parameters:
+ * in  - The encoded frame.
+ * len - Its length.
+ * ref - The reference frame, or NULL for a key frame.
+ * out - Receives FRAME_CODEC_FRAME_BYTES.
+ *
+ * Returns:
+ * int - 1 on success, 0 if the data runs past the end of the frame.
+ */
+int frame_decode(const uint8_t *in, uint16_t len, const uint8_t *ref, uint8_t *out) {
+    uint16_t pos = 0;
+    int i = 0;
+
+    while (pos < len) {
+        uint8_t token = in[pos++];
+        int run = (token & 0x7F) + 1;
+
+        if (i + run > FRAME_CODEC_FRAME_BYTES) {
+            return 0;
+        }
+        if (token & 0x80) {
+            if (pos + run > len) {
+                return 0;
+            }
+            for (int k = 0; k < run; k++, i++) {
+                out[i] = (ref ? ref[i] : 0) ^ in[pos++];
+            }
+        } else {
+            for (int k = 0; k < run; k++, i++) {
+                out[i] = ref ? ref[i] : 0;
+            }
+        }
+    }
+    // Implied unchanged tail
+    for (; i < FRAME_CODEC_FRAME_BYTES; i++) {
+        out[i] = ref ? ref[i] : 0;
+    }
+    return 1;
+}
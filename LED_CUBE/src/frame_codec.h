@@ -0,0 +1,53 @@
+/*
+ * frame_codec.h
+ *
+ * Description: Delta/RLE codec for cube frames (LED_FRAME_BYTES in framebuffer layout).
+ * A frame is coded as its XOR against a reference frame (the previous one, or a blank
+ * frame for a key frame), as a sequence of tokens:
+ *
+ *   0x00-0x7F  skip n + 1 unchanged bytes
+ *   0x80-0xFF  n - 0x7F literal XOR bytes follow
+ *
+ * Unchanged bytes at the end are implied. Each component layer is 8 contiguous bytes,
+ * so an unchanged layer costs at most one token. The host encoder uses the same code.
+ */
+
+#ifndef SRC_FRAME_CODEC_H_
+#define SRC_FRAME_CODEC_H_
+
+#include "stdint.h"
+
+#define FRAME_CODEC_FRAME_BYTES 192 // Three components of 8 x 8 layers
+#define FRAME_CODEC_RUN_MAX     128 // Longest skip or literal run per token
+#define FRAME_CODEC_MAX_ENCODED (FRAME_CODEC_FRAME_BYTES + \
+                                 (FRAME_CODEC_FRAME_BYTES + FRAME_CODEC_RUN_MAX - 1) / FRAME_CODEC_RUN_MAX)
+
+/**
+ * Encodes a frame against a reference.
+ *
+ * Parameters:
+ * frame - The frame to encode.
+ * ref   - The frame the decoder holds, or NULL for a key frame.
+ * out   - Receives at most FRAME_CODEC_MAX_ENCODED bytes.
+ *
+ * Returns:
+ * uint16_t - Encoded length; 0 if the frames are identical.
+ */
+uint16_t frame_encode(const uint8_t *frame, const uint8_t *ref, uint8_t *out);
+
+/**
+ * Decodes a frame. Runs in time bounded by the frame size and allocates nothing;
+ * out may equal ref to update a frame in place.
+ *
+ * Parameters:
+ * in  - The encoded frame.
+ * len - Its length.
+ * ref - The reference frame, or NULL for a key frame.
+ * out - Receives FRAME_CODEC_FRAME_BYTES.
+ *
+ * Returns:
+ * int - 1 on success, 0 if the data runs past the end of the frame.
+ */
+int frame_decode(const uint8_t *in, uint16_t len, const uint8_t *ref, uint8_t *out);
+
+#endif /* SRC_FRAME_CODEC_H_ */
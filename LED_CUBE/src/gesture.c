@@ -14,16 +14,44 @@
 #include "string.h"
 #include "gesture.h"
 #include "i2c.h"
+#include "gesture_classify.h"
+#include "gesture_trace.h"
+#include "telemetry.h"
+#include "gesture_template.h"
+#include "timebase.h"
+#include "sensor_state.h"
 
 
 
-uint8_t gestCnt;
+// Gesture engine settings currently applied to the sensor
+static apds9960_config_t apdsConfig = {
+    .gain = APDS9960_GGAIN_4X,
+    .ledDrive = APDS9960_GLDRIVE_25MA,
+    .waitTime = 7,
+    .pulseLen = APDS9960_GPLEN_16US,
+    .pulseCount = 1,
+    .enterThresh = 0x50,
+    .exitThresh = 0x1F,
+    .offset = {0, 0, 0, 0}
+};
 
-  uint8_t UCount;
-  uint8_t DCount;
+// Acquisition policy state
+static uint8_t lastGValid;         // GVALID seen by the last gesture_data_available()
+static uint32_t lastActiveTick;    // now_ms32() when a hand was last seen
+static uint32_t pollInterval = GESTURE_POLL_IDLE_MS;
+static uint32_t datasetCount;      // Gesture datasets read since start-up
+static uint32_t templateCycles;    // DWT cycles of the last template match
 
-  uint8_t LCount;
-  uint8_t RCount;
+// Gain and pulse combinations tried by the calibration, most sensitive first
+static const uint8_t calCandidates[][2] = {
+    {APDS9960_GGAIN_8X, 8},
+    {APDS9960_GGAIN_4X, 8},
+    {APDS9960_GGAIN_4X, 4},
+    {APDS9960_GGAIN_2X, 4},
+    {APDS9960_GGAIN_4X, 1},
+    {APDS9960_GGAIN_2X, 1},
+    {APDS9960_GGAIN_1X, 1}
+};
 
  /**
  * Initializes the APDS9960 gesture sensor.
@@ -32,29 +60,275 @@ uint8_t gestCnt;
 void apds9960_init()
 {
 	// Enable the sensor and set up gesture detection parameters
-	write_i2c(APDS9960_I2C_ADDRESS, 0x80, 0x01); // ENABLE register: Power ON
+	write_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, 0x80, 0x01); // ENABLE register: Power ON
 
 	// Configure gesture sensor settings
-	write_i2c(APDS9960_I2C_ADDRESS, 0xAA, 0x00); // GCONF3: Both pairs active
-	write_i2c(APDS9960_I2C_ADDRESS, 0xA2, 0x00); // GFIFOTHreshold
-	write_i2c(APDS9960_I2C_ADDRESS, 0xA3, 0x57); // GCONF2: Gesture Gain Control, LED Drive Strength, Gesture Wait Time
-	write_i2c(APDS9960_I2C_ADDRESS, 0xA6, 0x80); // GPULSE: Gesture Pulse Count and Length
-	write_i2c(APDS9960_I2C_ADDRESS, 0xAB, 0x01); // GCONF4: GMODE set to 1
-
-	// Set gesture proximity and offset parameters
-	write_i2c(APDS9960_I2C_ADDRESS, 0xA0, 0x50); // GPENTH: Gesture Proximity Entry Threshold
-	write_i2c(APDS9960_I2C_ADDRESS, 0xA1, 0x1F); // GEXTH: Gesture Exit Threshold
-	write_i2c(APDS9960_I2C_ADDRESS, 0xA4, 0x00); // GOFFSET_U: Gesture Offset UP
-	write_i2c(APDS9960_I2C_ADDRESS, 0xA5, 0x00); // GOFFSET_D: Gesture Offset DOWN
-	write_i2c(APDS9960_I2C_ADDRESS, 0xA7, 0x00); // GOFFSET_L: Gesture Offset LEFT
-	write_i2c(APDS9960_I2C_ADDRESS, 0xA9, 0x00); // GOFFSET_R: Gesture Offset RIGHT
+	write_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, 0xAA, 0x00); // GCONF3: Both pairs active
+	write_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, 0xA2, 0x00); // GFIFOTHreshold
+	write_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, 0xAB, APDS9960_GCONF4_RUN); // GCONF4: GMODE forced or proximity entry
+
+	// Gain, LED drive, pulses, thresholds and offsets
+	apds9960_apply_config(&apdsConfig);
+
+	// Proximity interrupt when a hand comes in range; INT wakes the MCU from Stop mode
+	write_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_PILT, 0x00);
+	write_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_PIHT, GESTURE_PROX_NEAR);
+	write_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_PERS, 0x10); // PPERS: 1 cycle out of range
+	apds9960_clear_interrupt();
 
 	// Finalize configuration
-	write_i2c(APDS9960_I2C_ADDRESS, 0x80, 0x45); // ENABLE register: Gesture Enable + Power ON
+	write_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, 0x80, 0x65); // ENABLE register: Gesture + Proximity interrupt + Proximity + Power ON
 
 	// Reset gesture detection counters
 	resetCounts();
 }
+
+/**
+ * Encodes a signed offset in the sign/magnitude format of the GOFFSET registers.
+ */
+static uint8_t encode_offset(int8_t offset) {
+    if (offset < 0) {
+        return 0x80 | (uint8_t)((offset < -127) ? 127 : -offset);
+    }
+    return (uint8_t)offset & 0x7F;
+}
+
+/**
+ * Writes a complete gesture engine configuration to the sensor.
+ *
+ * Parameters:
+ * cfg - The configuration to apply.
+ */
+void apds9960_apply_config(const apds9960_config_t *cfg) {
+    if (cfg != &apdsConfig) {
+        apdsConfig = *cfg;
+    }
+    apds9960_set_gain(apdsConfig.gain, apdsConfig.ledDrive);
+    apds9960_set_pulses(apdsConfig.pulseLen, apdsConfig.pulseCount);
+    apds9960_set_thresholds(apdsConfig.enterThresh, apdsConfig.exitThresh);
+    apds9960_set_offsets(apdsConfig.offset[0], apdsConfig.offset[1],
+                         apdsConfig.offset[2], apdsConfig.offset[3]);
+}
+
+/**
+ * Copies the currently applied gesture engine configuration.
+ *
+ * Parameters:
+ * cfg - Destination for the configuration.
+ */
+void apds9960_get_config(apds9960_config_t *cfg) {
+    *cfg = apdsConfig;
+}
+
+/**
+ * Sets the gesture gain and LED drive strength.
+ * The gesture wait time is kept from the current configuration.
+ *
+ * Parameters:
+ * gain     - GGAIN value (APDS9960_GGAIN_x).
+ * ledDrive - GLDRIVE value (APDS9960_GLDRIVE_x).
+ */
+void apds9960_set_gain(uint8_t gain, uint8_t ledDrive) {
+    apdsConfig.gain = gain & 0x03;
+    apdsConfig.ledDrive = ledDrive & 0x03;
+    write_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_GCONF2,
+              (apdsConfig.gain << 5) | (apdsConfig.ledDrive << 3) | (apdsConfig.waitTime & 0x07));
+}
+
+/**
+ * Sets the gesture LED pulse length and count.
+ *
+ * Parameters:
+ * pulseLen   - GPLEN value (APDS9960_GPLEN_x).
+ * pulseCount - Number of pulses (1-64).
+ */
+void apds9960_set_pulses(uint8_t pulseLen, uint8_t pulseCount) {
+    if (pulseCount < 1) {
+        pulseCount = 1;
+    } else if (pulseCount > 64) {
+        pulseCount = 64;
+    }
+    apdsConfig.pulseLen = pulseLen & 0x03;
+    apdsConfig.pulseCount = pulseCount;
+    write_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_GPULSE, (apdsConfig.pulseLen << 6) | (pulseCount - 1));
+}
+
+/**
+ * Sets the gesture proximity entry and exit thresholds.
+ *
+ * Parameters:
+ * enter - GPENTH value.
+ * exit  - GEXTH value.
+ */
+void apds9960_set_thresholds(uint8_t enter, uint8_t exit) {
+    apdsConfig.enterThresh = enter;
+    apdsConfig.exitThresh = exit;
+    write_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_GPENTH, enter);
+    write_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_GEXTH, exit);
+}
+
+/**
+ * Sets the crosstalk offsets of the four gesture photodiodes.
+ * A positive offset is subtracted from the channel's counts.
+ *
+ * Parameters:
+ * u, d, l, r - Signed offsets for the UP, DOWN, LEFT and RIGHT channels.
+ */
+void apds9960_set_offsets(int8_t u, int8_t d, int8_t l, int8_t r) {
+    apdsConfig.offset[0] = u;
+    apdsConfig.offset[1] = d;
+    apdsConfig.offset[2] = l;
+    apdsConfig.offset[3] = r;
+    write_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_GOFFSET_U, encode_offset(u));
+    write_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_GOFFSET_D, encode_offset(d));
+    write_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_GOFFSET_L, encode_offset(l));
+    write_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_GOFFSET_R, encode_offset(r));
+}
+
+/**
+ * Limits a calibrated offset to what the sign/magnitude GOFFSET registers hold.
+ */
+static int8_t clamp_offset(int offset) {
+    return (int8_t)((offset > 127) ? 127 : (offset < -127) ? -127 : offset);
+}
+
+/**
+ * Limits a calibrated threshold to the 8-bit GPENTH and GEXTH registers.
+ */
+static uint8_t clamp_threshold(int threshold) {
+    return (uint8_t)((threshold > 255) ? 255 : threshold);
+}
+
+/**
+ * Averages APDS9960_CAL_SAMPLES fresh gesture datasets.
+ *
+ * Parameters:
+ * avg - Receives the U, D, L, R channel averages.
+ *
+ * Returns:
+ * 1 on success, 0 if the FIFO did not fill in time.
+ */
+static int measure_baseline(uint16_t avg[4]) {
+    uint32_t sum[4] = {0, 0, 0, 0};
+    int samples = 0;
+    int polls = 0;
+
+    // Discard datasets taken with the previous settings
+    write_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_GCONF4, APDS9960_GMODE | APDS9960_GFIFO_CLR);
+
+    while (samples < APDS9960_CAL_SAMPLES) {
+        uint8_t level = read_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_GFLVL);
+        if (level == 0) {
+            if (++polls > 5000) {
+                return 0;
+            }
+            continue;
+        }
+        for (int i = 0; i < level && samples < APDS9960_CAL_SAMPLES; i++, samples++) {
+            sum[0] += read_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_GFIFO_U);
+            sum[1] += read_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_GFIFO_D);
+            sum[2] += read_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_GFIFO_L);
+            sum[3] += read_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_GFIFO_R);
+        }
+    }
+    for (int ch = 0; ch < 4; ch++) {
+        avg[ch] = sum[ch] / APDS9960_CAL_SAMPLES;
+    }
+    return 1;
+}
+
+/**
+ * Finds the highest proximity reading over APDS9960_CAL_SAMPLES samples taken
+ * APDS9960_CAL_PROX_MS apart. Must run with the gesture engine stopped so the
+ * proximity engine keeps updating PDATA.
+ *
+ * Returns:
+ * uint8_t - the PDATA crosstalk peak.
+ */
+static uint8_t measure_proximity(void) {
+    uint8_t peak = 0;
+
+    for (int i = 0; i < APDS9960_CAL_SAMPLES; i++) {
+        deadline_t next = deadline_in_ms(APDS9960_CAL_PROX_MS);
+        uint8_t prox = apds9960_read_proximity();
+        if (prox > peak) {
+            peak = prox;
+        }
+        while (!deadline_expired(next)) {
+        }
+    }
+    return peak;
+}
+
+/**
+ * Measures the ambient crosstalk with no hand present, then picks gain, pulse
+ * count, offsets and thresholds for the current installation.
+ * The most sensitive gain/pulse setting whose raw baseline leaves enough headroom
+ * is kept; the residual baseline is then cancelled with the GOFFSET registers.
+ * GPENTH is placed above the PDATA crosstalk and GEXTH above the UDLR residue.
+ *
+ * Returns:
+ * 1 if a usable setting was found, 0 otherwise (defaults are kept).
+ */
+int apds9960_calibrate() {
+    apds9960_config_t saved = apdsConfig;
+    uint16_t avg[4];
+    uint16_t peak = 0;
+    int prox;
+    int found = 0;
+
+    // Sample as fast as possible while calibrating
+    apdsConfig.waitTime = 0;
+    apds9960_set_offsets(0, 0, 0, 0);
+
+    for (unsigned i = 0; i < sizeof(calCandidates) / sizeof(calCandidates[0]); i++) {
+        apds9960_set_gain(calCandidates[i][0], saved.ledDrive);
+        apds9960_set_pulses(saved.pulseLen, calCandidates[i][1]);
+        if (!measure_baseline(avg)) {
+            break;
+        }
+        if (avg[0] <= APDS9960_CAL_MAX_BASELINE && avg[1] <= APDS9960_CAL_MAX_BASELINE &&
+            avg[2] <= APDS9960_CAL_MAX_BASELINE && avg[3] <= APDS9960_CAL_MAX_BASELINE) {
+            found = 1;
+            break;
+        }
+    }
+
+    if (!found) {
+        apds9960_apply_config(&saved);
+        write_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_GCONF4, APDS9960_GCONF4_RUN | APDS9960_GFIFO_CLR);
+        return 0;
+    }
+
+    // Cancel the per-channel crosstalk, then refine once against the residue
+    apds9960_set_offsets(clamp_offset(avg[0]), clamp_offset(avg[1]), clamp_offset(avg[2]), clamp_offset(avg[3]));
+    if (measure_baseline(avg)) {
+        apds9960_set_offsets(clamp_offset(apdsConfig.offset[0] + avg[0] / 2),
+                             clamp_offset(apdsConfig.offset[1] + avg[1] / 2),
+                             clamp_offset(apdsConfig.offset[2] + avg[2] / 2),
+                             clamp_offset(apdsConfig.offset[3] + avg[3] / 2));
+        measure_baseline(avg);
+    }
+    for (int ch = 0; ch < 4; ch++) {
+        if (avg[ch] > peak) {
+            peak = avg[ch];
+        }
+    }
+
+    // Restore the normal sampling rate and hand PDATA back to the proximity engine
+    apdsConfig.waitTime = saved.waitTime;
+    apds9960_set_gain(apdsConfig.gain, apdsConfig.ledDrive);
+    write_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_GCONF4, APDS9960_GCONF4_RUN | APDS9960_GFIFO_CLR);
+
+    // GPENTH is compared against PDATA, GEXTH against the offset-corrected UDLR data
+    prox = measure_proximity() + APDS9960_CAL_ENTER_MARGIN;
+    if (prox < saved.enterThresh) {
+        prox = saved.enterThresh;
+    }
+    apds9960_set_thresholds(clamp_threshold(prox), clamp_threshold(peak + APDS9960_CAL_EXIT_MARGIN));
+    return 1;
+}
+
 /**
  * Checks if the gesture sensor is properly initialized.
  *
@@ -62,11 +336,66 @@ void apds9960_init()
  * 1 if initialization is successful, 0 otherwise.
  */
 int check_gesture_init() {
-    uint8_t x = read_i2c(APDS9960_I2C_ADDRESS, APDS9960_ID);
+    uint8_t x = read_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_ID);
     return (x == 0xAB) ? 1 : 0;
 }
 
 
+/**
+ * Drains the gesture FIFO and hands the datasets to the trace recorder and telemetry.
+ *
+ * Parameters:
+ * samples - Destination for up to GESTURE_FIFO_DEPTH datasets.
+ *
+ * Returns:
+ * Number of datasets read.
+ */
+static int read_gesture_fifo(gesture_sample_t *samples) {
+    uint8_t fifo_level;
+
+    // Read gesture FIFO level and data
+    fifo_level = read_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_GFLVL);
+    if (fifo_level > GESTURE_FIFO_DEPTH) {
+        fifo_level = GESTURE_FIFO_DEPTH;
+    }
+    // The FIFO registers wrap from R back to U, so one burst drains every dataset
+    if (fifo_level) {
+        read_i2c_burst(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_GFIFO_U, (uint8_t *)samples,
+                       fifo_level * sizeof(gesture_sample_t));
+    }
+    datasetCount += fifo_level;
+    gesture_trace_record(samples, fifo_level);
+    telemetry_gfifo(samples, fifo_level);
+    return fifo_level;
+}
+
+/**
+ * Returns the number of gesture datasets read since start-up.
+ */
+uint32_t apds9960_datasets(void) {
+    return datasetCount;
+}
+
+/**
+ * Publishes a detected gesture and updates the gesture counters in the sensor state.
+ */
+static void publish_gesture(gesture_ext_t gesture) {
+    sensor_state_t *state = sensor_state_begin();
+    state->gesture = gesture;
+    state->gestureTimestamp = now_ms32();
+    if (gesture != GESTURE_EXT_NONE) {
+        state->gestCnt++;
+    }
+    switch (gesture) {
+        case GESTURE_EXT_UP:    state->UCount++; break;
+        case GESTURE_EXT_DOWN:  state->DCount++; break;
+        case GESTURE_EXT_LEFT:  state->LCount++; break;
+        case GESTURE_EXT_RIGHT: state->RCount++; break;
+        default: break;
+    }
+    sensor_state_publish();
+}
+
 /**
  * Detects and returns the type of gesture detected by the APDS9960 sensor.
  *
@@ -74,48 +403,56 @@ int check_gesture_init() {
  * gesture_t - the type of gesture detected (e.g., GESTURE_UP, GESTURE_DOWN, etc.).
  */
 gesture_t detect_gesture() {
-    uint8_t fifo_level, u_data, d_data, l_data, r_data, up_down_diff, left_right_diff;
-    gesture_t gesture = GESTURE_NONE;
+    gesture_sample_t samples[GESTURE_FIFO_DEPTH];
+    int count = read_gesture_fifo(samples);
 
-    // Read gesture FIFO level and data, then calculate differences
-    fifo_level = read_i2c(APDS9960_I2C_ADDRESS, 0xAE);
-    for (int i = 0; i < fifo_level; i++) {
-        u_data = read_i2c(APDS9960_I2C_ADDRESS, APDS9960_GFIFO_U);
-        d_data = read_i2c(APDS9960_I2C_ADDRESS, APDS9960_GFIFO_D);
-        l_data = read_i2c(APDS9960_I2C_ADDRESS, APDS9960_GFIFO_L);
-        r_data = read_i2c(APDS9960_I2C_ADDRESS, APDS9960_GFIFO_R);
+    // Determine gesture based on difference values
+    gesture_t gesture = classify_gesture(samples, count); // GESTURE_NONE if no gesture detected
+    publish_gesture((gesture_ext_t)gesture);
+    return gesture;
+}
 
-        up_down_diff += u_data - d_data;
-        left_right_diff += l_data - r_data;
-    }
+/**
+ * Detects a gesture with the extended recognizer.
+ * Circles, double swipes and push-pull come from the template matcher; the four
+ * swipes keep using the difference based decision of detect_gesture().
+ *
+ * Returns:
+ * gesture_ext_t - the detected gesture, or GESTURE_EXT_NONE.
+ */
+gesture_ext_t detect_gesture_ext() {
+    gesture_sample_t samples[GESTURE_FIFO_DEPTH];
+    int count = read_gesture_fifo(samples);
+    // Time the matcher with the DWT cycle counter
+    uint32_t start = DWT->CYCCNT;
+    gesture_ext_t ext = match_gesture_template(samples, count, 0);
+    templateCycles = DWT->CYCCNT - start;
 
-    // Determine gesture based on difference values
-    if (abs(left_right_diff) > abs(up_down_diff)) {
-        if (left_right_diff > GESTURE_THRESHOLD) {
-            gesture = GESTURE_RIGHT;
-        } else if (left_right_diff < -GESTURE_THRESHOLD) {
-            gesture = GESTURE_LEFT;
-        }
-    } else {
-        if (up_down_diff > GESTURE_THRESHOLD) {
-            gesture = GESTURE_UP;
-        } else if (up_down_diff < -GESTURE_THRESHOLD) {
-            gesture = GESTURE_DOWN;
-        }
+    if (ext <= GESTURE_EXT_RIGHT) {
+        ext = (gesture_ext_t)classify_gesture(samples, count);
     }
+    publish_gesture(ext);
+    return ext;
+}
 
-    return gesture; // Return the detected gesture (or GESTURE_NONE if no gesture detected)
+/**
+ * Returns the DWT cycles the last template match took.
+ */
+uint32_t gesture_template_cycles(void) {
+    return templateCycles;
 }
 
 /**
  * Resets the gesture detection counters.
  */
 void resetCounts() {
-    gestCnt = 0;
-    UCount = 0;
-    DCount = 0;
-    LCount = 0;
-    RCount = 0;
+    sensor_state_t *state = sensor_state_begin();
+    state->gestCnt = 0;
+    state->UCount = 0;
+    state->DCount = 0;
+    state->LCount = 0;
+    state->RCount = 0;
+    sensor_state_publish();
 }
 /**
  * Checks if gesture data is available from the sensor.
@@ -124,7 +461,58 @@ void resetCounts() {
  * 1 if data is available, 0 otherwise.
  */
 uint8_t gesture_data_available() {
-    uint8_t gstatus = read_i2c(APDS9960_I2C_ADDRESS, APDS9960_GSTATUS);
-    return (gstatus & 0b00000001) ? 1 : 0;
+    uint8_t gstatus = read_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_GSTATUS);
+    lastGValid = (gstatus & 0b00000001) ? 1 : 0;
+    return lastGValid;
+}
+
+/**
+ * Reads the APDS9960 proximity count.
+ *
+ * Returns:
+ * uint8_t - PDATA, higher when an object is closer.
+ */
+uint8_t apds9960_read_proximity() {
+    return read_i2c(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_PDATA);
+}
+
+/**
+ * Decides how long to wait before the next gesture_data_available() check.
+ * While a hand is in range (proximity above GESTURE_PROX_NEAR or gesture data
+ * pending) the FIFO is drained every GESTURE_POLL_FAST_MS. Once the hand has
+ * been gone for GESTURE_NEAR_HOLD_MS the interval doubles on every check up to
+ * GESTURE_POLL_IDLE_MS, which keeps the I2C bus quiet at idle.
+ *
+ * Returns:
+ * uint32_t - the delay in milliseconds before the next check.
+ */
+uint32_t gesture_poll_interval_ms() {
+    uint8_t prox = apds9960_read_proximity();
+
+    if (lastGValid || prox >= GESTURE_PROX_NEAR) {
+        lastActiveTick = now_ms32();
+        pollInterval = GESTURE_POLL_FAST_MS;
+    } else if (now_ms32() - lastActiveTick >= GESTURE_NEAR_HOLD_MS) {
+        pollInterval *= 2;
+        if (pollInterval > GESTURE_POLL_IDLE_MS) {
+            pollInterval = GESTURE_POLL_IDLE_MS;
+        }
+    }
+    return pollInterval;
+}
+
+/**
+ * Returns 1 while a hand is in range or was seen within the last GESTURE_NEAR_HOLD_MS.
+ */
+int gesture_hand_near(void) {
+    return lastGValid || now_ms32() - lastActiveTick < GESTURE_NEAR_HOLD_MS;
+}
+
+/**
+ * Clears a latched proximity interrupt so the INT pin is released. The interrupt
+ * asserts again when PDATA rises to GESTURE_PROX_NEAR.
+ */
+void apds9960_clear_interrupt(void) {
+    i2c_write_byte(APDS9960_BUS, APDS9960_I2C_ADDRESS, APDS9960_PICLEAR); // Address-only command
 }
 
@@ -13,9 +13,11 @@
 #define SRC_GESTURE_H_
 
 #include "stdint.h"
+#include "i2c.h"
 
 // I2C and GPIO constants for APDS9960
 #define APDS9960_I2C_ADDRESS  0x39 // I2C address of APDS9960
+#define APDS9960_BUS          (&i2c_bus1) // I2C bus the APDS9960 is wired to
 #define APDS9960_GSTATUS      0xAF // Address of the GSTATUS register
 #define APDS9960_ID           0x92 // Device ID register address
 
@@ -23,6 +25,8 @@
 #define I2C1_SCL_PIN          GPIO_PIN_6
 #define I2C1_SDA_PIN          GPIO_PIN_7
 #define I2C1_GPIO_PORT        GPIOB
+#define APDS9960_INT_PORT     GPIOB // INT output: open drain, active low, wakes the MCU from Stop
+#define APDS9960_INT_PIN      0     // PB0, EXTI line 0
 
 // APDS9960 register addresses
 #define APDS9960_ENABLE       0x80
@@ -43,9 +47,65 @@
 #define APDS9960_GFIFO_D      0xFD
 #define APDS9960_GFIFO_L      0xFE
 #define APDS9960_GFIFO_R      0xFF
+#define APDS9960_GFLVL        0xAE
+#define APDS9960_PDATA        0x9C
+#define APDS9960_PILT         0x89 // Proximity interrupt low threshold
+#define APDS9960_PIHT         0x8B // Proximity interrupt high threshold
+#define APDS9960_PERS         0x8C // Interrupt persistence
+#define APDS9960_PICLEAR      0xE5 // Addressing clears the proximity interrupt
+
+// GCONF2 / GPULSE / GCONF4 field values
+#define APDS9960_GGAIN_1X     0x00
+#define APDS9960_GGAIN_2X     0x01
+#define APDS9960_GGAIN_4X     0x02
+#define APDS9960_GGAIN_8X     0x03
+#define APDS9960_GLDRIVE_100MA 0x00
+#define APDS9960_GLDRIVE_50MA  0x01
+#define APDS9960_GLDRIVE_25MA  0x02
+#define APDS9960_GLDRIVE_12MA  0x03
+#define APDS9960_GPLEN_4US    0x00
+#define APDS9960_GPLEN_8US    0x01
+#define APDS9960_GPLEN_16US   0x02
+#define APDS9960_GPLEN_32US   0x03
+#define APDS9960_GMODE        0x01 // GCONF4: keep the gesture engine running
+#define APDS9960_GFIFO_CLR    0x04 // GCONF4: clear the gesture FIFO
+
+// Auto-calibration settings
+#define APDS9960_CAL_SAMPLES      16  // Datasets averaged per measurement
+#define APDS9960_CAL_MAX_BASELINE 40  // Highest acceptable ambient count per channel
+#define APDS9960_CAL_ENTER_MARGIN 40  // GPENTH above the PDATA crosstalk peak
+#define APDS9960_CAL_PROX_MS      2   // Spacing of the PDATA calibration samples
+#define APDS9960_CAL_EXIT_MARGIN  10  // GEXTH above the calibrated baseline
 
 #define GESTURE_THRESHOLD 30 // Threshold for gesture detection
 
+// Proximity-adaptive acquisition policy
+#define GESTURE_ADAPTIVE_POLLING 1   // 1: gesture engine entered on proximity, 0: forced gesture mode
+#define GESTURE_PROX_NEAR        20  // PDATA at which a hand counts as in range
+#define GESTURE_POLL_FAST_MS     5   // Check interval while a hand is in range
+#define GESTURE_POLL_IDLE_MS     500 // Longest check interval with nothing in range
+#define GESTURE_NEAR_HOLD_MS     1000 // Stay fast this long after the hand leaves
+
+#if GESTURE_ADAPTIVE_POLLING
+#define APDS9960_GCONF4_RUN   0x00
+#else
+#define APDS9960_GCONF4_RUN   APDS9960_GMODE
+#endif
+
+/**
+ * Runtime gesture engine settings. Field values use the register encodings above.
+ */
+typedef struct {
+    uint8_t gain;         // GGAIN (APDS9960_GGAIN_x)
+    uint8_t ledDrive;     // GLDRIVE (APDS9960_GLDRIVE_x)
+    uint8_t waitTime;     // GWTIME (0-7)
+    uint8_t pulseLen;     // GPLEN (APDS9960_GPLEN_x)
+    uint8_t pulseCount;   // Number of pulses (1-64)
+    uint8_t enterThresh;  // GPENTH
+    uint8_t exitThresh;   // GEXTH
+    int8_t offset[4];     // GOFFSET_U, GOFFSET_D, GOFFSET_L, GOFFSET_R
+} apds9960_config_t;
+
 // Enumeration for possible gesture types
 typedef enum {
     GESTURE_NONE,   // No gesture detected
@@ -62,6 +122,66 @@ typedef enum {
  */
 void apds9960_init();
 
+/**
+ * Writes a complete gesture engine configuration to the sensor.
+ *
+ * Parameters:
+ * cfg - The configuration to apply.
+ */
+void apds9960_apply_config(const apds9960_config_t *cfg);
+
+/**
+ * Copies the currently applied gesture engine configuration.
+ *
+ * Parameters:
+ * cfg - Destination for the configuration.
+ */
+void apds9960_get_config(apds9960_config_t *cfg);
+
+/**
+ * Sets the gesture gain and LED drive strength.
+ *
+ * Parameters:
+ * gain     - GGAIN value (APDS9960_GGAIN_x).
+ * ledDrive - GLDRIVE value (APDS9960_GLDRIVE_x).
+ */
+void apds9960_set_gain(uint8_t gain, uint8_t ledDrive);
+
+/**
+ * Sets the gesture LED pulse length and count.
+ *
+ * Parameters:
+ * pulseLen   - GPLEN value (APDS9960_GPLEN_x).
+ * pulseCount - Number of pulses (1-64).
+ */
+void apds9960_set_pulses(uint8_t pulseLen, uint8_t pulseCount);
+
+/**
+ * Sets the gesture proximity entry and exit thresholds.
+ *
+ * Parameters:
+ * enter - GPENTH value.
+ * exit  - GEXTH value.
+ */
+void apds9960_set_thresholds(uint8_t enter, uint8_t exit);
+
+/**
+ * Sets the crosstalk offsets of the four gesture photodiodes.
+ *
+ * Parameters:
+ * u, d, l, r - Signed offsets for the UP, DOWN, LEFT and RIGHT channels.
+ */
+void apds9960_set_offsets(int8_t u, int8_t d, int8_t l, int8_t r);
+
+/**
+ * Measures the ambient crosstalk with no hand present, then picks gain, pulse
+ * count, offsets and thresholds for the current installation.
+ *
+ * Returns:
+ * 1 if a usable setting was found, 0 otherwise (defaults are kept).
+ */
+int apds9960_calibrate();
+
 /**
  * Resets the internal gesture detection counts.
  */
@@ -91,4 +211,37 @@ gesture_t detect_gesture();
  */
 uint8_t gesture_data_available();
 
+/**
+ * Reads the APDS9960 proximity count.
+ *
+ * Returns:
+ * uint8_t - PDATA, higher when an object is closer.
+ */
+uint8_t apds9960_read_proximity();
+
+/**
+ * Decides how long to wait before the next gesture_data_available() check,
+ * fast while a hand is in range and backing off to GESTURE_POLL_IDLE_MS at idle.
+ *
+ * Returns:
+ * uint32_t - the delay in milliseconds before the next check.
+ */
+uint32_t gesture_poll_interval_ms();
+
+/**
+ * Returns 1 while a hand is in range or was seen within the last GESTURE_NEAR_HOLD_MS.
+ */
+int gesture_hand_near(void);
+
+/**
+ * Clears a latched proximity interrupt so the INT pin is released. The interrupt
+ * asserts again when PDATA rises to GESTURE_PROX_NEAR.
+ */
+void apds9960_clear_interrupt(void);
+
+/**
+ * Returns the number of gesture datasets read since start-up.
+ */
+uint32_t apds9960_datasets(void);
+
 #endif /* SRC_GESTURE_H_ */
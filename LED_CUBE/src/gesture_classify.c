@@ -0,0 +1,49 @@
+/*
+ * gesture_classify.c
+ *
+ * Description: Hardware independent gesture decision logic shared by the firmware
+ * and the host replay tool.
+ */
+
+#include "gesture_classify.h"
+
+/**
+ * Decides which swipe a sequence of gesture datasets represents.
+ * The UP-DOWN and LEFT-RIGHT differences are summed over the sequence and the
+ * dominant axis decides the direction once it exceeds GESTURE_THRESHOLD.
+ *
+ * Parameters:
+ * samples - The datasets, oldest first.
+ * count   - Number of datasets.
+ *
+ * Returns:
+ * gesture_t - the detected gesture, or GESTURE_NONE.
+ */
+gesture_t classify_gesture(const gesture_sample_t *samples, int count) {
+    int32_t up_down_diff = 0, left_right_diff = 0;
+    gesture_t gesture = GESTURE_NONE;
+
+    for (int i = 0; i < count; i++) {
+        up_down_diff += (int32_t)samples[i].u - samples[i].d;
+        left_right_diff += (int32_t)samples[i].l - samples[i].r;
+    }
+
+    // Determine gesture based on difference values
+    int32_t abs_ud = (up_down_diff < 0) ? -up_down_diff : up_down_diff;
+    int32_t abs_lr = (left_right_diff < 0) ? -left_right_diff : left_right_diff;
+    if (abs_lr > abs_ud) {
+        if (left_right_diff > GESTURE_THRESHOLD) {
+            gesture = GESTURE_RIGHT;
+        } else if (left_right_diff < -GESTURE_THRESHOLD) {
+            gesture = GESTURE_LEFT;
+        }
+    } else {
+        if (up_down_diff > GESTURE_THRESHOLD) {
+            gesture = GESTURE_UP;
+        } else if (up_down_diff < -GESTURE_THRESHOLD) {
+            gesture = GESTURE_DOWN;
+        }
+    }
+
+    return gesture;
+}
@@ -0,0 +1,39 @@
+/*
+ * gesture_classify.h
+ *
+ * Description: Hardware independent gesture decision logic.
+ * The functions here only look at gesture FIFO datasets that were already read from the
+ * APDS9960, so the same code runs on the target and in the host replay tool.
+ */
+
+#ifndef SRC_GESTURE_CLASSIFY_H_
+#define SRC_GESTURE_CLASSIFY_H_
+
+#include "stdint.h"
+#include "gesture.h"
+
+#define GESTURE_FIFO_DEPTH 32 // Datasets held by the APDS9960 gesture FIFO
+
+/**
+ * One gesture FIFO dataset (UP, DOWN, LEFT and RIGHT photodiode counts).
+ */
+typedef struct {
+    uint8_t u;
+    uint8_t d;
+    uint8_t l;
+    uint8_t r;
+} gesture_sample_t;
+
+/**
+ * Decides which swipe a sequence of gesture datasets represents.
+ *
+ * Parameters:
+ * samples - The datasets, oldest first.
+ * count   - Number of datasets.
+ *
+ * Returns:
+ * gesture_t - the detected gesture, or GESTURE_NONE.
+ */
+gesture_t classify_gesture(const gesture_sample_t *samples, int count);
+
+#endif /* SRC_GESTURE_CLASSIFY_H_ */
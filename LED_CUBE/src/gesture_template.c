@@ -0,0 +1,250 @@
+/*
+ * gesture_template.c
+ *
+ * Description: Extended gesture recognizer based on template matching in Q15.
+ * The default templates follow the S-shaped balance of real swipes;
+ * learn_gesture_template() replaces them with demonstrations recorded on the actual
+ * installation, and tools/gesture_replay -t rebuilds the table from recorded traces.
+ */
+
+#include "gesture_template.h"
+
+#define TEMPLATE_COUNT (sizeof(templates) / sizeof(templates[0]))
+#define COST_INF       0x7FFFFFFF
+
+// Default templates (horizontal, vertical and intensity tracks in Q15). A swipe is not a
+// single hump: the hand covers the leading photodiode first and the trailing one last, so
+// the balance on the swipe axis swings one way and then the other (an S curve) while the
+// intensity rises and falls once. The leading lobe carries the sign classify_gesture()
+// decides on.
+static gesture_template_t templates[] = {
+    { GESTURE_EXT_UP, {
+        {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        {0, 7997, 14610, 18698, 19552, 17026, 11556, 4088, -4088, -11556, -17026, -19552, -18698, -14610, -7997, 0},
+        {0, 6813, 13328, 19260, 24351, 28377, 31163, 32587, 32587, 31163, 28377, 24351, 19260, 13328, 6813, 0},
+    } },
+    { GESTURE_EXT_DOWN, {
+        {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        {0, -7997, -14610, -18698, -19552, -17026, -11556, -4088, 4088, 11556, 17026, 19552, 18698, 14610, 7997, 0},
+        {0, 6813, 13328, 19260, 24351, 28377, 31163, 32587, 32587, 31163, 28377, 24351, 19260, 13328, 6813, 0},
+    } },
+    { GESTURE_EXT_LEFT, {
+        {0, -7997, -14610, -18698, -19552, -17026, -11556, -4088, 4088, 11556, 17026, 19552, 18698, 14610, 7997, 0},
+        {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        {0, 6813, 13328, 19260, 24351, 28377, 31163, 32587, 32587, 31163, 28377, 24351, 19260, 13328, 6813, 0},
+    } },
+    { GESTURE_EXT_RIGHT, {
+        {0, 7997, 14610, 18698, 19552, 17026, 11556, 4088, -4088, -11556, -17026, -19552, -18698, -14610, -7997, 0},
+        {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        {0, 6813, 13328, 19260, 24351, 28377, 31163, 32587, 32587, 31163, 28377, 24351, 19260, 13328, 6813, 0},
+    } },
+    { GESTURE_EXT_CIRCLE_CW, {
+        {19660, 17960, 13155, 6075, -2055, -9830, -15905, -19231, -19231, -15905, -9830, -2055, 6075, 13155, 17960, 19660},
+        {0, -7997, -14610, -18698, -19552, -17026, -11556, -4088, 4088, 11556, 17026, 19552, 18698, 14610, 7997, 0},
+        {26214, 26214, 26214, 26214, 26214, 26214, 26214, 26214, 26214, 26214, 26214, 26214, 26214, 26214, 26214, 26214},
+    } },
+    { GESTURE_EXT_CIRCLE_CCW, {
+        {19660, 17960, 13155, 6075, -2055, -9830, -15905, -19231, -19231, -15905, -9830, -2055, 6075, 13155, 17960, 19660},
+        {0, 7997, 14610, 18698, 19552, 17026, 11556, 4088, -4088, -11556, -17026, -19552, -18698, -14610, -7997, 0},
+        {26214, 26214, 26214, 26214, 26214, 26214, 26214, 26214, 26214, 26214, 26214, 26214, 26214, 26214, 26214, 26214},
+    } },
+    { GESTURE_EXT_DOUBLE_LEFT, {
+        {0, -14610, -19552, -11556, 4088, 17026, 18698, 7997, -7997, -18698, -17026, -4088, 11556, 19552, 14610, 0},
+        {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        {0, 13328, 24351, 31163, 32587, 28377, 19260, 6813, 6813, 19260, 28377, 32587, 31163, 24351, 13328, 0},
+    } },
+    { GESTURE_EXT_DOUBLE_RIGHT, {
+        {0, 14610, 19552, 11556, -4088, -17026, -18698, -7997, 7997, 18698, 17026, 4088, -11556, -19552, -14610, 0},
+        {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        {0, 13328, 24351, 31163, 32587, 28377, 19260, 6813, 6813, 19260, 28377, 32587, 31163, 24351, 13328, 0},
+    } },
+    { GESTURE_EXT_PUSH_PULL, {
+        {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+        {0, 6813, 13328, 19260, 24351, 28377, 31163, 32587, 32587, 31163, 28377, 24351, 19260, 13328, 6813, 0},
+    } },
+};
+
+static const char *gestureExtNames[GESTURE_EXT_COUNT] = {
+    "NONE", "UP", "DOWN", "LEFT", "RIGHT",
+    "CIRCLE CW", "CIRCLE CCW", "DOUBLE LEFT", "DOUBLE RIGHT", "PUSH PULL"
+};
+
+/**
+ * Q15 ratio (a - b) / (a + b), 0 when both are zero.
+ */
+static int16_t q15_balance(int32_t a, int32_t b) {
+    int32_t sum = a + b;
+    if (sum == 0) {
+        return 0;
+    }
+    return (int16_t)(((a - b) * 32767) / sum);
+}
+
+/**
+ * Converts a trace to Q15 features and resamples it to GESTURE_TEMPLATE_LEN points
+ * by linear interpolation.
+ *
+ * Parameters:
+ * samples - The datasets, oldest first.
+ * count   - Number of datasets, at least 1.
+ * out     - Receives the horizontal, vertical and intensity tracks.
+ */
+void gesture_template_features(const gesture_sample_t *samples, int count,
+                               int16_t out[GESTURE_TEMPLATE_FEATURES][GESTURE_TEMPLATE_LEN]) {
+    int32_t peak = 1;
+
+    for (int i = 0; i < count; i++) {
+        int32_t sum = samples[i].u + samples[i].d + samples[i].l + samples[i].r;
+        if (sum > peak) {
+            peak = sum;
+        }
+    }
+
+    for (int p = 0; p < GESTURE_TEMPLATE_LEN; p++) {
+        // Source position in Q8
+        int32_t pos = (p * (count - 1) * 256) / (GESTURE_TEMPLATE_LEN - 1);
+        int idx = pos >> 8;
+        int32_t frac = pos & 0xFF;
+        int next = (idx + 1 < count) ? idx + 1 : idx;
+        const gesture_sample_t *s0 = &samples[idx];
+        const gesture_sample_t *s1 = &samples[next];
+        int16_t f0[GESTURE_TEMPLATE_FEATURES], f1[GESTURE_TEMPLATE_FEATURES];
+
+        f0[0] = q15_balance(s0->l, s0->r);
+        f0[1] = q15_balance(s0->u, s0->d);
+        f0[2] = (int16_t)(((s0->u + s0->d + s0->l + s0->r) * 32767) / peak);
+        f1[0] = q15_balance(s1->l, s1->r);
+        f1[1] = q15_balance(s1->u, s1->d);
+        f1[2] = (int16_t)(((s1->u + s1->d + s1->l + s1->r) * 32767) / peak);
+
+        for (int f = 0; f < GESTURE_TEMPLATE_FEATURES; f++) {
+            out[f][p] = (int16_t)(f0[f] + (((int32_t)(f1[f] - f0[f]) * frac) >> 8));
+        }
+    }
+}
+
+/**
+ * L1 distance between point i of a trace and point j of a template.
+ */
+static int32_t point_cost(const int16_t a[GESTURE_TEMPLATE_FEATURES][GESTURE_TEMPLATE_LEN], int i,
+                          const int16_t b[GESTURE_TEMPLATE_FEATURES][GESTURE_TEMPLATE_LEN], int j) {
+    int32_t cost = 0;
+    for (int f = 0; f < GESTURE_TEMPLATE_FEATURES; f++) {
+        int32_t d = (int32_t)a[f][i] - b[f][j];
+        cost += (d < 0) ? -d : d;
+    }
+    return cost;
+}
+
+/**
+ * DTW distance restricted to |i - j| <= GESTURE_TEMPLATE_BAND, two rows of state.
+ */
+static int32_t dtw_distance(const int16_t a[GESTURE_TEMPLATE_FEATURES][GESTURE_TEMPLATE_LEN],
+                            const int16_t b[GESTURE_TEMPLATE_FEATURES][GESTURE_TEMPLATE_LEN]) {
+    int32_t rows[2][GESTURE_TEMPLATE_LEN];
+    int32_t *prev = rows[0], *cur = rows[1];
+
+    for (int j = 0; j < GESTURE_TEMPLATE_LEN; j++) {
+        prev[j] = COST_INF;
+    }
+    for (int i = 0; i < GESTURE_TEMPLATE_LEN; i++) {
+        int lo = (i > GESTURE_TEMPLATE_BAND) ? i - GESTURE_TEMPLATE_BAND : 0;
+        int hi = (i + GESTURE_TEMPLATE_BAND < GESTURE_TEMPLATE_LEN - 1) ? i + GESTURE_TEMPLATE_BAND
+                                                                       : GESTURE_TEMPLATE_LEN - 1;
+        for (int j = 0; j < GESTURE_TEMPLATE_LEN; j++) {
+            cur[j] = COST_INF;
+        }
+        for (int j = lo; j <= hi; j++) {
+            int32_t best;
+            if (i == 0 && j == 0) {
+                best = 0;
+            } else {
+                best = prev[j];
+                if (j > 0 && cur[j - 1] < best) {
+                    best = cur[j - 1];
+                }
+                if (j > 0 && prev[j - 1] < best) {
+                    best = prev[j - 1];
+                }
+            }
+            if (best != COST_INF) {
+                cur[j] = best + point_cost(a, i, b, j);
+            }
+        }
+        int32_t *tmp = prev;
+        prev = cur;
+        cur = tmp;
+    }
+    return prev[GESTURE_TEMPLATE_LEN - 1];
+}
+
+/**
+ * Matches a gesture trace against the stored templates.
+ *
+ * Parameters:
+ * samples - The datasets, oldest first.
+ * count   - Number of datasets.
+ * cost    - Optional; receives the mean DTW cost per point of the best match (Q15).
+ *
+ * Returns:
+ * gesture_ext_t - the best matching gesture, or GESTURE_EXT_NONE if nothing is close enough.
+ */
+gesture_ext_t match_gesture_template(const gesture_sample_t *samples, int count, int32_t *cost) {
+    int16_t trace[GESTURE_TEMPLATE_FEATURES][GESTURE_TEMPLATE_LEN];
+    gesture_ext_t best = GESTURE_EXT_NONE;
+    int32_t bestCost = COST_INF;
+
+    if (count < GESTURE_TEMPLATE_MIN_LEN) {
+        if (cost != 0) {
+            *cost = COST_INF;
+        }
+        return GESTURE_EXT_NONE;
+    }
+
+    gesture_template_features(samples, count, trace);
+    for (unsigned t = 0; t < TEMPLATE_COUNT; t++) {
+        int32_t d = dtw_distance(trace, templates[t].track);
+        if (d < bestCost) {
+            bestCost = d;
+            best = templates[t].gesture;
+        }
+    }
+
+    bestCost /= GESTURE_TEMPLATE_LEN;
+    if (cost != 0) {
+        *cost = bestCost;
+    }
+    return (bestCost <= GESTURE_TEMPLATE_MAX_COST) ? best : GESTURE_EXT_NONE;
+}
+
+/**
+ * Replaces the template of a gesture with one recorded from a demonstration.
+ *
+ * Parameters:
+ * gesture - The gesture the trace shows.
+ * samples - The datasets, oldest first.
+ * count   - Number of datasets.
+ *
+ * Returns:
+ * 1 on success, 0 if the gesture has no template slot or the trace is too short.
+ */
+int learn_gesture_template(gesture_ext_t gesture, const gesture_sample_t *samples, int count) {
+    if (count < GESTURE_TEMPLATE_MIN_LEN) {
+        return 0;
+    }
+    for (unsigned t = 0; t < TEMPLATE_COUNT; t++) {
+        if (templates[t].gesture == gesture) {
+            gesture_template_features(samples, count, templates[t].track);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Returns a printable name for an extended gesture.
+ */
+const char *gesture_ext_name(gesture_ext_t gesture) {
+    return (gesture < GESTURE_EXT_COUNT) ? gestureExtNames[gesture] : "?";
+}
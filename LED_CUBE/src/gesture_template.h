@@ -0,0 +1,102 @@
+/*
+ * gesture_template.h
+ *
+ * Description: Extended gesture recognizer based on template matching.
+ * A gesture trace is reduced to horizontal, vertical and intensity features in Q15,
+ * resampled to a fixed length and compared with stored templates using a
+ * band-limited dynamic time warping (DTW) distance.
+ */
+
+#ifndef SRC_GESTURE_TEMPLATE_H_
+#define SRC_GESTURE_TEMPLATE_H_
+
+#include "stdint.h"
+#include "gesture_classify.h"
+
+#define GESTURE_TEMPLATE_LEN      16    // Points per resampled trace
+#define GESTURE_TEMPLATE_BAND     3     // DTW warping window (points)
+#define GESTURE_TEMPLATE_MIN_LEN  4     // Shortest trace worth matching
+#define GESTURE_TEMPLATE_MAX_COST 12000 // Highest accepted mean cost per point (Q15)
+#define GESTURE_TEMPLATE_FEATURES 3     // Horizontal, vertical, intensity
+
+/**
+ * Gestures known to the extended recognizer. The first five values match gesture_t.
+ */
+typedef enum {
+    GESTURE_EXT_NONE = GESTURE_NONE,
+    GESTURE_EXT_UP = GESTURE_UP,
+    GESTURE_EXT_DOWN = GESTURE_DOWN,
+    GESTURE_EXT_LEFT = GESTURE_LEFT,
+    GESTURE_EXT_RIGHT = GESTURE_RIGHT,
+    GESTURE_EXT_CIRCLE_CW,    // Clockwise circle
+    GESTURE_EXT_CIRCLE_CCW,   // Counter-clockwise circle
+    GESTURE_EXT_DOUBLE_LEFT,  // Two left swipes in one trace
+    GESTURE_EXT_DOUBLE_RIGHT, // Two right swipes in one trace
+    GESTURE_EXT_PUSH_PULL,    // Hand moved towards the sensor and back
+    GESTURE_EXT_COUNT
+} gesture_ext_t;
+
+/**
+ * A stored template: the gesture and its resampled Q15 feature tracks.
+ */
+typedef struct {
+    gesture_ext_t gesture;
+    int16_t track[GESTURE_TEMPLATE_FEATURES][GESTURE_TEMPLATE_LEN];
+} gesture_template_t;
+
+/**
+ * Converts a trace to the resampled Q15 feature tracks that templates are made of.
+ *
+ * Parameters:
+ * samples - The datasets, oldest first.
+ * count   - Number of datasets, at least 1.
+ * out     - Receives the horizontal, vertical and intensity tracks.
+ */
+void gesture_template_features(const gesture_sample_t *samples, int count,
+                               int16_t out[GESTURE_TEMPLATE_FEATURES][GESTURE_TEMPLATE_LEN]);
+
+/**
+ * Matches a gesture trace against the stored templates.
+ *
+ * Parameters:
+ * samples - The datasets, oldest first.
+ * count   - Number of datasets.
+ * cost    - Optional; receives the mean DTW cost per point of the best match (Q15).
+ *
+ * Returns:
+ * gesture_ext_t - the best matching gesture, or GESTURE_EXT_NONE if nothing is close enough.
+ */
+gesture_ext_t match_gesture_template(const gesture_sample_t *samples, int count, int32_t *cost);
+
+/**
+ * Replaces the template of a gesture with one recorded from a demonstration.
+ *
+ * Parameters:
+ * gesture - The gesture the trace shows.
+ * samples - The datasets, oldest first.
+ * count   - Number of datasets.
+ *
+ * Returns:
+ * 1 on success, 0 if the gesture has no template slot or the trace is too short.
+ */
+int learn_gesture_template(gesture_ext_t gesture, const gesture_sample_t *samples, int count);
+
+/**
+ * Returns a printable name for an extended gesture.
+ */
+const char *gesture_ext_name(gesture_ext_t gesture);
+
+/**
+ * Reads the gesture FIFO from the APDS9960 and runs the extended recognizer (gesture.c).
+ *
+ * Returns:
+ * gesture_ext_t - the detected gesture, or GESTURE_EXT_NONE.
+ */
+gesture_ext_t detect_gesture_ext();
+
+/**
+ * Returns the DWT cycles the last template match took on the target (gesture.c).
+ */
+uint32_t gesture_template_cycles(void);
+
+#endif /* SRC_GESTURE_TEMPLATE_H_ */
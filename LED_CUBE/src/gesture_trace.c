@@ -0,0 +1,110 @@
+/*
+ * gesture_trace.c
+ *
+ * Description: Recorder for raw APDS9960 gesture FIFO datasets.
+ */
+
+#include "gesture_trace.h"
+#include "stm32f4xx.h"
+#include "timebase.h"
+#include "uart.h"
+#include "log.h"
+#include "telemetry.h"
+
+static gesture_record_t traceBuf[GESTURE_TRACE_DEPTH];
+static uint16_t traceHead;     // Next slot to write
+static uint16_t traceCount;    // Undownloaded records
+static uint16_t traceBurst;    // Index of the next burst
+static uint32_t traceDropped;  // Records overwritten before download
+static uint8_t traceOn;
+static uint8_t traceDownloading; // Header sent, datasets still being sent
+
+/**
+ * Starts or stops recording.
+ *
+ * Parameters:
+ * on - 1 to record, 0 to stop.
+ */
+void gesture_trace_enable(int on) {
+    traceOn = on ? 1 : 0;
+}
+
+/**
+ * Returns 1 while recording is enabled.
+ */
+int gesture_trace_enabled(void) {
+    return traceOn;
+}
+
+/**
+ * Records one FIFO burst. The oldest undownloaded datasets are overwritten when full.
+ *
+ * Parameters:
+ * samples - The datasets read in this burst.
+ * count   - Number of datasets.
+ */
+void gesture_trace_record(const gesture_sample_t *samples, int count) {
+    uint32_t now = now_ms32();
+
+    if (!traceOn) {
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        gesture_record_t *rec = &traceBuf[traceHead];
+        rec->timestamp = now;
+        rec->burst = traceBurst;
+        rec->sample = samples[i];
+        traceHead = (traceHead + 1) % GESTURE_TRACE_DEPTH;
+        if (traceCount < GESTURE_TRACE_DEPTH) {
+            traceCount++;
+        } else {
+            traceDropped++;
+        }
+    }
+    traceBurst++;
+}
+
+/**
+ * Sends the datasets recorded since the last download over USART2 as TRACE frames, as
+ * many as the transmit ring has room for. A download is larger than the ring, so it is
+ * spread over several calls instead of waiting for the UART, which would stall every task.
+ *
+ * Returns:
+ * int - 1 if datasets are left for the next call, 0 when the download is complete.
+ */
+int gesture_trace_download(void) {
+    uint16_t idx = (traceHead + GESTURE_TRACE_DEPTH - traceCount) % GESTURE_TRACE_DEPTH;
+
+    if (!traceDownloading) {
+        LOG2(LOG_TRACE_DOWNLOAD, traceCount, traceDropped);
+        traceDownloading = 1;
+    }
+    while (traceCount > 0 && uart_tx_free() >= GESTURE_TRACE_FRAME_MAX) {
+        const gesture_record_t *rec = &traceBuf[idx];
+        uint8_t frame[10] = {
+            (uint8_t)rec->burst, (uint8_t)(rec->burst >> 8),
+            (uint8_t)rec->timestamp, (uint8_t)(rec->timestamp >> 8),
+            (uint8_t)(rec->timestamp >> 16), (uint8_t)(rec->timestamp >> 24),
+            rec->sample.u, rec->sample.d, rec->sample.l, rec->sample.r,
+        };
+        log_send_frame(TELEM_FRAME_TRACE, frame, sizeof(frame));
+        idx = (idx + 1) % GESTURE_TRACE_DEPTH;
+        traceCount--;
+    }
+    if (traceCount > 0) {
+        return 1;
+    }
+    traceDropped = 0;
+    traceDownloading = 0;
+    return 0;
+}
+
+/**
+ * Discards all recorded datasets.
+ */
+void gesture_trace_clear(void) {
+    traceHead = 0;
+    traceCount = 0;
+    traceDropped = 0;
+    traceDownloading = 0;
+}
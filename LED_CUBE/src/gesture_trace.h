@@ -0,0 +1,67 @@
+/*
+ * gesture_trace.h
+ *
+ * Description: Recorder for raw APDS9960 gesture FIFO datasets.
+ * Datasets are kept with their SysTick timestamp in a RAM ring buffer and can be
+ * downloaded over USART2 as binary TRACE frames (telemetry.h). tools/telemetry_csv
+ * turns them into the CSV that tools/gesture_replay.c replays offline.
+ */
+
+#ifndef SRC_GESTURE_TRACE_H_
+#define SRC_GESTURE_TRACE_H_
+
+#include "stdint.h"
+#include "gesture_classify.h"
+
+#define GESTURE_TRACE_MODE  0   // Set to 1 to record gestures and download them after each one
+#define GESTURE_TRACE_DEPTH 512 // Datasets held by the ring buffer
+#define GESTURE_TRACE_FRAME_MAX 16 // Wire bytes of one downloaded dataset, the free transmit space needed per frame
+
+/**
+ * One recorded dataset.
+ */
+typedef struct {
+    uint32_t timestamp;      // SysTick milliseconds when the FIFO burst was read
+    uint16_t burst;          // Index of the FIFO burst (one detect_gesture() call)
+    gesture_sample_t sample; // Raw U, D, L, R counts
+} gesture_record_t;
+
+/**
+ * Starts or stops recording.
+ *
+ * Parameters:
+ * on - 1 to record, 0 to stop.
+ */
+void gesture_trace_enable(int on);
+
+/**
+ * Returns 1 while recording is enabled.
+ */
+int gesture_trace_enabled(void);
+
+/**
+ * Records one FIFO burst. The oldest undownloaded datasets are overwritten when full.
+ *
+ * Parameters:
+ * samples - The datasets read in this burst.
+ * count   - Number of datasets.
+ */
+void gesture_trace_record(const gesture_sample_t *samples, int count);
+
+/**
+ * Sends the datasets recorded since the last download over USART2, one TRACE frame
+ * each, and marks them as downloaded. Only as many frames as the transmit ring has
+ * room for are sent, so a download never waits for the UART; call again until it
+ * returns 0.
+ *
+ * Returns:
+ * int - 1 if datasets are left for the next call, 0 when the download is complete.
+ */
+int gesture_trace_download(void);
+
+/**
+ * Discards all recorded datasets.
+ */
+void gesture_trace_clear(void);
+
+#endif /* SRC_GESTURE_TRACE_H_ */
@@ -9,62 +9,205 @@
 #include "gesture.h"
 #include "stdint.h"
 #include "color.h"
+#include "clock.h"
 
+#define I2C_DEFAULT_HZ 100000 // Standard mode
+
+// Phases of an asynchronous register read
+enum {
+    PHASE_ADDR_WRITE, // START sent, device address (write) next
+    PHASE_REG,        // Register address on the wire
+    PHASE_RESTART,    // Repeated START requested
+    PHASE_READ        // Receiving data bytes
+};
+
+/**
+ * An I2C peripheral together with its pins and transfer state.
+ */
+struct i2c_bus {
+    I2C_TypeDef *regs;
+    GPIO_TypeDef *sclPort;
+    uint8_t sclPin, sclAf;
+    GPIO_TypeDef *sdaPort;
+    uint8_t sdaPin, sdaAf;
+    uint32_t apb1Bit;          // Clock enable / reset bit in APB1ENR / APB1RSTR
+    IRQn_Type evIrq, erIrq;
+    uint32_t speed;            // SCL frequency in Hz
+
+    // Asynchronous transfer
+    volatile uint8_t status;   // i2c_status_t
+    uint8_t phase;
+    uint8_t addr, reg;
+    uint8_t *buf;
+    uint8_t len, count;
+};
+
+i2c_bus_t i2c_bus1 = {
+    .regs = I2C1,
+    .sclPort = GPIOB, .sclPin = 6, .sclAf = 4,
+    .sdaPort = GPIOB, .sdaPin = 7, .sdaAf = 4,
+    .apb1Bit = RCC_APB1ENR_I2C1EN,
+    .evIrq = I2C1_EV_IRQn, .erIrq = I2C1_ER_IRQn
+};
+
+i2c_bus_t i2c_bus3 = {
+    .regs = I2C3,
+    .sclPort = GPIOA, .sclPin = 8, .sclAf = 4,
+    .sdaPort = GPIOB, .sdaPin = 4, .sdaAf = 9,
+    .apb1Bit = RCC_APB1ENR_I2C3EN,
+    .evIrq = I2C3_EV_IRQn, .erIrq = I2C3_ER_IRQn
+};
+
+/**
+ * Puts a pin in open-drain alternate function mode with pull-up.
+ */
+static void config_pin(GPIO_TypeDef *port, uint8_t pin, uint8_t af) {
+    // GPIO ports are 0x400 apart, in the same order as their AHB1ENR bits
+    RCC->AHB1ENR |= 1UL << (((uintptr_t)port - (uintptr_t)GPIOA) >> 10);
+
+    port->MODER = (port->MODER & ~(3UL << (2 * pin))) | (2UL << (2 * pin));
+    port->OTYPER |= 1UL << pin;
+    port->PUPDR = (port->PUPDR & ~(3UL << (2 * pin))) | (1UL << (2 * pin));
+    port->AFR[pin >> 3] = (port->AFR[pin >> 3] & ~(0xFUL << (4 * (pin & 7)))) | ((uint32_t)af << (4 * (pin & 7)));
+}
 
 /**
  * Initializes GPIO pins for I2C communication.
- * This function sets GPIOB pins 6 and 7 to alternate function mode for I2C communication.
+ * This function sets the bus's SCL and SDA pins to open-drain alternate function mode
+ * (PB6/PB7 AF4 for I2C1, PA8 AF4 / PB4 AF9 for I2C3).
+ *
+ * Parameters:
+ * bus - The bus whose pins are configured.
  */
-void i2c_gpio_init() {
-    // Enable GPIOB clock
-    RCC->AHB1ENR |= RCC_AHB1ENR_GPIOBEN;
+void i2c_gpio_init(i2c_bus_t *bus) {
+    config_pin(bus->sclPort, bus->sclPin, bus->sclAf);
+    config_pin(bus->sdaPort, bus->sdaPin, bus->sdaAf);
+}
 
-    // Set PB6 and PB7 to alternate function, open-drain, pull-up
-    GPIOB->MODER &= ~(GPIO_MODER_MODER6 | GPIO_MODER_MODER7 );
-    GPIOB->MODER |= (GPIO_MODER_MODER6_1 | GPIO_MODER_MODER7_1 );
-    GPIOB->OTYPER |= (GPIO_OTYPER_OT_6 | GPIO_OTYPER_OT_7 );
-    GPIOB->PUPDR &= ~(GPIO_PUPDR_PUPDR6 | GPIO_PUPDR_PUPDR7 );
-    GPIOB->PUPDR |= (GPIO_PUPDR_PUPDR6_0 | GPIO_PUPDR_PUPDR7_0 );
-    GPIOB->AFR[0] |= (0x04 << (4 * 6)) | (0x04 << (4 * 7)); // AF4 for I2C1
-     //   GPIOB->AFR[1] |= (0x04 << ((8 - 8) * 4)) | (0x04 << ((9 - 8) * 4)); // AF4 for I2C1 (PB8 and PB9)
+/**
+ * Initializes an I2C peripheral.
+ * This function sets up the bus for standard mode with appropriate clock and timing settings
+ * and enables its interrupts in the NVIC for asynchronous transfers.
+ *
+ * Parameters:
+ * bus - The bus to initialize.
+ */
+void i2c_init(i2c_bus_t *bus) {
+    I2C_TypeDef *i2c = bus->regs;
+
+    // Enable the I2C clock
+    RCC->APB1ENR |= bus->apb1Bit;
+
+    // Reset the peripheral
+    RCC->APB1RSTR |= bus->apb1Bit;
+    RCC->APB1RSTR &= ~bus->apb1Bit;
+
+    // Configure the peripheral for the APB1 clock (16 MHz: CCR 80, TRISE 17 at 100 kHz)
+    i2c->CR2 = 0;
+    i2c_set_speed(bus, bus->speed ? bus->speed : I2C_DEFAULT_HZ);
 
+    bus->status = I2C_IDLE;
+    NVIC_EnableIRQ(bus->evIrq);
+    NVIC_EnableIRQ(bus->erIrq);
 }
 
 /**
- * Initializes the I2C1 peripheral.
- * This function sets up I2C1 for standard mode with appropriate clock and timing settings.
+ * Returns nonzero while a transfer is in progress or the bus is not released.
  */
-void i2c_init() {
-    // Enable I2C1 clock
-    RCC->APB1ENR |= RCC_APB1ENR_I2C1EN;
+int i2c_busy(i2c_bus_t *bus) {
+    return bus->status == I2C_BUSY || (bus->regs->SR2 & I2C_SR2_BUSY);
+}
+
+/**
+ * Waits until no transfer is in progress and the bus is released.
+ */
+void i2c_wait_idle(i2c_bus_t *bus) {
+    while (i2c_busy(bus));
+}
 
-    // Reset I2C1
-    RCC->APB1RSTR |= RCC_APB1RSTR_I2C1RST;
-    RCC->APB1RSTR &= ~RCC_APB1RSTR_I2C1RST;
+/**
+ * Sets the SCL frequency, deriving CCR and TRISE from the current APB1 clock.
+ * Up to 100 kHz uses standard mode, above that fast mode (duty 2:1).
+ * Waits for any transfer in progress, as the peripheral has to be disabled.
+ *
+ * Parameters:
+ * bus - The bus to change.
+ * hz  - SCL frequency, 10 kHz to 400 kHz.
+ *
+ * Returns:
+ * int - 1 on success, 0 if the frequency is out of range.
+ */
+int i2c_set_speed(i2c_bus_t *bus, uint32_t hz) {
+    I2C_TypeDef *i2c = bus->regs;
+    uint32_t pclk = clock_pclk1_hz();
+    uint32_t mhz = pclk / 1000000;
+    uint32_t ccr, trise;
+
+    if (hz < 10000 || hz > 400000) {
+        return 0;
+    }
+    if (hz <= 100000) {
+        // Standard mode: Thigh = Tlow = CCR * Tpclk, rise time up to 1000 ns
+        ccr = (pclk + 2 * hz - 1) / (2 * hz); // Round up so SCL never exceeds hz
+        if (ccr < 4) {
+            ccr = 4;
+        }
+        trise = mhz + 1;
+    } else {
+        // Fast mode, duty 2:1: Thigh = CCR * Tpclk, Tlow = 2 * CCR * Tpclk, rise time up to 300 ns
+        ccr = (pclk + 3 * hz - 1) / (3 * hz);
+        if (ccr < 1) {
+            ccr = 1;
+        }
+        ccr |= I2C_CCR_FS;
+        trise = mhz * 300 / 1000 + 1;
+    }
+
+    i2c_wait_idle(bus);
+    i2c->CR1 &= ~I2C_CR1_PE; // Disable I2C
+    i2c->CR2 = (i2c->CR2 & ~I2C_CR2_FREQ) | mhz; // Set APB1 clock frequency
+    i2c->CCR = ccr;
+    i2c->TRISE = trise;
+    i2c->CR1 |= I2C_CR1_PE; // Enable I2C
+    bus->speed = hz;
+    return 1;
+}
 
-    // Configure I2C1
-    I2C1->CR1 &= ~I2C_CR1_PE; // Disable I2C1
-    I2C1->CR2 = 16; // Set APB1 clock frequency
-    I2C1->CCR = 80; // Set CCR for standard mode
-    I2C1->TRISE = 17; // Set TRISE
-    I2C1->CR1 |= I2C_CR1_PE; // Enable I2C1
+/**
+ * Returns the SCL frequency last set on a bus.
+ */
+uint32_t i2c_get_speed(i2c_bus_t *bus) {
+    return bus->speed;
 }
 
 /**
  * Generates an I2C start condition.
- * This function sends an I2C start signal to begin a transmission.
+ * This function sends an I2C start signal to begin a transmission, after any
+ * asynchronous transfer on the bus has finished. That transfer is driven by its
+ * interrupt, which cannot run while a handler or PRIMASK holds it off; there the bus
+ * is reported busy instead of being waited for forever.
+ *
+ * Returns:
+ * int - 1 once the start condition is on the bus, 0 if the bus is busy.
  */
-void i2c_start() {
-    I2C1->CR1 |= I2C_CR1_START; // Generate start condition
-    while (!(I2C1->SR1 & I2C_SR1_SB)); // Wait for start condition to be generated
+int i2c_start(i2c_bus_t *bus) {
+    if (bus->status == I2C_BUSY) {
+        if (__get_IPSR() != 0 || __get_PRIMASK() != 0) {
+            return 0;
+        }
+        while (bus->status == I2C_BUSY); // Let a background transfer finish
+    }
+    bus->regs->CR1 |= I2C_CR1_START; // Generate start condition
+    while (!(bus->regs->SR1 & I2C_SR1_SB)); // Wait for start condition to be generated
+    return 1;
 }
 
 /**
  * Generates an I2C stop condition.
  * This function sends an I2C stop signal to end a transmission.
  */
-void i2c_stop() {
-    I2C1->CR1 |= I2C_CR1_STOP; // Generate stop condition
+void i2c_stop(i2c_bus_t *bus) {
+    bus->regs->CR1 |= I2C_CR1_STOP; // Generate stop condition
 }
 
 /**
@@ -74,10 +217,10 @@ void i2c_stop() {
  * Returns:
  * uint8_t - The byte read from the I2C bus.
  */
-uint8_t i2c_read_ack() {
-    I2C1->CR1 |= I2C_CR1_ACK; // Enable ACK
-    while (!(I2C1->SR1 & I2C_SR1_RXNE)); // Wait until data register is not empty
-    return I2C1->DR;
+uint8_t i2c_read_ack(i2c_bus_t *bus) {
+    bus->regs->CR1 |= I2C_CR1_ACK; // Enable ACK
+    while (!(bus->regs->SR1 & I2C_SR1_RXNE)); // Wait until data register is not empty
+    return bus->regs->DR;
 }
 
 /**
@@ -87,84 +230,136 @@ uint8_t i2c_read_ack() {
  * Returns:
  * uint8_t - The byte read from the I2C bus.
  */
-uint8_t i2c_read_nack() {
-    I2C1->CR1 &= ~I2C_CR1_ACK; // Disable ACK
-    i2c_stop(); // Send stop condition
-    while (!(I2C1->SR1 & I2C_SR1_RXNE)); // Wait until data register is not empty
-    return I2C1->DR;
+uint8_t i2c_read_nack(i2c_bus_t *bus) {
+    bus->regs->CR1 &= ~I2C_CR1_ACK; // Disable ACK
+    i2c_stop(bus); // Send stop condition
+    while (!(bus->regs->SR1 & I2C_SR1_RXNE)); // Wait until data register is not empty
+    return bus->regs->DR;
 }
 
 /**
  * Writes a byte to a specific register of a specified I2C device.
  *
  * Parameters:
+ * bus        - The bus the device is on.
  * deviceAddr - The I2C address of the device.
  * reg        - The register address to write to.
  * data       - The data byte to be written.
+ *
+ * Returns:
+ * int - 1 if the byte was written, 0 if the bus is busy (see i2c_start()).
  */
-void write_i2c(uint8_t deviceAddr, uint8_t reg, uint8_t data) {
+int write_i2c(i2c_bus_t *bus, uint8_t deviceAddr, uint8_t reg, uint8_t data) {
+    I2C_TypeDef *i2c = bus->regs;
+
     // Start I2C transmission
-    i2c_start();
+    if (!i2c_start(bus)) {
+        return 0;
+    }
 
     // Send device address with write operation
-    I2C1->DR = (deviceAddr << 1) | 0;
-    while(!(I2C1->SR1 & I2C_SR1_ADDR));
-    (void)I2C1->SR2;
+    i2c->DR = (deviceAddr << 1) | 0;
+    while(!(i2c->SR1 & I2C_SR1_ADDR));
+    (void)i2c->SR2;
 
     // Send register address
-    I2C1->DR = reg;
-    while(!(I2C1->SR1 & I2C_SR1_TXE));
+    i2c->DR = reg;
+    while(!(i2c->SR1 & I2C_SR1_TXE));
 
     // Send data
-    I2C1->DR = data;
-    while(!(I2C1->SR1 & I2C_SR1_TXE));
+    i2c->DR = data;
+    while(!(i2c->SR1 & I2C_SR1_TXE));
 
     // Stop I2C transmission
-    i2c_stop();
+    i2c_stop(bus);
+    return 1;
+}
+
+/**
+ * Writes a single byte to a device that has no register address, such as a bus multiplexer.
+ * A missing device is detected through the acknowledge failure flag instead of hanging.
+ *
+ * Parameters:
+ * bus        - The bus the device is on.
+ * deviceAddr - The I2C address of the device.
+ * data       - The data byte to be written.
+ *
+ * Returns:
+ * int - 1 if the device acknowledged its address, 0 otherwise or if the bus is busy.
+ */
+int i2c_write_byte(i2c_bus_t *bus, uint8_t deviceAddr, uint8_t data) {
+    I2C_TypeDef *i2c = bus->regs;
+
+    // Start I2C transmission
+    if (!i2c_start(bus)) {
+        return 0;
+    }
+
+    // Send device address with write operation, watching for a NACK
+    i2c->DR = (deviceAddr << 1) | 0;
+    while(!(i2c->SR1 & (I2C_SR1_ADDR | I2C_SR1_AF)));
+    if (i2c->SR1 & I2C_SR1_AF) {
+        i2c->SR1 &= ~I2C_SR1_AF;
+        i2c_stop(bus);
+        return 0;
+    }
+    (void)i2c->SR2;
+
+    // Send data and wait until it has left the shift register
+    i2c->DR = data;
+    while(!(i2c->SR1 & I2C_SR1_BTF));
+
+    // Stop I2C transmission
+    i2c_stop(bus);
+    return 1;
 }
 
 /**
  * Reads a byte from a specific register of a specified I2C device.
  *
  * Parameters:
+ * bus        - The bus the device is on.
  * deviceAddr - The I2C address of the device.
  * reg        - The register address to read from.
  *
  * Returns:
- * uint8_t - The byte read from the specified register.
+ * uint8_t - The byte read from the specified register, 0 if the bus is busy.
  */
-uint8_t read_i2c(uint8_t deviceAddr, uint8_t reg) {
+uint8_t read_i2c(i2c_bus_t *bus, uint8_t deviceAddr, uint8_t reg) {
+    I2C_TypeDef *i2c = bus->regs;
     uint8_t data;
 
     // Start I2C transmission
-    i2c_start();
+    if (!i2c_start(bus)) {
+        return 0;
+    }
 
     // Send device address with write operation
-    I2C1->DR = (deviceAddr << 1) | 0;
-    while(!(I2C1->SR1 & I2C_SR1_ADDR));
-    (void)I2C1->SR2;
+    i2c->DR = (deviceAddr << 1) | 0;
+    while(!(i2c->SR1 & I2C_SR1_ADDR));
+    (void)i2c->SR2;
 
     // Send register address
-    I2C1->DR = reg;
-    while(!(I2C1->SR1 & I2C_SR1_TXE));
+    i2c->DR = reg;
+    while(!(i2c->SR1 & I2C_SR1_TXE));
 
     // Repeated start for read operation
-    i2c_start();
+    i2c_start(bus);
 
     // Send device address with read operation
-    I2C1->DR = (deviceAddr << 1) | 1;
-    while(!(I2C1->SR1 & I2C_SR1_ADDR));
-    (void)I2C1->SR2;
+    i2c->DR = (deviceAddr << 1) | 1;
+    while(!(i2c->SR1 & I2C_SR1_ADDR));
+    (void)i2c->SR2;
 
     // Prepare for reception
-    I2C1->CR1 &= ~I2C_CR1_ACK;
-    I2C1->CR1 |= I2C_CR1_STOP;
+    i2c->CR1 &= ~I2C_CR1_ACK;
+    i2c->CR1 |= I2C_CR1_STOP;
 
     // Receive data
-    while(!(I2C1->SR1 & I2C_SR1_RXNE));
-    data = I2C1->DR;
+    while(!(i2c->SR1 & I2C_SR1_RXNE));
+    data = i2c->DR;
 
-    i2c_stop();
+    i2c_stop(bus);
 
     return data;
 }
@@ -173,53 +368,250 @@ uint8_t read_i2c(uint8_t deviceAddr, uint8_t reg) {
  * Reads a 16-bit word from a specific register of a specified I2C device.
  *
  * Parameters:
+ * bus        - The bus the device is on.
  * deviceAddr - The I2C address of the device.
  * reg        - The register address to read from.
  *
  * Returns:
  * uint16_t - The 16-bit word read from the specified register.
  */
-uint16_t read_i2c_word(uint8_t deviceAddr, uint8_t reg) {
-    uint16_t data = 0;
-    uint8_t data1, data2;
+uint16_t read_i2c_word(i2c_bus_t *bus, uint8_t deviceAddr, uint8_t reg) {
+    uint8_t data[2];
+
+    // Low byte first, as the TCS34725 and APDS9960 store them
+    read_i2c_burst(bus, deviceAddr, reg, data, 2);
+    return ((uint16_t)data[1] << 8) | data[0];
+}
+
+/**
+ * Reads consecutive bytes starting at a register in one transaction.
+ * Every byte but the last is acknowledged. The NACK and STOP for the last byte are
+ * set while the peripheral holds the clock (BTF), as the reference manual describes,
+ * so a slow poll or an interrupt cannot let an extra byte be acknowledged.
+ *
+ * Parameters:
+ * bus        - The bus the device is on.
+ * deviceAddr - The I2C address of the device.
+ * reg        - The first register address to read from.
+ * buf        - Receives the bytes, zeroed if the bus is busy.
+ * len        - Number of bytes to read, at least 1.
+ *
+ * Returns:
+ * int - 1 if the bytes were read, 0 if the bus is busy (see i2c_start()).
+ */
+int read_i2c_burst(i2c_bus_t *bus, uint8_t deviceAddr, uint8_t reg, uint8_t *buf, uint8_t len) {
+    I2C_TypeDef *i2c = bus->regs;
 
     // Start I2C transmission
-    i2c_start();
+    if (!i2c_start(bus)) {
+        for (uint8_t i = 0; i < len; i++) {
+            buf[i] = 0;
+        }
+        return 0;
+    }
 
     // Send device address with write operation
-    I2C1->DR = (deviceAddr << 1) | 0;
-    while(!(I2C1->SR1 & I2C_SR1_ADDR));
-    (void)I2C1->SR2;
+    i2c->DR = (deviceAddr << 1) | 0;
+    while(!(i2c->SR1 & I2C_SR1_ADDR));
+    (void)i2c->SR2;
 
     // Send register address
-    I2C1->DR = reg;
-    while(!(I2C1->SR1 & I2C_SR1_TXE));
+    i2c->DR = reg;
+    while(!(i2c->SR1 & I2C_SR1_TXE));
 
     // Repeated start for read operation
-    i2c_start();
+    i2c_start(bus);
 
     // Send device address with read operation
-    I2C1->DR = (deviceAddr << 1) | 1;
-    while(!(I2C1->SR1 & I2C_SR1_ADDR));
-    (void)I2C1->SR2;
+    i2c->DR = (deviceAddr << 1) | 1;
+    while(!(i2c->SR1 & I2C_SR1_ADDR));
+
+    if (len == 1) {
+        // Single byte: NACK and STOP must be set before ADDR is cleared
+        i2c->CR1 &= ~I2C_CR1_ACK;
+        (void)i2c->SR2;
+        i2c->CR1 |= I2C_CR1_STOP;
+        while(!(i2c->SR1 & I2C_SR1_RXNE));
+        buf[0] = i2c->DR;
+        return 1;
+    }
+
+    if (len == 2) {
+        // Two bytes: with POS set, the NACK applies to the byte after the one in flight
+        i2c->CR1 |= I2C_CR1_POS;
+        i2c->CR1 &= ~I2C_CR1_ACK;
+        (void)i2c->SR2;
+        while(!(i2c->SR1 & I2C_SR1_BTF));
+        i2c->CR1 |= I2C_CR1_STOP;
+        buf[0] = i2c->DR;
+        buf[1] = i2c->DR;
+        i2c->CR1 &= ~I2C_CR1_POS;
+        return 1;
+    }
+
+    i2c->CR1 |= I2C_CR1_ACK;
+    (void)i2c->SR2;
+    for (uint8_t i = 0; i < len - 3; i++) {
+        while(!(i2c->SR1 & I2C_SR1_RXNE));
+        buf[i] = i2c->DR;
+    }
+    // Byte N-2 in DR and N-1 in the shift register, clock held: NACK byte N, then STOP
+    while(!(i2c->SR1 & I2C_SR1_BTF));
+    i2c->CR1 &= ~I2C_CR1_ACK;
+    buf[len - 3] = i2c->DR;
+    i2c->CR1 |= I2C_CR1_STOP;
+    buf[len - 2] = i2c->DR;
+    while(!(i2c->SR1 & I2C_SR1_RXNE));
+    buf[len - 1] = i2c->DR;
+    return 1;
+}
 
-    // Enable ACK for reception of multiple bytes
-    I2C1->CR1 |= I2C_CR1_ACK;
+/**
+ * Starts an interrupt-driven burst read and returns immediately.
+ * The transfer follows the same sequence as read_i2c_burst(), driven by the event
+ * interrupt instead of polling.
+ *
+ * Parameters:
+ * bus        - The bus the device is on.
+ * deviceAddr - The I2C address of the device.
+ * reg        - The first register address to read from.
+ * buf        - Receives the bytes.
+ * len        - Number of bytes to read, at least 1.
+ *
+ * Returns:
+ * int - 1 if the transfer was started, 0 if the bus is busy.
+ */
+int i2c_read_async(i2c_bus_t *bus, uint8_t deviceAddr, uint8_t reg, uint8_t *buf, uint8_t len) {
+    I2C_TypeDef *i2c = bus->regs;
+
+    if (bus->status == I2C_BUSY || len == 0 || (i2c->SR2 & I2C_SR2_BUSY)) {
+        return 0;
+    }
+    bus->addr = deviceAddr;
+    bus->reg = reg;
+    bus->buf = buf;
+    bus->len = len;
+    bus->count = 0;
+    bus->phase = PHASE_ADDR_WRITE;
+    bus->status = I2C_BUSY;
+
+    i2c->CR2 |= I2C_CR2_ITEVTEN | I2C_CR2_ITERREN;
+    i2c->CR1 |= I2C_CR1_START;
+    return 1;
+}
 
-    // Read first byte (MSB)
-    while(!(I2C1->SR1 & I2C_SR1_RXNE));
-    data1 = I2C1->DR;
+/**
+ * Returns the state of the bus's asynchronous transfer. I2C_DONE and I2C_ERROR
+ * are reported once, after which the bus is I2C_IDLE again.
+ */
+i2c_status_t i2c_async_poll(i2c_bus_t *bus) {
+    i2c_status_t status = (i2c_status_t)bus->status;
 
-    // Disable ACK and set STOP bit to prepare for last byte reception
-    I2C1->CR1 &= ~I2C_CR1_ACK;
-    I2C1->CR1 |= I2C_CR1_STOP;
+    if (status == I2C_DONE || status == I2C_ERROR) {
+        bus->status = I2C_IDLE;
+    }
+    return status;
+}
 
-    // Read second byte (LSB)
-    while(!(I2C1->SR1 & I2C_SR1_RXNE));
-    data2 = I2C1->DR;
+/**
+ * Ends an asynchronous transfer and disables its interrupts.
+ */
+static void async_finish(i2c_bus_t *bus, i2c_status_t status) {
+    bus->regs->CR2 &= ~(I2C_CR2_ITEVTEN | I2C_CR2_ITBUFEN | I2C_CR2_ITERREN);
+    bus->status = status;
+}
 
-    // Combine the two bytes
-    data = ((uint16_t)data2 << 8) |(uint16_t) (data1 & 0xff);
+/**
+ * Event interrupt: advances the asynchronous read one step per bus event.
+ */
+static void async_event(i2c_bus_t *bus) {
+    I2C_TypeDef *i2c = bus->regs;
+    uint32_t sr1 = i2c->SR1;
+
+    if (sr1 & I2C_SR1_SB) {
+        // Address after the START (write) or the repeated START (read)
+        if (bus->phase == PHASE_RESTART) {
+            bus->phase = PHASE_READ;
+            i2c->DR = (bus->addr << 1) | 1;
+        } else {
+            i2c->DR = (bus->addr << 1) | 0;
+        }
+    } else if (sr1 & I2C_SR1_ADDR) {
+        if (bus->phase != PHASE_READ) {
+            (void)i2c->SR2;
+            i2c->DR = bus->reg;
+            bus->phase = PHASE_REG;
+        } else if (bus->len == 1) {
+            // Single byte: NACK and STOP must be set before ADDR is cleared
+            i2c->CR1 &= ~I2C_CR1_ACK;
+            (void)i2c->SR2;
+            i2c->CR1 |= I2C_CR1_STOP;
+            i2c->CR2 |= I2C_CR2_ITBUFEN;
+        } else if (bus->len == 2) {
+            // Two bytes: with POS set, the NACK applies to the second; both end at BTF
+            i2c->CR1 |= I2C_CR1_POS;
+            i2c->CR1 &= ~I2C_CR1_ACK;
+            (void)i2c->SR2;
+        } else {
+            i2c->CR1 |= I2C_CR1_ACK;
+            (void)i2c->SR2;
+            if (bus->len > 3) {
+                i2c->CR2 |= I2C_CR2_ITBUFEN; // Otherwise the first event is BTF
+            }
+        }
+    } else if (bus->phase == PHASE_REG && (sr1 & I2C_SR1_BTF)) {
+        // Register address sent: switch to reading
+        bus->phase = PHASE_RESTART;
+        i2c->CR1 |= I2C_CR1_START;
+    } else if (bus->phase == PHASE_READ && (sr1 & I2C_SR1_BTF) && bus->len - bus->count == 3) {
+        // Byte N-2 in DR and N-1 in the shift register, clock held: NACK byte N, then STOP
+        i2c->CR1 &= ~I2C_CR1_ACK;
+        bus->buf[bus->count++] = i2c->DR;
+        i2c->CR1 |= I2C_CR1_STOP;
+        bus->buf[bus->count++] = i2c->DR;
+        i2c->CR2 |= I2C_CR2_ITBUFEN;
+    } else if (bus->phase == PHASE_READ && (sr1 & I2C_SR1_BTF) && bus->len == 2) {
+        i2c->CR1 |= I2C_CR1_STOP;
+        bus->buf[0] = i2c->DR;
+        bus->buf[1] = i2c->DR;
+        i2c->CR1 &= ~I2C_CR1_POS;
+        bus->count = 2;
+        async_finish(bus, I2C_DONE);
+    } else if (bus->phase == PHASE_READ && (sr1 & I2C_SR1_RXNE)) {
+        bus->buf[bus->count++] = i2c->DR;
+        if (bus->count == bus->len) {
+            async_finish(bus, I2C_DONE);
+        } else if (bus->len - bus->count == 3) {
+            // Leave the last three bytes to the BTF sequence above
+            i2c->CR2 &= ~I2C_CR2_ITBUFEN;
+        }
+    }
+}
 
-    return data;
+/**
+ * Error interrupt: aborts the asynchronous transfer on NACK, bus error, arbitration
+ * loss or overrun.
+ */
+static void async_error(i2c_bus_t *bus) {
+    I2C_TypeDef *i2c = bus->regs;
+
+    i2c->SR1 &= ~(I2C_SR1_AF | I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_OVR);
+    i2c->CR1 = (i2c->CR1 & ~I2C_CR1_POS) | I2C_CR1_STOP;
+    async_finish(bus, I2C_ERROR);
+}
+
+void I2C1_EV_IRQHandler(void) {
+    async_event(&i2c_bus1);
+}
+
+void I2C1_ER_IRQHandler(void) {
+    async_error(&i2c_bus1);
+}
+
+void I2C3_EV_IRQHandler(void) {
+    async_event(&i2c_bus3);
+}
+
+void I2C3_ER_IRQHandler(void) {
+    async_error(&i2c_bus3);
 }
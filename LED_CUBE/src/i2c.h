@@ -16,25 +16,84 @@
 
 #include "stdint.h"
 
+#define I2C_SPLIT_BUSES 0 // 1: TCS34725 on I2C3 so it can be read while I2C1 serves the APDS9960
+
+/**
+ * State of a bus's asynchronous transfer.
+ */
+typedef enum {
+    I2C_IDLE,  // No transfer, or the last result was collected
+    I2C_BUSY,  // Transfer in progress
+    I2C_DONE,  // Transfer finished, data in the caller's buffer
+    I2C_ERROR  // Transfer aborted on NACK, bus error or arbitration loss
+} i2c_status_t;
+
+/**
+ * An I2C peripheral together with its pins and transfer state (defined in i2c.c).
+ */
+typedef struct i2c_bus i2c_bus_t;
+
+extern i2c_bus_t i2c_bus1; // I2C1, SCL PB6, SDA PB7
+extern i2c_bus_t i2c_bus3; // I2C3, SCL PA8, SDA PB4
+
 /**
  * Initializes GPIO pins for I2C communication.
+ *
+ * Parameters:
+ * bus - The bus whose pins are configured.
+ */
+void i2c_gpio_init(i2c_bus_t *bus);
+
+/**
+ * Initializes an I2C peripheral for communication.
+ *
+ * Parameters:
+ * bus - The bus to initialize.
  */
-void i2c_gpio_init();
+void i2c_init(i2c_bus_t *bus);
 
 /**
- * Initializes the I2C1 peripheral for communication.
+ * Sets the SCL frequency, deriving CCR and TRISE from the current APB1 clock.
+ * Up to 100 kHz uses standard mode, above that fast mode (duty 2:1).
+ *
+ * Parameters:
+ * bus - The bus to change.
+ * hz  - SCL frequency, 10 kHz to 400 kHz.
+ *
+ * Returns:
+ * int - 1 on success, 0 if the frequency is out of range.
  */
-void i2c_init();
+int i2c_set_speed(i2c_bus_t *bus, uint32_t hz);
 
 /**
- * Generates an I2C start condition.
+ * Returns the SCL frequency last set on a bus.
+ */
+uint32_t i2c_get_speed(i2c_bus_t *bus);
+
+/**
+ * Returns nonzero while a transfer is in progress or the bus is not released.
+ */
+int i2c_busy(i2c_bus_t *bus);
+
+/**
+ * Waits until no transfer is in progress and the bus is released.
+ */
+void i2c_wait_idle(i2c_bus_t *bus);
+
+/**
+ * Generates an I2C start condition, waiting for any asynchronous transfer to finish first.
+ * From an interrupt handler or with interrupts masked that transfer cannot finish, so
+ * the bus is reported busy instead.
+ *
+ * Returns:
+ * int - 1 once the start condition is on the bus, 0 if the bus is busy.
  */
-void i2c_start();
+int i2c_start(i2c_bus_t *bus);
 
 /**
  * Generates an I2C stop condition.
  */
-void i2c_stop();
+void i2c_stop(i2c_bus_t *bus);
 
 /**
  * Reads a byte from the I2C bus with acknowledgment.
@@ -42,7 +101,7 @@ void i2c_stop();
  * Returns:
  * uint8_t - The byte read from the I2C bus.
  */
-uint8_t i2c_read_ack();
+uint8_t i2c_read_ack(i2c_bus_t *bus);
 
 /**
  * Reads a byte from the I2C bus without acknowledgment.
@@ -50,40 +109,97 @@ uint8_t i2c_read_ack();
  * Returns:
  * uint8_t - The byte read from the I2C bus.
  */
-uint8_t i2c_read_nack();
+uint8_t i2c_read_nack(i2c_bus_t *bus);
 
 /**
  * Writes a byte to a specific register of a specified I2C device.
  *
  * Parameters:
+ * bus        - The bus the device is on.
  * deviceAddr - The I2C address of the device.
  * reg        - The register address to write to.
  * data       - The data byte to be written.
+ *
+ * Returns:
+ * int - 1 if the byte was written, 0 if the bus is busy (see i2c_start()).
  */
-void write_i2c(uint8_t deviceAddr, uint8_t reg, uint8_t data);
+int write_i2c(i2c_bus_t *bus, uint8_t deviceAddr, uint8_t reg, uint8_t data);
+
+/**
+ * Writes a single byte to a device that has no register address, such as a bus multiplexer.
+ *
+ * Parameters:
+ * bus        - The bus the device is on.
+ * deviceAddr - The I2C address of the device.
+ * data       - The data byte to be written.
+ *
+ * Returns:
+ * int - 1 if the device acknowledged its address, 0 otherwise or if the bus is busy.
+ */
+int i2c_write_byte(i2c_bus_t *bus, uint8_t deviceAddr, uint8_t data);
 
 /**
  * Reads a byte from a specific register of a specified I2C device.
  *
  * Parameters:
+ * bus        - The bus the device is on.
  * deviceAddr - The I2C address of the device.
  * reg        - The register address to read from.
  *
  * Returns:
- * uint8_t - The byte read from the specified register.
+ * uint8_t - The byte read from the specified register, 0 if the bus is busy.
  */
-uint8_t read_i2c(uint8_t deviceAddr, uint8_t reg);
+uint8_t read_i2c(i2c_bus_t *bus, uint8_t deviceAddr, uint8_t reg);
 
 /**
  * Reads a 16-bit word from a specific register of a specified I2C device.
  *
  * Parameters:
+ * bus        - The bus the device is on.
  * deviceAddr - The I2C address of the device.
  * reg        - The register address to read from.
  *
  * Returns:
  * uint16_t - The 16-bit word read from the specified register.
  */
-uint16_t read_i2c_word(uint8_t deviceAddr, uint8_t reg);
+uint16_t read_i2c_word(i2c_bus_t *bus, uint8_t deviceAddr, uint8_t reg);
+
+/**
+ * Reads consecutive bytes starting at a register in one transaction.
+ * The device must auto-increment its register pointer.
+ *
+ * Parameters:
+ * bus        - The bus the device is on.
+ * deviceAddr - The I2C address of the device.
+ * reg        - The first register address to read from.
+ * buf        - Receives the bytes, zeroed if the bus is busy.
+ * len        - Number of bytes to read, at least 1.
+ *
+ * Returns:
+ * int - 1 if the bytes were read, 0 if the bus is busy (see i2c_start()).
+ */
+int read_i2c_burst(i2c_bus_t *bus, uint8_t deviceAddr, uint8_t reg, uint8_t *buf, uint8_t len);
+
+/**
+ * Starts an interrupt-driven burst read and returns immediately.
+ * Poll i2c_async_poll() for the result; buf must stay valid until then.
+ *
+ * Parameters:
+ * bus        - The bus the device is on.
+ * deviceAddr - The I2C address of the device.
+ * reg        - The first register address to read from.
+ * buf        - Receives the bytes.
+ * len        - Number of bytes to read, at least 1.
+ *
+ * Returns:
+ * int - 1 if the transfer was started, 0 if the bus is busy.
+ */
+int i2c_read_async(i2c_bus_t *bus, uint8_t deviceAddr, uint8_t reg, uint8_t *buf, uint8_t len);
+
+/**
+ * Returns the state of the bus's asynchronous transfer. I2C_DONE and I2C_ERROR
+ * are reported once, after which the bus is I2C_IDLE again.
+ */
+i2c_status_t i2c_async_poll(i2c_bus_t *bus);
 
 #endif /* SRC_I2C_H_ */
@@ -12,20 +12,45 @@
 
 #include "stm32f4xx.h"
 #include "led.h"
+#include "brightness.h"
+#include "clock.h"
+#include "console.h"
+#include "log.h"
+#include "telemetry.h"
+#include "timebase.h"
+#include "power.h"
 
-volatile uint32_t msTicks;  // Variable to store elapsed milliseconds
+// Framebuffer: one bit per LED component, [component][layer][row], bit = column.
+// The patterns draw into ledFrame; LED_Refresh() shows whichever frame shownFrame points at.
+// The PWM slot never scans a frame: the pin masks are built in the drawing context and
+// handed over through nextMask.
+static uint8_t ledFrame[LED_COMPONENTS][LED_CUBE_SIZE][LED_CUBE_SIZE];
+static const uint8_t (*volatile shownFrame)[LED_CUBE_SIZE][LED_CUBE_SIZE] = ledFrame;
+static uint16_t framePins[LED_COMPONENTS]; // Lit pins per component port in ledFrame
+static uint16_t pinRefs[LED_COMPONENTS][16]; // Lit LEDs of ledFrame driven by each pin
+static uint16_t nextMask[LED_COMPONENTS]; // Masks waiting for LED_Refresh()
+static volatile uint8_t maskPending; // nextMask holds a new frame
+static uint16_t portMask[LED_COMPONENTS]; // Lit pins per component port, from the shown frame
+static uint8_t level[LED_COMPONENTS];     // PWM on-phases per component, latched each period
+static uint8_t channelLevel[LED_COMPONENTS] = {LED_PWM_LEVELS, LED_PWM_LEVELS, LED_PWM_LEVELS};
+static uint8_t trueColorMode;
+static volatile uint16_t globalBrightness = BRIGHTNESS_FULL; // Q8 scaler on all levels
+// Pattern being played by LED_PatternStep()
+static gesture_ext_t patternGesture;
+static PredominantColor patternColor;
+static uint16_t patternStep;
+static uint16_t patternSteps;
 
 /**
  * Initializes GPIO for LED control.
- * Sets up GPIO ports A, C, D, and E for output to control the LED matrix.
+ * Sets up GPIO ports C, D, and E for output to control the LED matrix.
  */
 void initGPIO() {
     // Enable GPIO clock for Ports A, C, D, and E
     RCC_AHB1ENR |= (1 << 0) | (1 << 2) | (1 << 3) | (1 << 4);
 
-    // Set GPIOA, GPIOC, GPIOD, GPIOE pins as output
-    GPIOA_MODER &= ~(0xFFFFFFFF);
-    GPIOA_MODER |= 0x55555555; // GPIOA_MODER
+    // Set GPIOC, GPIOD, GPIOE pins as output. GPIOA carries no LEDs and is left alone:
+    // it holds USART2 (PA2/PA3), I2C3 SCL (PA8) and SWD (PA13/PA14).
     GPIOC_MODER &= ~(0xFFFFFFFF);
     GPIOC_MODER |= 0x55555555; // GPIOC_MODER
     GPIOD_MODER &= ~(0xFFFFFFFF);
@@ -34,6 +59,198 @@ void initGPIO() {
     GPIOE_MODER |= 0x55555555; // GPIOE_MODER
 }
 
+/**
+ * Sets the TIM3 period to one PWM slot at the current APB1 timer clock.
+ */
+static void pwm_timer_config(void) {
+    uint32_t clk = clock_tim_apb1_hz();
+    uint32_t psc = (clk + LED_PWM_TIMER_HZ / 2) / LED_PWM_TIMER_HZ;
+
+    if (psc == 0) {
+        psc = 1;
+    }
+    TIM3->PSC = psc - 1;
+    TIM3->ARR = (clk / psc) / (LED_PWM_HZ * LED_PWM_LEVELS) - 1;
+    TIM3->EGR = TIM_EGR_UG; // Load the prescaler now rather than at the next update
+    TIM3->SR = ~TIM_SR_UIF;
+}
+
+/**
+ * Starts TIM3, which paces the PWM slots. Call after initGPIO().
+ */
+void LED_PwmInit(void) {
+    RCC->APB1ENR |= RCC_APB1ENR_TIM3EN;
+    (void)RCC->APB1ENR;
+    TIM3->CR1 = 0;
+    pwm_timer_config();
+    TIM3->DIER = TIM_DIER_UIE;
+    NVIC_EnableIRQ(TIM3_IRQn);
+    TIM3->CR1 = TIM_CR1_ARPE | TIM_CR1_CEN;
+}
+
+/**
+ * Re-derives the TIM3 prescaler and period after a clock profile switch.
+ */
+void LED_ClockChanged(void) {
+    if (TIM3->CR1 & TIM_CR1_CEN) {
+        pwm_timer_config();
+    }
+}
+
+/**
+ * Restarts the PWM slot interrupt, which LED_Refresh() stops while the pins hold.
+ */
+static void pwm_wake(void) {
+    TIM3->DIER |= TIM_DIER_UIE;
+}
+
+/**
+ * TIM3 update interrupt: one PWM slot.
+ */
+void TIM3_IRQHandler(void) {
+    TIM3->SR = ~TIM_SR_UIF;
+    LED_Refresh();
+}
+
+/**
+ * Returns the port pin number driving one LED component.
+ */
+static uint8_t ledPin(int ch, int layer, int row, int col) {
+    LEDPin pin = (ch == 0) ? getRedPin(layer, row, col)
+               : (ch == 1) ? getGreenPin(layer, row, col)
+                           : getBluePin(layer, row, col);
+    return pin.pin & 0x0F;
+}
+
+/**
+ * Hands a set of pin masks over to LED_Refresh(), which takes them at its next slot.
+ */
+static void publishMasks(const uint16_t masks[LED_COMPONENTS]) {
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    for (int ch = 0; ch < LED_COMPONENTS; ch++) {
+        nextMask[ch] = masks[ch];
+    }
+    maskPending = 1;
+    __set_PRIMASK(primask);
+    pwm_wake();
+}
+
+/**
+ * Lights or clears one component of an LED in ledFrame, keeping framePins in step.
+ */
+static void setComponent(int ch, int layer, int row, int col, int on) {
+    uint8_t bit = 1U << col;
+    uint8_t *cell = &ledFrame[ch][layer][row];
+
+    if ((on != 0) == ((*cell & bit) != 0)) {
+        return; // Already in that state
+    }
+    uint8_t pin = ledPin(ch, layer, row, col);
+    if (on) {
+        *cell |= bit;
+        if (pinRefs[ch][pin]++ == 0) {
+            framePins[ch] |= 1U << pin;
+        }
+    } else {
+        *cell &= ~bit;
+        if (--pinRefs[ch][pin] == 0) {
+            framePins[ch] &= ~(1U << pin);
+        }
+    }
+}
+
+
+/**
+ * Lights or clears every LED of a layer.
+ */
+static void patternLayer(int layer, int on) {
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            if (on) {
+                setLED(layer, row, col, patternColor);
+            } else {
+                clearLED(layer, row, col, patternColor);
+            }
+        }
+    }
+}
+
+/**
+ * Lights or clears a vertical line of a layer.
+ */
+static void patternLine(int layer, int col, int on) {
+    for (int row = 0; row < 8; row++) {
+        if (on) {
+            setLED(layer, row, col, patternColor);
+        } else {
+            clearLED(layer, row, col, patternColor);
+        }
+    }
+}
+
+/**
+ * Prepares the pattern for a gesture, to be played with LED_PatternStep().
+ * Up and down light each layer in turn; right and left sweep a line across each layer.
+ *
+ * Parameters:
+ * gesture - The gesture whose pattern to play.
+ * color   - The color in which the pattern is displayed.
+ *
+ * Returns:
+ * int - 1 if the gesture has a pattern, 0 otherwise.
+ */
+int LED_PatternStart(gesture_ext_t gesture, PredominantColor color) {
+    patternGesture = gesture;
+    patternColor = color;
+    patternStep = 0;
+    switch (gesture) {
+        case GESTURE_EXT_UP:
+        case GESTURE_EXT_DOWN:  patternSteps = 2 * 8; break;      // Each layer on, then off
+        case GESTURE_EXT_RIGHT:
+        case GESTURE_EXT_LEFT:  patternSteps = 2 * 8 * 8; break;  // Each line on, then off
+        default:                patternSteps = 0; break;
+    }
+    return patternSteps != 0;
+}
+
+/**
+ * Shows the next step of the pattern; the step stays on display until the next call,
+ * LED_PATTERN_STEP_MS later.
+ *
+ * Returns:
+ * int - 1 if more steps follow, 0 after the last one.
+ */
+int LED_PatternStep(void) {
+    int on = !(patternStep & 1U);
+    int i = patternStep / 2;
+
+    if (patternStep >= patternSteps) {
+        return 0;
+    }
+    switch (patternGesture) {
+        case GESTURE_EXT_UP:    patternLayer(i, on); break;
+        case GESTURE_EXT_DOWN:  patternLayer(7 - i, on); break;
+        case GESTURE_EXT_RIGHT: patternLine(i / 8, i % 8, on); break;
+        case GESTURE_EXT_LEFT:  patternLine(i / 8, 7 - i % 8, on); break;
+        default: break;
+    }
+    patternStep++;
+    return patternStep < patternSteps;
+}
+
+/**
+ * Plays a pattern to the end, blocking.
+ */
+static void playPattern(gesture_ext_t gesture, PredominantColor color) {
+    int more = LED_PatternStart(gesture, color);
+
+    while (more) {
+        more = LED_PatternStep();
+        Delay_ms(LED_PATTERN_STEP_MS);
+    }
+}
 
 /**
  * Displays an upward moving pattern on the LED matrix.
@@ -42,22 +259,7 @@ void initGPIO() {
  * color - The color in which the pattern is displayed.
  */
 void displayUpPattern(PredominantColor color) {
-    for (int layer = 0; layer < 8; layer++) {
-        // Turn on all LEDs in the current layer
-        for (int row = 0; row < 8; row++) {
-            for (int col = 0; col < 8; col++) {
-                setLED(layer, row, col,color);
-            }
-        }
-        Delay_ms(1000);
-        // Turn off all LEDs in the current layer
-        for (int row = 0; row < 8; row++) {
-            for (int col = 0; col < 8; col++) {
-                clearLED(layer, row, col,color);
-            }
-        }
-        Delay_ms(1000);
-    }
+    playPattern(GESTURE_EXT_UP, color);
 }
 
 /**
@@ -67,23 +269,7 @@ void displayUpPattern(PredominantColor color) {
  * color - The color in which the pattern is displayed.
  */
 void displayDownPattern(PredominantColor color) {
-    for (int layer = 7; layer >= 0; layer--) {
-        // Turn on all LEDs in the current layer
-        for (int row = 0; row < 8; row++) {
-            for (int col = 0; col < 8; col++) {
-                setLED(layer, row, col,color);
-            }
-        }
-        Delay_ms(1000);
-
-        // Turn off all LEDs in the current layer
-        for (int row = 0; row < 8; row++) {
-            for (int col = 0; col < 8; col++) {
-                clearLED(layer, row, col,color);
-            }
-        }
-        Delay_ms(1000);
-    }
+    playPattern(GESTURE_EXT_DOWN, color);
 }
 
 /**
@@ -93,20 +279,7 @@ void displayDownPattern(PredominantColor color) {
  * color - The color in which the pattern is displayed.
  */
 void displayRightPattern(PredominantColor color) {
-    for (int layer = 0; layer < 8; layer++) {
-        for (int col = 0; col < 8; col++) {
-            // Turn on a vertical line in the current column
-            for (int row = 0; row < 8; row++) {
-                setLED(layer, row, col,color);
-            }
-            Delay_ms(1000);
-            // Turn off the vertical line in the current column
-            for (int row = 0; row < 8; row++) {
-                clearLED(layer, row, col,color);
-            }
-            Delay_ms(1000);
-        }
-    }
+    playPattern(GESTURE_EXT_RIGHT, color);
 }
 
 /**
@@ -116,24 +289,12 @@ void displayRightPattern(PredominantColor color) {
  * color - The color in which the pattern is displayed.
  */
 void displayLeftPattern(PredominantColor color) {
-    for (int layer = 0; layer < 8; layer++) {
-        for (int col = 7; col >= 0; col--) {
-            // Turn on a vertical line in the current column
-            for (int row = 0; row < 8; row++) {
-                setLED(layer, row, col,color);
-            }
-            Delay_ms(1000);
-            // Turn off the vertical line in the current column
-            for (int row = 0; row < 8; row++) {
-                clearLED(layer, row, col,color);
-            }
-            Delay_ms(1000);
-        }
-    }
+    playPattern(GESTURE_EXT_LEFT, color);
 }
 
 /**
  * Sets an individual LED to a specified color.
+ * The LED is updated in the framebuffer and reaches the pins on the next LED_Refresh().
  *
  * Parameters:
  * layer - The layer of the LED in the matrix.
@@ -142,30 +303,38 @@ void displayLeftPattern(PredominantColor color) {
  * color - The color to set the LED.
  */
 void setLED(int layer, int row, int col,PredominantColor color) {
-	LEDPin redPin = getRedPin(layer, row, col);
-	    LEDPin greenPin = getGreenPin(layer, row, col);
-	    LEDPin bluePin = getBluePin(layer, row, col);
-
-	    // Set or clear the red component
-	    if (color == RED) {
-	        redPin.port->BSRR = (1U << redPin.pin); // Set red pin
-	    } else {
-	        redPin.port->BSRR = (1U << (redPin.pin + 16)); // Reset red pin
-	    }
+    uint8_t mask = colorMask(color);
 
-	    // Set or clear the green component
-	    if (color==GREEN) {
-	        greenPin.port->BSRR = (1U << greenPin.pin); // Set green pin
-	    } else {
-	        greenPin.port->BSRR = (1U << (greenPin.pin + 16)); // Reset green pin
-	    }
+    // Set or clear each component
+    for (int ch = 0; ch < LED_COMPONENTS; ch++) {
+        setComponent(ch, layer, row, col, (mask & (1U << ch)) != 0);
+    }
+    if (shownFrame == ledFrame) {
+        publishMasks(framePins);
+    }
+}
 
-	    // Set or clear the blue component
-	    if (color==BLUE) {
-	        bluePin.port->BSRR = (1U << bluePin.pin); // Set blue pin
-	    } else {
-	        bluePin.port->BSRR = (1U << (bluePin.pin + 16)); // Reset blue pin
-	    }
+/**
+ * Returns which LED components are lit for a color.
+ *
+ * Parameters:
+ * color - The color to display.
+ *
+ * Returns:
+ * uint8_t - A combination of LED_MASK_RED, LED_MASK_GREEN and LED_MASK_BLUE.
+ */
+uint8_t colorMask(PredominantColor color) {
+    switch (color) {
+        case RED:     return LED_MASK_RED;
+        case GREEN:   return LED_MASK_GREEN;
+        case BLUE:    return LED_MASK_BLUE;
+        case YELLOW:
+        case ORANGE:  return LED_MASK_RED | LED_MASK_GREEN;
+        case CYAN:    return LED_MASK_GREEN | LED_MASK_BLUE;
+        case MAGENTA: return LED_MASK_RED | LED_MASK_BLUE;
+        case WHITE:   return LED_MASK_RED | LED_MASK_GREEN | LED_MASK_BLUE;
+        default:      return 0;
+    }
 }
 
 /**
@@ -178,15 +347,162 @@ void setLED(int layer, int row, int col,PredominantColor color) {
  * color - The color to clear from the LED.
  */
 void clearLED(int layer, int row, int col, PredominantColor color) {
-    // Get the GPIO pins for the red, green, and blue components
-    LEDPin redPin = getRedPin(layer, row, col);
-    LEDPin greenPin = getGreenPin(layer, row, col);
-    LEDPin bluePin = getBluePin(layer, row, col);
-
     // Reset the color components
-    redPin.port->BSRR = (1U << (redPin.pin + 16)); // Reset red pin
-    greenPin.port->BSRR = (1U << (greenPin.pin + 16)); // Reset green pin
-    bluePin.port->BSRR = (1U << (bluePin.pin + 16)); // Reset blue pin
+    for (int ch = 0; ch < LED_COMPONENTS; ch++) {
+        setComponent(ch, layer, row, col, 0);
+    }
+    if (shownFrame == ledFrame) {
+        publishMasks(framePins);
+    }
+}
+
+/**
+ * Sets the PWM level of each LED component.
+ *
+ * Parameters:
+ * rgb - Component duties, 0-255.
+ */
+void LED_SetLevels(rgb_t rgb) {
+    channelLevel[0] = (rgb.r * LED_PWM_LEVELS + 127) / 255;
+    channelLevel[1] = (rgb.g * LED_PWM_LEVELS + 127) / 255;
+    channelLevel[2] = (rgb.b * LED_PWM_LEVELS + 127) / 255;
+    pwm_wake();
+}
+
+/**
+ * Sets the global brightness applied on top of the component levels.
+ * Takes effect on the next PWM period without touching the framebuffer.
+ *
+ * Parameters:
+ * scaler - Brightness, 0 to BRIGHTNESS_FULL.
+ */
+void LED_SetBrightness(uint16_t scaler) {
+    globalBrightness = (scaler > BRIGHTNESS_FULL) ? BRIGHTNESS_FULL : scaler;
+    pwm_wake();
+}
+
+/**
+ * Enables or disables true-colour mode.
+ * In true-colour mode patterns should be drawn in WHITE; the colour comes from
+ * the component levels set with LED_SetLevels(). Leaving the mode restores full levels.
+ *
+ * Parameters:
+ * on - 1 to enable, 0 to disable.
+ */
+void LED_SetTrueColorMode(int on) {
+    trueColorMode = on ? 1 : 0;
+    if (!trueColorMode) {
+        rgb_t full = {255, 255, 255};
+        LED_SetLevels(full);
+    }
+}
+
+/**
+ * Returns 1 while true-colour mode is enabled.
+ */
+int LED_TrueColorMode(void) {
+    return trueColorMode;
+}
+
+/**
+ * Builds the per-port pin mask of one component from a frame.
+ */
+static uint16_t buildPortMask(const uint8_t (*frame)[LED_CUBE_SIZE][LED_CUBE_SIZE], int ch) {
+    uint16_t mask = 0;
+    for (int layer = 0; layer < LED_CUBE_SIZE; layer++) {
+        for (int row = 0; row < LED_CUBE_SIZE; row++) {
+            uint8_t bits = frame[ch][layer][row];
+            for (int col = 0; bits != 0; col++, bits >>= 1) {
+                if (bits & 1U) {
+                    mask |= 1U << ledPin(ch, layer, row, col);
+                }
+            }
+        }
+    }
+    return mask;
+}
+
+/**
+ * Shows an externally owned frame instead of the pattern framebuffer.
+ * Only the pointer changes hands, so a producer can fill one buffer while another is
+ * on display and swap them without copying. The frame must stay valid until replaced.
+ * Its pin masks are built here, in the caller's context, rather than in a PWM slot.
+ *
+ * Parameters:
+ * frame - LED_FRAME_BYTES in framebuffer layout, or NULL to show the patterns again.
+ */
+void LED_ShowFrame(const uint8_t *frame) {
+    const uint8_t (*shown)[LED_CUBE_SIZE][LED_CUBE_SIZE] = ledFrame;
+    uint16_t masks[LED_COMPONENTS];
+
+    if (frame) {
+        shown = (const uint8_t (*)[LED_CUBE_SIZE][LED_CUBE_SIZE])frame;
+        for (int ch = 0; ch < LED_COMPONENTS; ch++) {
+            masks[ch] = buildPortMask(shown, ch);
+        }
+    } else {
+        for (int ch = 0; ch < LED_COMPONENTS; ch++) {
+            masks[ch] = framePins[ch];
+        }
+    }
+    shownFrame = shown;
+    publishMasks(masks);
+}
+
+/**
+ * Drives the LED pins for one slot of per-component software PWM.
+ * Called from TIM3_IRQHandler(). Each component has its own GPIO port, so a PWM edge
+ * is a single BSRR write; a new frame arrives as ready-made masks. Once every pin holds
+ * its level the slot interrupt stops until the frame or a level changes.
+ */
+void LED_Refresh(void) {
+    static GPIO_TypeDef *const ports[LED_COMPONENTS] = {GPIOC, GPIOD, GPIOE};
+    static uint8_t lastOn[LED_COMPONENTS];
+    static uint8_t phase;
+    uint8_t dirty = maskPending;
+
+    if (dirty) {
+        for (int ch = 0; ch < LED_COMPONENTS; ch++) {
+            portMask[ch] = nextMask[ch];
+        }
+        maskPending = 0;
+    }
+    phase = (phase + 1) % LED_PWM_LEVELS;
+    if (phase == 0) {
+        // Latch the scaled levels once per PWM period so a change never splits a period
+        for (int ch = 0; ch < LED_COMPONENTS; ch++) {
+            level[ch] = (channelLevel[ch] * globalBrightness + BRIGHTNESS_FULL / 2) / BRIGHTNESS_FULL;
+        }
+    }
+    for (int ch = 0; ch < LED_COMPONENTS; ch++) {
+        uint8_t on = phase < level[ch];
+        if (dirty || on != lastOn[ch]) {
+            uint16_t lit = on ? portMask[ch] : 0;
+            ports[ch]->BSRR = lit | ((uint32_t)(uint16_t)~lit << 16);
+            lastOn[ch] = on;
+        }
+    }
+    // Levels change only at phase 0, so the pins are final once a period starts steady
+    if (phase == 0 && LED_CanHold()) {
+        TIM3->DIER &= ~TIM_DIER_UIE;
+    }
+}
+
+/**
+ * Returns 1 when the LED pins would keep their levels without LED_Refresh(): no new
+ * frame is waiting to be shown and no channel is being dimmed by PWM. The clocks may
+ * then be stopped without the cube flickering or freezing half-dimmed.
+ */
+int LED_CanHold(void) {
+    if (maskPending) {
+        return 0;
+    }
+    for (int ch = 0; ch < LED_COMPONENTS; ch++) {
+        if (portMask[ch] != 0 && level[ch] != 0 && level[ch] < LED_PWM_LEVELS) {
+            return 0;
+        }
+    }
+    return 1;
 }
 
 /**
@@ -259,8 +575,14 @@ LEDPin getBluePin(int layer, int row, int col) {
  * ms - The number of milliseconds to delay.
  */
 void Delay_ms(uint32_t ms) {
-    msTicks = ms;  // Set the global variable with the desired delay
-    while (msTicks != 0) {
-        // Wait until the SysTick_Handler decrements the counter to zero
+    deadline_t deadline = deadline_in_ms(ms);
+
+    while (!deadline_expired(deadline)) {
+        // Serve console commands and send queued log records and telemetry meanwhile,
+        // sleeping until the next interrupt (SysTick at the latest) in between
+        console_poll();
+        log_poll();
+        telemetry_poll();
+        power_wait();
     }
 }
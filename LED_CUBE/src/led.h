@@ -16,6 +16,8 @@
 #include "color.h"
 #include "gesture.h"
 #include "stdint.h"
+#include "color_transform.h"
+#include "gesture_template.h"
 
 // Register addresses for GPIO port modes and output data registers
 #define RCC_AHB1ENR   (*((volatile uint32_t*)0x40023830))
@@ -29,20 +31,51 @@
 #define GPIOE_ODR (*((volatile uint32_t*)0x40021014))
 
 
+#define LED_CUBE_SIZE  8  // LEDs per edge
+#define LED_COMPONENTS 3  // Red, green, blue
+#define LED_PWM_LEVELS 16  // Brightness steps per component (one step per PWM timer slot)
+#define LED_PWM_HZ     200 // PWM periods per second, well above visible flicker
+#define LED_PWM_TIMER_HZ 1000000 // TIM3 count rate; the slot length is counted in it
+#define LED_PATTERN_STEP_MS 1000 // Time each pattern step stays on display
+#define LED_FRAME_BYTES (LED_COMPONENTS * LED_CUBE_SIZE * LED_CUBE_SIZE) // [component][layer][row], bit = column
+
+// LED component masks
+#define LED_MASK_RED   0x01
+#define LED_MASK_GREEN 0x02
+#define LED_MASK_BLUE  0x04
+
 // Structure for LED pin configuration
 typedef struct {
     GPIO_TypeDef* port; // GPIO port
     uint16_t pin;       // GPIO pin number
 } LEDPin;
 
-extern volatile uint32_t msTicks;  // Variable to store elapsed milliseconds
-
 /**
  * Initializes GPIO for LED control.
  * Sets up GPIO ports for output to control the LED matrix.
  */
 void initGPIO();
 
+/**
+ * Prepares the pattern for a gesture, to be played with LED_PatternStep().
+ *
+ * Parameters:
+ * gesture - The gesture whose pattern to play.
+ * color   - The color in which the pattern is displayed.
+ *
+ * Returns:
+ * int - 1 if the gesture has a pattern, 0 otherwise.
+ */
+int LED_PatternStart(gesture_ext_t gesture, PredominantColor color);
+
+/**
+ * Shows the next step of the pattern; call every LED_PATTERN_STEP_MS.
+ *
+ * Returns:
+ * int - 1 if more steps follow, 0 after the last one.
+ */
+int LED_PatternStep(void);
+
 /**
  * Displays an upward moving pattern on the LED matrix.
  *
@@ -86,6 +119,17 @@ void displayLeftPattern(PredominantColor color);
  */
 void setLED(int layer, int row, int col, PredominantColor color);
 
+/**
+ * Returns which LED components are lit for a color.
+ *
+ * Parameters:
+ * color - The color to display.
+ *
+ * Returns:
+ * uint8_t - A combination of LED_MASK_RED, LED_MASK_GREEN and LED_MASK_BLUE.
+ */
+uint8_t colorMask(PredominantColor color);
+
 /**
  * Clears an individual LED, turning it off.
  *
@@ -97,6 +141,68 @@ void setLED(int layer, int row, int col, PredominantColor color);
  */
 void clearLED(int layer, int row, int col, PredominantColor color);
 
+/**
+ * Sets the PWM level of each LED component.
+ *
+ * Parameters:
+ * rgb - Component duties, 0-255.
+ */
+void LED_SetLevels(rgb_t rgb);
+
+/**
+ * Sets the global brightness applied on top of the component levels.
+ *
+ * Parameters:
+ * scaler - Brightness, 0 to BRIGHTNESS_FULL (256).
+ */
+void LED_SetBrightness(uint16_t scaler);
+
+/**
+ * Enables or disables true-colour mode, in which patterns are drawn in WHITE
+ * and the colour comes from LED_SetLevels().
+ *
+ * Parameters:
+ * on - 1 to enable, 0 to disable.
+ */
+void LED_SetTrueColorMode(int on);
+
+/**
+ * Returns 1 while true-colour mode is enabled.
+ */
+int LED_TrueColorMode(void);
+
+/**
+ * Shows an externally owned frame instead of the pattern framebuffer; swapping
+ * frames only exchanges a pointer.
+ *
+ * Parameters:
+ * frame - LED_FRAME_BYTES in framebuffer layout, or NULL to show the patterns again.
+ */
+void LED_ShowFrame(const uint8_t *frame);
+
+/**
+ * Drives the LED pins for one PWM slot; called LED_PWM_HZ * LED_PWM_LEVELS times a
+ * second from the TIM3 update interrupt.
+ */
+void LED_Refresh(void);
+
+/**
+ * Starts TIM3, which paces the PWM slots. Call after initGPIO().
+ */
+void LED_PwmInit(void);
+
+/**
+ * Re-derives the TIM3 prescaler and period after a clock profile switch.
+ */
+void LED_ClockChanged(void);
+
+/**
+ * Returns 1 when the LED pins would keep their levels without LED_Refresh(): no new
+ * frame is waiting to be shown and no channel is being dimmed by PWM. The clocks may
+ * then be stopped without the cube flickering or freezing half-dimmed.
+ */
+int LED_CanHold(void);
+
 /**
  * Gets the red component pin for an individual LED.
  *
@@ -0,0 +1,147 @@
+/*
+ * log.c
+ *
+ * Description: Deferred, tokenized logging.
+ * Logging a record costs a masked copy of a few words; encoding and COBS framing happen
+ * in log_poll(), outside time-critical code.
+ */
+
+#include "log.h"
+#include "stm32f4xx.h"
+#include "cobs.h"
+#include "uart.h"
+#include "timebase.h"
+
+typedef struct {
+    uint8_t id;
+    uint8_t nargs;
+    uint32_t timestamp;
+    uint32_t args[LOG_ARGS_MAX];
+} log_record_t;
+
+static log_record_t ring[LOG_RING_SIZE];
+static volatile uint8_t head;  // Next slot to fill
+static volatile uint8_t tail;  // Next record to send
+static volatile uint32_t dropped;
+static uint32_t droppedReported; // Drops already announced by log_poll()
+
+/**
+ * Queues a log record; use the LOG0 to LOG3 macros. Safe from interrupts.
+ *
+ * Parameters:
+ * id    - The message.
+ * nargs - Number of arguments used.
+ * a0    - First argument.
+ * a1    - Second argument.
+ * a2    - Third argument.
+ */
+void log_event(log_id_t id, uint8_t nargs, uint32_t a0, uint32_t a1, uint32_t a2) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint8_t next = (head + 1) & (LOG_RING_SIZE - 1);
+    if (next == tail) {
+        dropped++;
+    } else {
+        log_record_t *rec = &ring[head];
+        rec->id = (uint8_t)id;
+        rec->nargs = nargs;
+        rec->timestamp = now_ms32();
+        rec->args[0] = a0;
+        rec->args[1] = a1;
+        rec->args[2] = a2;
+        head = next;
+    }
+    __set_PRIMASK(primask);
+}
+
+/**
+ * Appends an unsigned LEB128 varint.
+ *
+ * Returns:
+ * uint8_t - Bytes written, at most 5.
+ */
+static uint8_t put_varint(uint8_t *out, uint32_t value) {
+    uint8_t n = 0;
+
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+/**
+ * Sends one binary frame on USART2. A frame that does not fit the transmit ring is
+ * dropped whole, whatever the uart_tx_policy_t.
+ *
+ * Parameters:
+ * type - The frame type.
+ * data - The payload.
+ * len  - Its length, at most LOG_FRAME_MAX - 1.
+ */
+void log_send_frame(uint8_t type, const uint8_t *data, uint16_t len) {
+    uint8_t raw[LOG_FRAME_MAX];
+    char wire[COBS_MAX_ENCODED(LOG_FRAME_MAX) + 2];
+    uint32_t n;
+
+    if (len >= LOG_FRAME_MAX) {
+        return;
+    }
+    raw[0] = type;
+    for (uint16_t i = 0; i < len; i++) {
+        raw[1 + i] = data[i];
+    }
+    // Leading delimiter separates the frame from any console text before it
+    wire[0] = COBS_DELIMITER;
+    n = 1 + cobs_encode(raw, len + 1, (uint8_t *)&wire[1]);
+    wire[n++] = COBS_DELIMITER;
+    // A cut frame would corrupt the stream for the host decoder: send all of it or none
+    uart_tx_policy_t policy = uart_tx_set_policy(UART_TX_DROP);
+    _write(1, wire, n);
+    uart_tx_set_policy(policy);
+}
+
+/**
+ * Encodes and sends one record as a LOG_FRAME_EVENT.
+ */
+static void send_record(const log_record_t *rec) {
+    uint8_t payload[2 + 5 * (1 + LOG_ARGS_MAX)];
+    uint16_t len = 0;
+
+    payload[len++] = rec->id;
+    len += put_varint(&payload[len], rec->timestamp);
+    for (uint8_t i = 0; i < rec->nargs && i < LOG_ARGS_MAX; i++) {
+        len += put_varint(&payload[len], rec->args[i]);
+    }
+    log_send_frame(LOG_FRAME_EVENT, payload, len);
+}
+
+/**
+ * Sends the queued records, followed by a LOG_RECORDS_DROPPED record if the ring
+ * overflowed since the last call. Call from the main context; main() also calls it
+ * once USART2 is up, before the scheduler starts, for the records logged during init.
+ */
+void log_poll(void) {
+    while (tail != head) {
+        log_record_t rec = ring[tail];
+
+        tail = (tail + 1) & (LOG_RING_SIZE - 1);
+        send_record(&rec);
+    }
+    uint32_t lost = dropped;
+    if (lost != droppedReported) {
+        log_record_t rec = {LOG_RECORDS_DROPPED, 1, now_ms32(), {lost - droppedReported, 0, 0}};
+
+        droppedReported = lost;
+        send_record(&rec);
+    }
+}
+
+/**
+ * Returns the number of records lost to a full ring.
+ */
+uint32_t log_dropped(void) {
+    return dropped;
+}
@@ -0,0 +1,67 @@
+/*
+ * log.h
+ *
+ * Description: Deferred, tokenized logging.
+ * A log call stores a message index, a millisecond timestamp and up to LOG_ARGS_MAX raw
+ * 32-bit arguments in a RAM ring. log_poll() later sends each record as a binary frame
+ * on USART2, interleaved with the console's text:
+ *
+ *   0x00 | COBS(frame type | payload) | 0x00
+ *
+ * For a LOG_FRAME_EVENT the payload is the message index, then the timestamp and the
+ * arguments as unsigned LEB128 varints. tools/log_decode rebuilds the text from log_ids.h.
+ */
+
+#ifndef SRC_LOG_H_
+#define SRC_LOG_H_
+
+#include "stdint.h"
+#include "log_ids.h"
+
+#define LOG_RING_SIZE 32 // Records held until log_poll(), a power of two
+#define LOG_ARGS_MAX  3
+#define LOG_FRAME_MAX 144 // Largest frame payload, type byte included (a full GFIFO record)
+
+// Binary frame types on USART2
+#define LOG_FRAME_EVENT 0x01
+
+#define LOG0(id)          log_event((id), 0, 0, 0, 0)
+#define LOG1(id, a)       log_event((id), 1, (uint32_t)(a), 0, 0)
+#define LOG2(id, a, b)    log_event((id), 2, (uint32_t)(a), (uint32_t)(b), 0)
+#define LOG3(id, a, b, c) log_event((id), 3, (uint32_t)(a), (uint32_t)(b), (uint32_t)(c))
+
+/**
+ * Queues a log record; use the LOG0 to LOG3 macros. Safe from interrupts.
+ *
+ * Parameters:
+ * id    - The message.
+ * nargs - Number of arguments used.
+ * a0    - First argument.
+ * a1    - Second argument.
+ * a2    - Third argument.
+ */
+void log_event(log_id_t id, uint8_t nargs, uint32_t a0, uint32_t a1, uint32_t a2);
+
+/**
+ * Sends the queued records, then reports records lost to a full ring since the last
+ * call as a LOG_RECORDS_DROPPED record. Call from the main context.
+ */
+void log_poll(void);
+
+/**
+ * Sends one binary frame on USART2. A frame that does not fit the transmit ring is
+ * dropped whole, whatever the uart_tx_policy_t.
+ *
+ * Parameters:
+ * type - The frame type.
+ * data - The payload.
+ * len  - Its length, at most LOG_FRAME_MAX - 1.
+ */
+void log_send_frame(uint8_t type, const uint8_t *data, uint16_t len);
+
+/**
+ * Returns the number of records lost to a full ring.
+ */
+uint32_t log_dropped(void);
+
+#endif /* SRC_LOG_H_ */
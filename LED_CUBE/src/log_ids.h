@@ -0,0 +1,40 @@
+/*
+ * log_ids.h
+ *
+ * Description: Message table for tokenized logging, shared by the firmware and the host
+ * decoder (tools/log_decode). The firmware only sends a message's index and arguments;
+ * the text lives here and is rebuilt on the host.
+ *
+ * Formats take printf conversions on 32-bit arguments plus two of their own:
+ * %C prints a PredominantColor name and %G a gesture_ext_t name.
+ * Append new messages at the end so existing indices keep their meaning.
+ */
+
+#ifndef SRC_LOG_IDS_H_
+#define SRC_LOG_IDS_H_
+
+#define LOG_MESSAGES(X) \
+    X(LOG_GESTURE_INIT_FAILED, "Init failed for gesture sensor") \
+    X(LOG_MAIN_START,          "In main function") \
+    X(LOG_GESTURE_CAL_FAILED,  "Gesture calibration failed, using defaults") \
+    X(LOG_COLOR_CAL_MISSING,   "No colour calibration stored, using defaults") \
+    X(LOG_MUX_SENSORS,         "%d extra colour sensors, %lu cycles per sweep") \
+    X(LOG_WAIT_COLOR,          "Waiting for Color input") \
+    X(LOG_WAIT_GESTURE,        "Waiting for gesture") \
+    X(LOG_GESTURE,             "%G") \
+    X(LOG_GESTURE_INVALID,     "Not A valid gesture") \
+    X(LOG_BLINKING,            "BLINKING LEDs") \
+    X(LOG_SAMPLE_RATE,         "Sample rate: %lu gesture + %lu colour = %lu samples/s") \
+    X(LOG_COLOR_UNKNOWN,       "Unknown color") \
+    X(LOG_COLOR_DETECTED,      "Detected color is %C (%lu cycles)") \
+    X(LOG_TRACE_DOWNLOAD,      "Gesture trace: %lu records, %lu dropped") \
+    X(LOG_RECORDS_DROPPED,     "%lu log records dropped")
+
+#define LOG_ID_ENUM(id, fmt) id,
+
+typedef enum {
+    LOG_MESSAGES(LOG_ID_ENUM)
+    LOG_ID_COUNT
+} log_id_t;
+
+#endif /* SRC_LOG_IDS_H_ */
@@ -38,7 +38,45 @@
 #include "string.h"
 #include "gesture.h"
 #include "i2c.h"
+#include "gesture_trace.h"
+#include "gesture_template.h"
+#include "sensor_state.h"
+#include "color_transform.h"
+#include "color_cal.h"
+#include "color_filter.h"
+#include "brightness.h"
+#include "color_mux.h"
+#include "console.h"
+#include "log.h"
+#include "telemetry.h"
+#include "sched.h"
+#include "clock.h"
+#include "timebase.h"
+#include "power.h"
 
+#define TRUE_COLOR_PASSTHROUGH 0 // 1: the sensed colour drives the LEDs directly
+#define COLOR_MUX_CHANNEL_MASK 0x00 // Mux channels with extra colour sensors, 0 without a mux
+#define CONSOLE_POLL_MS   20   // Console task period; received characters also wake it at once
+#define OUTPUT_POLL_MS    10   // Log and telemetry task period
+#define GESTURE_SETTLE_MS 1000 // Wait after a sensed gesture before its pattern starts
+#define PATTERN_PAUSE_MS  1000 // Pause after a pattern before sensing colour again
+
+/**
+ * What the application is doing; the tasks act according to it.
+ */
+typedef enum {
+    APP_WAIT_COLOR,   // Classifying the card
+    APP_WAIT_GESTURE, // Polling for a gesture in the card's colour
+    APP_ANIMATING,    // Stepping the gesture's pattern
+    APP_PAUSED        // Short pause before sensing colour again
+} app_state_t;
+
+static app_state_t appState;
+static PredominantColor color;
+static gesture_ext_t gesture;
+static uint8_t patternMore;
+static int gestureTaskId;
+static int animationTaskId;
 
 char rxData;
 
@@ -47,6 +85,13 @@ void SystemClock_Config(void);
 void SysTick_Handler(void);
 void SysTick_Init(void);
 void Delay_ms(uint32_t ms) ;
+static void colorTask(void);
+static void gestureTask(void);
+static void animationTask(void);
+static void resumeTask(void);
+static void brightnessTask(void);
+static void outputTask(void);
+static void reportSampleRate(void);
 
 /**
   * @brief  The application entry point.
@@ -54,84 +99,202 @@ void Delay_ms(uint32_t ms) ;
   */
 int main(void)
 {
-  gesture_t gesture;
+  SystemClock_Config();
+  timebase_init(); // Cycle counter for the profiling timings below and in the tasks
   // Initialize peripherals
-  i2c_gpio_init();
-  i2c_init();
+  i2c_gpio_init(&i2c_bus1);
+  i2c_init(&i2c_bus1);
+#if I2C_SPLIT_BUSES
+  i2c_gpio_init(&i2c_bus3);
+  i2c_init(&i2c_bus3);
+#endif
   uint8_t a=0;
 Here:
   apds9960_init();
   a=check_gesture_init();
   if(a==0){
-	  printf("Init failed for gesture sensor\n\r");
+	  LOG0(LOG_GESTURE_INIT_FAILED);
 	  goto Here;
   }
-  PredominantColor color;
+  // With a mux fitted the main colour sensor sits behind it; connect it before its init
+  int muxSensors = COLOR_MUX_CHANNEL_MASK ? color_mux_init(COLOR_MUX_CHANNEL_MASK) : 0;
   TCS34725_Init();
   SysTick_Init();
-  USART2_Config();
+  USART2_Config(UART_BAUD);
+  log_poll(); // Send what init has logged so far; the output task takes over later
   initGPIO();
-  printf("\n\rIn main function\n\r");
-  printf("\n\rWaiting for Color input\n\r");
+  LED_PwmInit();
+  LOG0(LOG_MAIN_START);
+  // Keep hands away from the sensor while it measures the ambient crosstalk
+  if (!apds9960_calibrate()) {
+	  LOG0(LOG_GESTURE_CAL_FAILED);
+  }
+  if (!color_cal_load()) {
+	  LOG0(LOG_COLOR_CAL_MISSING);
+  }
+  if (muxSensors) {
+	  uint32_t start = DWT->CYCCNT;
+	  color_mux_sweep(now_ms32());
+	  LOG2(LOG_MUX_SENSORS, color_mux_sensors(), DWT->CYCCNT - start);
+  }
+  LOG0(LOG_WAIT_COLOR);
+  gesture_trace_enable(GESTURE_TRACE_MODE);
+  LED_SetTrueColorMode(TRUE_COLOR_PASSTHROUGH);
+  console_init();
+  power_init();
 
-  while (1)
-  {
-	color=TCS34725_ReadColorAndCheck();
-	Delay_ms(1000);
-// Process the color data
-// printf("\n\rRed: %u, Green: %u, Blue: %u, Clear: %u\n\r", r, g, b, c);
-
-	while(color!= UNKNOWN){
-		printf("\n\r Waiting for gesture\n\r");
-	  if (gesture_data_available()) {
-	          gesture = detect_gesture();
-	          Delay_ms(1000);
-
-	          switch (gesture) {
-	          		case GESTURE_UP:
-	          			 // Handle UP gesture
-	          		    printf("\n\r UP\n\r");
-	          		    displayUpPattern(color);
-	          		    break;
-	          		case GESTURE_DOWN:
-	          			// Handle DOWN gesture
-	          		     printf("\n\r DOWN\n\r");
-	          		     displayDownPattern(color);
-	          		     break;
-	          		case GESTURE_LEFT:
-	          		  // Handle LEFT gesture
-	          		     printf("\n\r LEFT\n\r");
-	          		     displayLeftPattern(color);
-	          		     break;
-	          		case GESTURE_RIGHT:
-	          			// Handle RIGHT gesture
-	          		     printf("\n\r RIGHT\n\r");
-	          		     displayRightPattern(color) ;
-	          		     break;
-	          		default:
-	          		     printf("\n\r Not A valid gesture\n\r");
-	          		                  // No valid gesture detected
-	          		     break;
-	          		}
-	          printf("\n\r BLINKING LEDs\n\r");
-	          Delay_ms(1000);
-	          break;
-	      }
-
-	  Delay_ms(2000);
+  // Tasks in priority order: each runs to completion when due
+  sched_add("console", console_poll, CONSOLE_POLL_MS, SCHED_EVENT_CONSOLE);
+  gestureTaskId = sched_add("gesture", gestureTask, GESTURE_POLL_FAST_MS, 0);
+  sched_add("colour", colorTask, COLOR_SAMPLE_MS, 0);
+  animationTaskId = sched_add("animation", animationTask, LED_PATTERN_STEP_MS, 0);
+  sched_add("brightness", brightnessTask, BRIGHTNESS_PERIOD_MS, 0);
+  sched_add("output", outputTask, OUTPUT_POLL_MS, 0);
+  sched_run();
+}
+
+/**
+ * @brief Colour task: classifies the card while waiting for one.
+ */
+static void colorTask(void) {
+	if (appState != APP_WAIT_COLOR) {
+		return;
+	}
+	color = TCS34725_ReadColorAndCheck();
+	if (LED_TrueColorMode() && color != UNKNOWN) {
+		// Mirror the card: draw in white and let the component levels carry the colour
+		sensor_state_t snap;
+		rgb_t rgb;
+		sensor_state_read(&snap);
+		color_transform(snap.r, snap.g, snap.b, &rgb);
+		LED_SetLevels(rgb);
+		color = WHITE;
+	}
+	if (color_mux_sensors()) {
+		color_mux_sweep(now_ms32());
+	}
+	if (color == UNKNOWN && console_pattern_pending()) {
+		color = WHITE; // Show a console request even without a card
+	}
+	if (color != UNKNOWN) {
+		LOG0(LOG_WAIT_GESTURE);
+		appState = APP_WAIT_GESTURE;
+	}
+}
+
+/**
+ * @brief Gesture task: polls the gesture engine, or takes a console request, and starts its pattern.
+ */
+static void gestureTask(void) {
+	PredominantColor requestColor;
+	int requested;
+
+	if (appState != APP_WAIT_GESTURE) {
+		return;
+	}
+	requested = console_take_pattern(&gesture, &requestColor);
+	if (!requested && !gesture_data_available()) {
+		// Poll faster while a hand is near, back off while idle
+		sched_set_period(gestureTaskId, gesture_poll_interval_ms());
+		return;
+	}
+	if (!requested) {
+		gesture = detect_gesture_ext();
+	} else if (requestColor != UNKNOWN) {
+		color = requestColor;
 	}
-  }
 
+	if (gesture > GESTURE_EXT_NONE && gesture < GESTURE_EXT_COUNT) {
+		LOG1(LOG_GESTURE, gesture); // Extended gestures are reported but have no pattern yet
+	} else {
+		LOG0(LOG_GESTURE_INVALID);
+	}
+	patternMore = LED_PatternStart(gesture, color);
+	appState = APP_ANIMATING;
+	// A sensed gesture settles for a second before its pattern starts
+	sched_restart(animationTaskId, requested ? 0 : GESTURE_SETTLE_MS);
+}
+
+/**
+ * @brief Animation task: steps the pattern, then reports and returns to colour sensing.
+ */
+static void animationTask(void) {
+	if (appState != APP_ANIMATING) {
+		return;
+	}
+	if (patternMore) {
+		patternMore = LED_PatternStep();
+		return;
+	}
+	if (gesture_trace_enabled() && gesture_trace_download()) {
+		return; // More of the trace goes out on the next run
+	}
+	reportSampleRate();
+	LOG0(LOG_BLINKING);
+	appState = APP_PAUSED;
+	sched_after("resume", resumeTask, PATTERN_PAUSE_MS);
+}
+
+/**
+ * @brief One-shot task: goes back to waiting for a colour after the pause that ends a pattern.
+ */
+static void resumeTask(void) {
+	color_filter_reset(); // The card shown before the pattern may be gone by now
+	appState = APP_WAIT_COLOR;
+}
+
+/**
+ * @brief Brightness task: adapts the LED brightness to the ambient light.
+ * While waiting for a colour the colour task's reading is reused; otherwise a fresh
+ * lux reading is taken.
+ */
+static void brightnessTask(void) {
+    color_light_t light;
+
+    if (appState != APP_WAIT_COLOR) {
+        light.lux = TCS34725_ReadLux();
+    } else {
+        TCS34725_GetLight(&light);
+    }
+    LED_SetBrightness(brightness_update(light.lux));
+}
+
+/**
+ * @brief Output task: sends queued log records and due telemetry.
+ */
+static void outputTask(void) {
+    log_poll();
+    telemetry_poll();
+}
+
+/**
+ * @brief Logs the sensor sample rates since the previous report.
+ * Gesture datasets and colour readings are counted separately and combined.
+ */
+static void reportSampleRate(void) {
+    static uint32_t lastTick, lastDatasets, lastColor;
+    uint32_t now = now_ms32();
+    uint32_t elapsed = now - lastTick;
+    uint32_t datasets = apds9960_datasets();
+    uint32_t colors = TCS34725_Samples();
+
+    if (elapsed == 0) {
+        return;
+    }
+    uint32_t gestureRate = (datasets - lastDatasets) * 1000 / elapsed;
+    uint32_t colorRate = (colors - lastColor) * 1000 / elapsed;
+    LOG3(LOG_SAMPLE_RATE, gestureRate, colorRate, gestureRate + colorRate);
+    lastTick = now;
+    lastDatasets = datasets;
+    lastColor = colors;
 }
 
 /**
  * @brief SysTick interrupt handler.
- * Decrements the millisecond counter.
+ * Advances the time base; the LEDs are refreshed from TIM3 (LED_PwmInit()).
  */
 void SysTick_Handler(void) {
-    if (msTicks != 0) {
-        msTicks--;  // Decrement the milliseconds counter if not already zero
-    }
+    timebase_tick();
 }
 
 /**
@@ -146,48 +309,12 @@ void SysTick_Init(void) {
 
 /**
   * @brief System Clock Configuration
+  * Runs the core from the PLL at 100 MHz; see clock.h for the other profiles.
   * @retval None
   */
 void SystemClock_Config(void)
 {
-  RCC_OscInitTypeDef RCC_OscInitStruct = {0};
-  RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
-
-  /** Configure the main internal regulator output voltage
-  */
-  __HAL_RCC_PWR_CLK_ENABLE();
-  __HAL_PWR_VOLTAGESCALING_CONFIG(PWR_REGULATOR_VOLTAGE_SCALE1);
-
-  /** Initializes the RCC Oscillators according to the specified parameters
-  * in the RCC_OscInitTypeDef structure.
-  */
-  RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSI;
-  RCC_OscInitStruct.HSIState = RCC_HSI_ON;
-  RCC_OscInitStruct.HSICalibrationValue = RCC_HSICALIBRATION_DEFAULT;
-  RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
-  RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSI;
-  RCC_OscInitStruct.PLL.PLLM = 8;
-  RCC_OscInitStruct.PLL.PLLN = 192;
-  RCC_OscInitStruct.PLL.PLLP = RCC_PLLP_DIV4;
-  RCC_OscInitStruct.PLL.PLLQ = 8;
-  if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
-  {
-    Error_Handler();
-  }
-
-  /** Initializes the CPU, AHB and APB buses clocks
-  */
-  RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK|RCC_CLOCKTYPE_SYSCLK
-                              |RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
-  RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
-  RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
-  RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV4;
-  RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV2;
-
-  if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_3) != HAL_OK)
-  {
-    Error_Handler();
-  }
+  clock_set_profile(CLOCK_PROFILE_DEFAULT);
 }
 
 /* USER CODE END 4 */
@@ -0,0 +1,365 @@
+/*
+ * power.c
+ *
+ * Description: Low-power idle in WFI or Stop mode, with residency counters.
+ * Stop mode halts SysTick along with every other clock, so the RTC times it: its
+ * sub-second counter runs at RTCCLK / 2 and the time base is advanced by the measured
+ * sleep on wake-up. The RTC runs from the LSE crystal if one starts, otherwise from
+ * LSI, whose rate is then measured against the core clock.
+ */
+
+#include "power.h"
+#include "stm32f4xx.h"
+#include "timebase.h"
+#include "clock.h"
+#include "led.h"
+#include "gesture.h"
+#include "i2c.h"
+#include "uart.h"
+#include "stream.h"
+#include "sched.h"
+
+#define RTC_PREDIV_A     1  // ck_apre = RTCCLK / 2, the sub-second resolution
+#define RTC_WAKEUP_LINE  22 // EXTI line of the RTC wakeup event
+#define RTC_WAKEUP_DIV   16 // WUCKSEL 000: the wakeup timer counts RTCCLK / 16
+
+#define WAKE_LINES ((1UL << APDS9960_INT_PIN) | (1UL << POWER_RX_WAKE_PIN))
+
+static const char *rtcSource = "none";
+static uint32_t rtcPredivS;   // Sub-second counts per second
+static uint32_t ssrHz;        // Sub-second counting rate, measured for LSI
+static uint8_t stopEnabled = POWER_STOP_ENABLE;
+static uint64_t statsStart;   // now_us() when the counters were reset
+static uint64_t stateUs[POWER_STATES];
+static uint32_t stops;
+static uint32_t intSeenMs;    // now_ms32() when the APDS9960 INT pin was last found asserted
+static volatile uint8_t intClearQueued; // clear_int_task() is waiting to run
+
+/**
+ * Returns the RTC time of day in sub-second counts, wrapping every hour.
+ * The shadow registers are bypassed, so both registers are read until stable.
+ */
+static uint32_t rtc_counts(void) {
+    uint32_t ssr, tr, sec;
+
+    do {
+        ssr = RTC->SSR;
+        tr = RTC->TR;
+    } while (ssr != RTC->SSR || tr != RTC->TR);
+    sec = ((tr >> 12) & 0x7) * 600 + ((tr >> 8) & 0xF) * 60 + ((tr >> 4) & 0x7) * 10 + (tr & 0xF);
+    return sec * (rtcPredivS + 1) + (rtcPredivS - ssr);
+}
+
+/**
+ * Returns the sub-second counts since an earlier rtc_counts() reading.
+ */
+static uint32_t rtc_counts_since(uint32_t start) {
+    uint32_t wrap = 3600 * (rtcPredivS + 1);
+
+    return (rtc_counts() + wrap - start) % wrap;
+}
+
+/**
+ * Selects the RTC clock, resetting the backup domain if another one was selected
+ * by an earlier run (RTCSEL is write-once otherwise).
+ */
+static void rtc_select_clock(uint32_t sel) {
+    if ((RCC->BDCR & RCC_BDCR_RTCSEL) != sel && (RCC->BDCR & RCC_BDCR_RTCSEL)) {
+        RCC->BDCR |= RCC_BDCR_BDRST;
+        RCC->BDCR &= ~RCC_BDCR_BDRST;
+        if (sel == RCC_BDCR_RTCSEL_0) {
+            RCC->BDCR |= RCC_BDCR_LSEON; // The reset stopped the crystal
+            while (!(RCC->BDCR & RCC_BDCR_LSERDY));
+        }
+    }
+    RCC->BDCR |= sel | RCC_BDCR_RTCEN;
+}
+
+/**
+ * Starts the RTC clock and calendar. Returns 0 if no low-speed clock starts.
+ */
+static int rtc_init(void) {
+    uint64_t start;
+    uint32_t sel;
+
+    RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+    PWR->CR |= PWR_CR_DBP; // Backup domain writes stay enabled for the wakeup timer
+
+    RCC->BDCR |= RCC_BDCR_LSEON;
+    start = now_ms();
+    while (!(RCC->BDCR & RCC_BDCR_LSERDY) && elapsed_ms(start) < POWER_LSE_TIMEOUT_MS);
+    if (RCC->BDCR & RCC_BDCR_LSERDY) {
+        sel = RCC_BDCR_RTCSEL_0;
+        rtcSource = "lse";
+        ssrHz = 32768 / (RTC_PREDIV_A + 1);
+    } else {
+        RCC->BDCR &= ~RCC_BDCR_LSEON;
+        RCC->CSR |= RCC_CSR_LSION;
+        start = now_ms();
+        while (!(RCC->CSR & RCC_CSR_LSIRDY) && elapsed_ms(start) < POWER_LSE_TIMEOUT_MS);
+        if (!(RCC->CSR & RCC_CSR_LSIRDY)) {
+            return 0;
+        }
+        sel = RCC_BDCR_RTCSEL_1;
+        rtcSource = "lsi";
+        ssrHz = 32000 / (RTC_PREDIV_A + 1); // Nominal until measured below
+    }
+    rtc_select_clock(sel);
+
+    // Calendar from 00:00:00, one second per ssrHz sub-second counts
+    rtcPredivS = ssrHz - 1;
+    RTC->WPR = 0xCA;
+    RTC->WPR = 0x53;
+    RTC->ISR |= RTC_ISR_INIT;
+    while (!(RTC->ISR & RTC_ISR_INITF));
+    RTC->PRER = rtcPredivS;
+    RTC->PRER |= (uint32_t)RTC_PREDIV_A << 16;
+    RTC->TR = 0;
+    RTC->CR |= RTC_CR_BYPSHAD | RTC_CR_WUTIE;
+    RTC->ISR &= ~RTC_ISR_INIT;
+
+    if (sel == RCC_BDCR_RTCSEL_1) {
+        // LSI varies from part to part; measure it against the core clock
+        uint32_t counts = rtc_counts();
+        uint64_t t0 = now_us();
+        while (elapsed_us(t0) < POWER_LSI_CAL_MS * 1000);
+        ssrHz = (uint32_t)((uint64_t)rtc_counts_since(counts) * 1000000 / elapsed_us(t0));
+    }
+
+    // The wakeup event reaches the NVIC through EXTI
+    EXTI->IMR |= 1UL << RTC_WAKEUP_LINE;
+    EXTI->RTSR |= 1UL << RTC_WAKEUP_LINE;
+    NVIC_EnableIRQ(RTC_WKUP_IRQn);
+    return 1;
+}
+
+/**
+ * Arms the RTC wakeup timer.
+ */
+static void rtc_wakeup_start(uint32_t ms) {
+    uint64_t ticks = (uint64_t)ms * ssrHz * (RTC_PREDIV_A + 1) / RTC_WAKEUP_DIV / 1000;
+
+    RTC->CR &= ~RTC_CR_WUTE;
+    while (!(RTC->ISR & RTC_ISR_WUTWF));
+    RTC->WUTR = (ticks > 0x10000) ? 0xFFFF : (ticks > 0) ? (uint32_t)ticks - 1 : 0;
+    RTC->ISR = ~(RTC_ISR_WUTF | RTC_ISR_INIT) & 0xFFFF;
+    RTC->CR |= RTC_CR_WUTE;
+}
+
+/**
+ * Routes a pin to its EXTI line, triggered on a falling edge. The line stays masked
+ * until Stop mode is entered.
+ */
+static void wake_pin_init(GPIO_TypeDef *port, uint32_t pin) {
+    uint32_t portIdx = ((uint32_t)port - GPIOA_BASE) / (GPIOB_BASE - GPIOA_BASE);
+    uint32_t shift = (pin & 3) * 4;
+
+    SYSCFG->EXTICR[pin >> 2] = (SYSCFG->EXTICR[pin >> 2] & ~(0xFUL << shift)) | (portIdx << shift);
+    EXTI->FTSR |= 1UL << pin;
+}
+
+/**
+ * One-shot task that releases the APDS9960 INT pin. The I2C command blocks, so it
+ * runs as a task instead of inside the masked idle path.
+ */
+static void clear_int_task(void) {
+    apds9960_clear_interrupt();
+    intSeenMs = now_ms32();
+    intClearQueued = 0;
+}
+
+/**
+ * Returns 1 if the idle period can be spent in Stop mode. Called with interrupts masked.
+ */
+static int stop_allowed(uint32_t idleMs) {
+    if (!stopEnabled || ssrHz == 0 || idleMs < POWER_STOP_MIN_MS) {
+        return 0;
+    }
+    if (!LED_CanHold() || gesture_hand_near() || stream_active()) {
+        return 0;
+    }
+    // DMA and bus transfers stop with their clocks
+    if (!uart_tx_idle() || i2c_busy(&i2c_bus1) || i2c_busy(&i2c_bus3)) {
+        return 0;
+    }
+    if (now_ms32() - intSeenMs < GESTURE_NEAR_HOLD_MS) {
+        return 0;
+    }
+    if (!(APDS9960_INT_PORT->IDR & (1UL << APDS9960_INT_PIN))) {
+        // A hand is or was in range and no edge would wake us: have a task release the
+        // pin and treat the hand as near for a while
+        intSeenMs = now_ms32();
+        if (!intClearQueued && sched_after("intclear", clear_int_task, 0) >= 0) {
+            intClearQueued = 1;
+        }
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Spends up to ms milliseconds in Stop mode and brings the clocks and the time base
+ * back. Called with interrupts masked.
+ */
+static void enter_stop(uint32_t ms) {
+    uint32_t counts, us;
+
+    rtc_wakeup_start(ms);
+    EXTI->PR = WAKE_LINES;
+    EXTI->IMR |= WAKE_LINES;
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    counts = rtc_counts();
+
+    // Low-power regulator and flash powered down: a longer wake-up, but the lowest current
+    PWR->CR = (PWR->CR & ~PWR_CR_PDDS) | PWR_CR_LPDS | PWR_CR_FPDS;
+    SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+    __DSB();
+    __WFI();
+    SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+
+    clock_restore(); // Stop wakes on HSI
+    us = (uint32_t)((uint64_t)rtc_counts_since(counts) * 1000000 / ssrHz);
+    EXTI->IMR &= ~WAKE_LINES;
+    RTC->CR &= ~RTC_CR_WUTE;
+
+    timebase_advance_us(us);
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    stateUs[POWER_STOP] += us;
+    stops++;
+}
+
+/**
+ * Starts the RTC for timing Stop mode and sets up the wake-up pins.
+ * Call once the time base is running.
+ */
+void power_init(void) {
+    // APDS9960 INT: input with pull-up for the open-drain output
+    RCC->AHB1ENR |= RCC_AHB1ENR_GPIOBEN;
+    APDS9960_INT_PORT->MODER &= ~(3UL << (APDS9960_INT_PIN * 2));
+    APDS9960_INT_PORT->PUPDR = (APDS9960_INT_PORT->PUPDR & ~(3UL << (APDS9960_INT_PIN * 2))) |
+                               (1UL << (APDS9960_INT_PIN * 2));
+
+    RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+    wake_pin_init(APDS9960_INT_PORT, APDS9960_INT_PIN);
+    wake_pin_init(GPIOA, POWER_RX_WAKE_PIN); // The USART2 RX pin, read by EXTI alongside the USART
+    NVIC_EnableIRQ(EXTI0_IRQn);
+    NVIC_EnableIRQ(EXTI3_IRQn);
+
+    if (!rtc_init()) {
+        ssrHz = 0; // Stop mode cannot be timed; idle in WFI only
+    }
+    power_reset_stats();
+}
+
+/**
+ * Idles until the next interrupt or for up to idleMs. Called from the scheduler with
+ * interrupts masked.
+ *
+ * Parameters:
+ * idleMs - Time until the next task is due, SCHED_NEVER if none is timed.
+ */
+void power_idle(uint32_t idleMs) {
+    if (stop_allowed(idleMs)) {
+        enter_stop(((idleMs > POWER_STOP_MAX_MS) ? POWER_STOP_MAX_MS : idleMs) - POWER_STOP_WAKE_MS);
+    } else if (!intClearQueued) { // A queued clear_int_task() is due now: no sleep
+        power_wait();
+    }
+}
+
+/**
+ * Sleeps in WFI until the next interrupt, counting the time as sleep. Both timestamps
+ * are taken with interrupts masked, so the handler that ends the sleep runs after the
+ * second one and is counted as run time.
+ */
+void power_wait(void) {
+    uint32_t primask = __get_PRIMASK();
+    uint64_t start;
+
+    __disable_irq();
+    start = now_us();
+    __DSB();
+    __WFI();
+    stateUs[POWER_SLEEP] += now_us() - start;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * Allows or forbids Stop mode.
+ */
+void power_stop_enable(int on) {
+    stopEnabled = on ? 1 : 0;
+}
+
+/**
+ * Returns 1 if Stop mode is allowed.
+ */
+int power_stop_enabled(void) {
+    return stopEnabled;
+}
+
+/**
+ * Copies the residency counters.
+ *
+ * Parameters:
+ * out - Receives the counters; run time is the remainder of the elapsed time.
+ */
+void power_get_stats(power_stats_t *out) {
+    uint64_t total = now_us() - statsStart;
+    uint64_t idle = stateUs[POWER_SLEEP] + stateUs[POWER_STOP];
+
+    out->us[POWER_RUN] = (total > idle) ? total - idle : 0;
+    out->us[POWER_SLEEP] = stateUs[POWER_SLEEP];
+    out->us[POWER_STOP] = stateUs[POWER_STOP];
+    out->stops = stops;
+}
+
+/**
+ * Restarts the residency counters.
+ */
+void power_reset_stats(void) {
+    statsStart = now_us();
+    for (int i = 0; i < POWER_STATES; i++) {
+        stateUs[i] = 0;
+    }
+    stops = 0;
+}
+
+/**
+ * Returns a power state's name.
+ */
+const char *power_state_name(power_state_t state) {
+    static const char *const names[POWER_STATES] = {"run", "sleep", "stop"};
+
+    return (state < POWER_STATES) ? names[state] : "?";
+}
+
+/**
+ * Returns the RTC clock source, "lse" or "lsi", or "none" if the RTC did not start.
+ */
+const char *power_rtc_source(void) {
+    return rtcSource;
+}
+
+/**
+ * APDS9960 INT: a hand came in range during Stop mode.
+ */
+void EXTI0_IRQHandler(void) {
+    EXTI->PR = 1UL << APDS9960_INT_PIN;
+}
+
+/**
+ * USART2 RX edge during Stop mode; the character itself is lost.
+ */
+void EXTI3_IRQHandler(void) {
+    EXTI->PR = 1UL << POWER_RX_WAKE_PIN;
+    sched_signal(SCHED_EVENT_CONSOLE);
+}
+
+/**
+ * RTC wakeup timer: the next task is due.
+ */
+void RTC_WKUP_IRQHandler(void) {
+    RTC->ISR = ~(RTC_ISR_WUTF | RTC_ISR_INIT) & 0xFFFF;
+    EXTI->PR = 1UL << RTC_WAKEUP_LINE;
+}
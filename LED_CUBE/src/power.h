@@ -0,0 +1,97 @@
+/*
+ * power.h
+ *
+ * Description: Low-power idle.
+ * Short idle periods sleep in WFI, which any interrupt ends. Longer ones enter Stop
+ * mode when nothing needs the core clock: the LED pins can hold their levels, no hand
+ * is near the gesture sensor and the UART and I2C buses are quiet. The RTC wakeup
+ * timer ends Stop in time for the next task; the APDS9960 INT pin (a hand arriving)
+ * and the USART2 RX pin (a console character, which is lost) end it early.
+ */
+
+#ifndef SRC_POWER_H_
+#define SRC_POWER_H_
+
+#include "stdint.h"
+
+#define POWER_STOP_ENABLE    1     // 1: idle periods may use Stop mode
+#define POWER_STOP_MIN_MS    5     // Shortest idle period worth entering Stop for
+#define POWER_STOP_MAX_MS    30000 // Longest Stop (the RTC wakeup timer reaches 32 s)
+#define POWER_STOP_WAKE_MS   1     // Woken this early to restart the PLL before the task is due
+#define POWER_LSE_TIMEOUT_MS 1000  // Wait for the 32.768 kHz crystal before falling back to LSI
+#define POWER_LSI_CAL_MS     100   // LSI measured against the core clock for this long
+#define POWER_RX_WAKE_PIN    3     // USART2 RX, PA3, EXTI line 3
+
+/**
+ * Power states whose residency is measured.
+ */
+typedef enum {
+    POWER_RUN,   // Executing
+    POWER_SLEEP, // WFI, clocks running
+    POWER_STOP,  // Stop mode, clocks off except the RTC
+    POWER_STATES
+} power_state_t;
+
+/**
+ * Time spent in each power state since power_init() or power_reset_stats().
+ */
+typedef struct {
+    uint64_t us[POWER_STATES]; // Microseconds per state
+    uint32_t stops;            // Stop mode entries
+} power_stats_t;
+
+/**
+ * Starts the RTC for timing Stop mode and sets up the wake-up pins.
+ * Call once the time base is running.
+ */
+void power_init(void);
+
+/**
+ * Idles until the next interrupt or for up to idleMs. Called from the scheduler with
+ * interrupts masked.
+ *
+ * Parameters:
+ * idleMs - Time until the next task is due, SCHED_NEVER if none is timed.
+ */
+void power_idle(uint32_t idleMs);
+
+/**
+ * Sleeps in WFI until the next interrupt, counting the time as sleep. The interrupt
+ * that ends the sleep is handled before returning but is not counted as sleep.
+ */
+void power_wait(void);
+
+/**
+ * Allows or forbids Stop mode.
+ */
+void power_stop_enable(int on);
+
+/**
+ * Returns 1 if Stop mode is allowed.
+ */
+int power_stop_enabled(void);
+
+/**
+ * Copies the residency counters.
+ *
+ * Parameters:
+ * out - Receives the counters; run time is the remainder of the elapsed time.
+ */
+void power_get_stats(power_stats_t *out);
+
+/**
+ * Restarts the residency counters.
+ */
+void power_reset_stats(void);
+
+/**
+ * Returns a power state's name.
+ */
+const char *power_state_name(power_state_t state);
+
+/**
+ * Returns the RTC clock source, "lse" or "lsi", or "none" if the RTC did not start.
+ */
+const char *power_rtc_source(void);
+
+#endif /* SRC_POWER_H_ */
@@ -0,0 +1,247 @@
+/*
+ * sched.c
+ *
+ * Description: Cooperative run-to-completion task scheduler.
+ * A periodic task that falls more than a period behind skips the missed runs instead
+ * of running back to back.
+ */
+
+#include "sched.h"
+
+#define TASK_USED    0x01
+#define TASK_TIMED   0x02 // due is valid
+#define TASK_ONESHOT 0x04
+
+typedef struct {
+    const char *name;
+    sched_fn_t fn;
+    uint32_t period;
+    uint32_t due;
+    uint32_t events;
+    uint32_t runs;
+    uint8_t flags;
+} sched_task_t;
+
+static sched_task_t tasks[SCHED_MAX_TASKS];
+static volatile uint32_t pendingEvents;
+
+/**
+ * Claims a free slot.
+ *
+ * Returns:
+ * int - Task id, or -1 if the table is full.
+ */
+static int add_task(const char *name, sched_fn_t fn, uint32_t period, uint32_t delay, uint32_t events,
+                    uint8_t flags) {
+    for (int id = 0; id < SCHED_MAX_TASKS; id++) {
+        sched_task_t *t = &tasks[id];
+        if (!(t->flags & TASK_USED)) {
+            t->name = name;
+            t->fn = fn;
+            t->period = period;
+            t->due = sched_port_now() + delay;
+            t->events = events;
+            t->runs = 0;
+            t->flags = TASK_USED | flags;
+            return id;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Adds a periodic and/or event-driven task.
+ *
+ * Parameters:
+ * name     - Name for listings.
+ * fn       - The task function.
+ * periodMs - Run interval; 0 to run on events only. The first run is due at once.
+ * events   - Event flags that also make the task run, 0 for none.
+ *
+ * Returns:
+ * int - Task id, or -1 if the table is full.
+ */
+int sched_add(const char *name, sched_fn_t fn, uint32_t periodMs, uint32_t events) {
+    return add_task(name, fn, periodMs, 0, events, periodMs ? TASK_TIMED : 0);
+}
+
+/**
+ * Adds a one-shot task, removed after it has run.
+ *
+ * Parameters:
+ * name    - Name for listings.
+ * fn      - The task function.
+ * delayMs - Delay before it runs.
+ *
+ * Returns:
+ * int - Task id, or -1 if the table is full.
+ */
+int sched_after(const char *name, sched_fn_t fn, uint32_t delayMs) {
+    return add_task(name, fn, 0, delayMs, 0, TASK_TIMED | TASK_ONESHOT);
+}
+
+/**
+ * Removes a task.
+ *
+ * Parameters:
+ * id - Task id.
+ */
+void sched_cancel(int id) {
+    if (id >= 0 && id < SCHED_MAX_TASKS) {
+        tasks[id].flags = 0;
+    }
+}
+
+/**
+ * Changes a task's period, keeping the time its next run is due.
+ *
+ * Parameters:
+ * id       - Task id.
+ * periodMs - The new run interval.
+ */
+void sched_set_period(int id, uint32_t periodMs) {
+    if (id >= 0 && id < SCHED_MAX_TASKS && periodMs != 0) {
+        tasks[id].period = periodMs;
+    }
+}
+
+/**
+ * Makes a task's next run due after a delay, re-phasing a periodic task.
+ *
+ * Parameters:
+ * id      - Task id.
+ * delayMs - Delay from now.
+ */
+void sched_restart(int id, uint32_t delayMs) {
+    if (id >= 0 && id < SCHED_MAX_TASKS && (tasks[id].flags & TASK_USED)) {
+        tasks[id].due = sched_port_now() + delayMs;
+        tasks[id].flags |= TASK_TIMED;
+    }
+}
+
+/**
+ * Sets event flags. Safe from interrupts.
+ *
+ * Parameters:
+ * events - The flags to set.
+ */
+void sched_signal(uint32_t events) {
+    uint32_t state = sched_port_lock();
+    pendingEvents |= events;
+    sched_port_unlock(state);
+}
+
+/**
+ * Takes the pending events a task waits for.
+ */
+static uint32_t take_events(uint32_t mask) {
+    uint32_t state = sched_port_lock();
+    uint32_t got = pendingEvents & mask;
+    pendingEvents &= ~got;
+    sched_port_unlock(state);
+    return got;
+}
+
+/**
+ * Runs every task that is ready, once each, in table order.
+ *
+ * Returns:
+ * int - Number of tasks run.
+ */
+int sched_run_pending(void) {
+    int ran = 0;
+
+    for (int id = 0; id < SCHED_MAX_TASKS; id++) {
+        sched_task_t *t = &tasks[id];
+        uint32_t now = sched_port_now();
+        int timedOut = (t->flags & TASK_TIMED) && (int32_t)(now - t->due) >= 0;
+
+        if (!(t->flags & TASK_USED)) {
+            continue;
+        }
+        if (!(take_events(t->events) || timedOut)) {
+            continue;
+        }
+        if (t->flags & TASK_ONESHOT) {
+            t->flags = 0; // Free the slot first so the task may schedule itself again
+        } else if (timedOut) {
+            t->due += t->period;
+            if ((int32_t)(now - t->due) >= 0) {
+                t->due = now + t->period; // Fell behind: skip rather than catch up
+            }
+        }
+        t->runs++;
+        t->fn();
+        ran++;
+    }
+    return ran;
+}
+
+/**
+ * Returns the time until the next task is due.
+ *
+ * Returns:
+ * uint32_t - Milliseconds, 0 if a task is ready, SCHED_NEVER if none is timed.
+ */
+uint32_t sched_idle_ms(void) {
+    uint32_t now = sched_port_now();
+    uint32_t idle = SCHED_NEVER;
+
+    for (int id = 0; id < SCHED_MAX_TASKS; id++) {
+        const sched_task_t *t = &tasks[id];
+        if (!(t->flags & TASK_USED)) {
+            continue;
+        }
+        if (pendingEvents & t->events) {
+            return 0;
+        }
+        if (t->flags & TASK_TIMED) {
+            int32_t left = (int32_t)(t->due - now);
+            if (left <= 0) {
+                return 0;
+            }
+            if ((uint32_t)left < idle) {
+                idle = (uint32_t)left;
+            }
+        }
+    }
+    return idle;
+}
+
+/**
+ * Runs tasks forever, idling the CPU whenever nothing is ready.
+ */
+void sched_run(void) {
+    while (1) {
+        sched_run_pending();
+
+        // Check and idle with interrupts masked so an event set in between is not slept through
+        uint32_t state = sched_port_lock();
+        uint32_t idle = sched_idle_ms();
+        if (idle != 0) {
+            sched_port_idle(idle);
+        }
+        sched_port_unlock(state);
+    }
+}
+
+/**
+ * Describes a task slot.
+ *
+ * Parameters:
+ * id   - Task id, 0 to SCHED_MAX_TASKS - 1.
+ * info - Receives the description.
+ *
+ * Returns:
+ * int - 1 if the slot holds a task, 0 if it is free.
+ */
+int sched_task_info(int id, sched_info_t *info) {
+    if (id < 0 || id >= SCHED_MAX_TASKS || !(tasks[id].flags & TASK_USED)) {
+        return 0;
+    }
+    info->name = tasks[id].name;
+    info->periodMs = (tasks[id].flags & TASK_ONESHOT) ? 0 : tasks[id].period;
+    info->events = tasks[id].events;
+    info->runs = tasks[id].runs;
+    return 1;
+}
@@ -0,0 +1,160 @@
+/*
+ * sched.h
+ *
+ * Description: Cooperative run-to-completion task scheduler.
+ * Tasks are plain functions that return quickly. A task runs when its period has
+ * elapsed or when one of its event flags has been signalled, in table order; when
+ * nothing is ready the port idles the CPU until the next interrupt.
+ *
+ * The scheduler itself is hardware independent. Time, interrupt masking and idling
+ * come from the sched_port_* functions: sched_port.c on the STM32, a virtual clock in
+ * the host tests (tools/sched_host_test).
+ */
+
+#ifndef SRC_SCHED_H_
+#define SRC_SCHED_H_
+
+#include "stdint.h"
+
+#define SCHED_MAX_TASKS 12
+#define SCHED_NEVER     0xFFFFFFFFUL // sched_idle_ms() when no task is timed
+
+// Event flags set from interrupts with sched_signal()
+#define SCHED_EVENT_CONSOLE 0x0001 // A character arrived on USART2
+
+typedef void (*sched_fn_t)(void);
+
+/**
+ * A task as reported by sched_task_info().
+ */
+typedef struct {
+    const char *name;
+    uint32_t periodMs; // 0 for one-shot and event-only tasks
+    uint32_t events;
+    uint32_t runs;
+} sched_info_t;
+
+/**
+ * Adds a periodic and/or event-driven task.
+ *
+ * Parameters:
+ * name     - Name for listings.
+ * fn       - The task function.
+ * periodMs - Run interval; 0 to run on events only. The first run is due at once.
+ * events   - Event flags that also make the task run, 0 for none.
+ *
+ * Returns:
+ * int - Task id, or -1 if the table is full.
+ */
+int sched_add(const char *name, sched_fn_t fn, uint32_t periodMs, uint32_t events);
+
+/**
+ * Adds a one-shot task, removed after it has run.
+ *
+ * Parameters:
+ * name    - Name for listings.
+ * fn      - The task function.
+ * delayMs - Delay before it runs.
+ *
+ * Returns:
+ * int - Task id, or -1 if the table is full.
+ */
+int sched_after(const char *name, sched_fn_t fn, uint32_t delayMs);
+
+/**
+ * Removes a task.
+ *
+ * Parameters:
+ * id - Task id.
+ */
+void sched_cancel(int id);
+
+/**
+ * Changes a task's period, keeping the time its next run is due.
+ *
+ * Parameters:
+ * id       - Task id.
+ * periodMs - The new run interval.
+ */
+void sched_set_period(int id, uint32_t periodMs);
+
+/**
+ * Makes a task's next run due after a delay, re-phasing a periodic task.
+ *
+ * Parameters:
+ * id      - Task id.
+ * delayMs - Delay from now.
+ */
+void sched_restart(int id, uint32_t delayMs);
+
+/**
+ * Sets event flags. Safe from interrupts.
+ *
+ * Parameters:
+ * events - The flags to set.
+ */
+void sched_signal(uint32_t events);
+
+/**
+ * Runs every task that is ready, once each, in table order.
+ *
+ * Returns:
+ * int - Number of tasks run.
+ */
+int sched_run_pending(void);
+
+/**
+ * Returns the time until the next task is due.
+ *
+ * Returns:
+ * uint32_t - Milliseconds, 0 if a task is ready, SCHED_NEVER if none is timed.
+ */
+uint32_t sched_idle_ms(void);
+
+/**
+ * Runs tasks forever, idling the CPU whenever nothing is ready.
+ */
+void sched_run(void);
+
+/**
+ * Describes a task slot.
+ *
+ * Parameters:
+ * id   - Task id, 0 to SCHED_MAX_TASKS - 1.
+ * info - Receives the description.
+ *
+ * Returns:
+ * int - 1 if the slot holds a task, 0 if it is free.
+ */
+int sched_task_info(int id, sched_info_t *info);
+
+/* Port: provided by sched_port.c on the target, by the test harness on the host */
+
+/**
+ * Returns the free-running millisecond time.
+ */
+uint32_t sched_port_now(void);
+
+/**
+ * Masks interrupts.
+ *
+ * Returns:
+ * uint32_t - The previous mask state for sched_port_unlock().
+ */
+uint32_t sched_port_lock(void);
+
+/**
+ * Restores the interrupt mask saved by sched_port_lock().
+ */
+void sched_port_unlock(uint32_t state);
+
+/**
+ * Waits for an interrupt. Called with interrupts masked; the wait must still end on
+ * a pending interrupt.
+ *
+ * Parameters:
+ * idleMs - Time until the next task is due, SCHED_NEVER if none is timed.
+ */
+void sched_port_idle(uint32_t idleMs);
+
+#endif /* SRC_SCHED_H_ */
@@ -0,0 +1,49 @@
+/*
+ * sched_port.c
+ *
+ * Description: STM32 port of the task scheduler.
+ * Time comes from the SysTick millisecond counter; idling goes to power_idle(), which
+ * sleeps in WFI or, for longer idle periods, in Stop mode.
+ */
+
+#include "stm32f4xx.h"
+#include "sched.h"
+#include "timebase.h"
+#include "power.h"
+
+/**
+ * Returns the free-running millisecond time.
+ */
+uint32_t sched_port_now(void) {
+    return now_ms32();
+}
+
+/**
+ * Masks interrupts.
+ *
+ * Returns:
+ * uint32_t - The previous mask state for sched_port_unlock().
+ */
+uint32_t sched_port_lock(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+}
+
+/**
+ * Restores the interrupt mask saved by sched_port_lock().
+ */
+void sched_port_unlock(uint32_t state) {
+    __set_PRIMASK(state);
+}
+
+/**
+ * Waits for an interrupt or the next task. With PRIMASK set the handler does not run,
+ * but a pending interrupt still ends the sleep and is taken once the mask is restored.
+ *
+ * Parameters:
+ * idleMs - Time until the next task is due, SCHED_NEVER if none is timed.
+ */
+void sched_port_idle(uint32_t idleMs) {
+    power_idle(idleMs);
+}
@@ -0,0 +1,64 @@
+/*
+ * sensor_state.c
+ *
+ * Description: Double-buffered snapshot of the latest sensor readings.
+ * The writer always fills the buffer the readers are not pointed at, then flips the
+ * front index. A reader copies the front buffer and retries if the index changed
+ * meanwhile, which is the only case in which the writer may have reused that buffer.
+ */
+
+#include "sensor_state.h"
+#include "stm32f4xx.h"
+#include "timebase.h"
+
+static sensor_state_t stateBuf[2];
+static volatile uint8_t frontIdx;       // Buffer holding the latest snapshot
+static volatile uint32_t publishCount;  // Incremented on every publish
+
+/**
+ * Starts an update and returns the back buffer pre-filled with the latest snapshot.
+ */
+sensor_state_t *sensor_state_begin(void) {
+    uint8_t back = frontIdx ^ 1;
+    stateBuf[back] = stateBuf[frontIdx];
+    return &stateBuf[back];
+}
+
+/**
+ * Stamps the back buffer and makes it the front buffer.
+ */
+void sensor_state_publish(void) {
+    uint8_t back = frontIdx ^ 1;
+    stateBuf[back].seq = stateBuf[frontIdx].seq + 1;
+    stateBuf[back].timestamp = now_ms32();
+    __DMB(); // Snapshot contents must be visible before the index flips
+    frontIdx = back;
+    publishCount++;
+}
+
+/**
+ * Copies the latest published snapshot without tearing.
+ *
+ * Parameters:
+ * out - Destination for the snapshot.
+ */
+void sensor_state_read(sensor_state_t *out) {
+    uint32_t before;
+
+    do {
+        before = publishCount;
+        __DMB();
+        *out = stateBuf[frontIdx];
+        __DMB();
+    } while (publishCount != before);
+}
+
+/**
+ * Returns how many milliseconds ago a snapshot was published.
+ *
+ * Parameters:
+ * state - A snapshot obtained from sensor_state_read().
+ */
+uint32_t sensor_state_age_ms(const sensor_state_t *state) {
+    return now_ms32() - state->timestamp;
+}
@@ -0,0 +1,65 @@
+/*
+ * sensor_state.h
+ *
+ * Description: Double-buffered snapshot of the latest sensor readings.
+ * Acquisition code fills the back buffer and publishes it atomically with a sequence
+ * number and SysTick timestamp; the renderer reads the latest coherent snapshot without
+ * locks and can tell how old it is.
+ */
+
+#ifndef SRC_SENSOR_STATE_H_
+#define SRC_SENSOR_STATE_H_
+
+#include "stdint.h"
+#include "color.h"
+#include "gesture_template.h"
+
+/**
+ * One coherent set of sensor readings.
+ */
+typedef struct {
+    uint32_t seq;              // Publication number, 0 before the first publish
+    uint32_t timestamp;        // now_ms32() at publication
+    uint16_t r, g, b, c;       // Calibrated TCS34725 channels
+    uint32_t lux;              // Illuminance of the colour reading
+    uint16_t cct;              // Colour temperature in kelvin
+    PredominantColor color;    // Last colour classification
+    gesture_ext_t gesture;     // Last detected gesture
+    uint32_t gestureTimestamp; // now_ms32() when the last gesture was detected
+    uint32_t gestCnt;          // Gestures detected since the last resetCounts()
+    uint8_t UCount, DCount, LCount, RCount;
+} sensor_state_t;
+
+/**
+ * Starts an update. The returned back buffer holds a copy of the latest snapshot,
+ * so only the changed fields need to be written. Must be followed by
+ * sensor_state_publish(); only one writer context may update at a time.
+ *
+ * Returns:
+ * sensor_state_t* - the buffer to fill.
+ */
+sensor_state_t *sensor_state_begin(void);
+
+/**
+ * Publishes the buffer returned by sensor_state_begin() as the latest snapshot.
+ */
+void sensor_state_publish(void);
+
+/**
+ * Copies the latest published snapshot. Safe from any context; retries if a
+ * publish happens during the copy.
+ *
+ * Parameters:
+ * out - Destination for the snapshot.
+ */
+void sensor_state_read(sensor_state_t *out);
+
+/**
+ * Returns how many milliseconds ago a snapshot was published.
+ *
+ * Parameters:
+ * state - A snapshot obtained from sensor_state_read().
+ */
+uint32_t sensor_state_age_ms(const sensor_state_t *state);
+
+#endif /* SRC_SENSOR_STATE_H_ */
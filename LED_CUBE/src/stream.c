@@ -0,0 +1,238 @@
+/*
+ * stream.c
+ *
+ * Description: Binary frame streaming into the cube over USART2.
+ * Bytes are decoded straight from the DMA buffer in the receive interrupt. A full frame
+ * is decoded into whichever of two frame buffers is off screen and shown by handing its
+ * pointer to LED_ShowFrame(), so no frame is copied. Delta and key frames are received
+ * into a separate buffer and decoded into the off-screen one.
+ */
+
+#include "stm32f4xx.h"
+#include "stream.h"
+#include "string.h"
+
+#include "console.h"
+#include "cobs.h"
+#include "crc.h"
+#include "uart.h"
+#include "timebase.h"
+
+#if FRAME_CODEC_FRAME_BYTES != LED_FRAME_BYTES
+#error "frame_codec.h and led.h disagree on the frame size"
+#endif
+
+/**
+ * A decoded packet. The payload follows the header directly so the CRC covers one
+ * contiguous, word-aligned block; a full frame's payload is the displayed frame.
+ */
+typedef struct {
+    uint8_t header[STREAM_HEADER_BYTES];
+    uint8_t payload[STREAM_PAYLOAD_MAX + STREAM_CRC_BYTES];
+} __attribute__((aligned(4))) stream_packet_t;
+
+static stream_packet_t frames[2];     // One on display, one being filled
+static stream_packet_t deltaPkt;
+static uint8_t backIdx;               // Index of the frame off screen
+static stream_packet_t *rxPkt;        // Destination of the packet being decoded
+static uint16_t rxLen;                // Decoded bytes so far
+static cobs_decoder_t decoder;
+static uint8_t lastSeq;
+static uint32_t firstMs;
+static stream_stats_t stats;
+static uint32_t savedBaud;            // Console rate to restore on exit
+static volatile uint8_t active;
+static volatile uint8_t exitRequested;
+
+/**
+ * Shows the frame buffer that was just filled and makes the other one the back buffer.
+ */
+static void show_back(void) {
+    LED_ShowFrame(frames[backIdx].payload);
+    backIdx ^= 1;
+    if (stats.frames++ == 0) {
+        firstMs = now_ms32();
+    }
+    stats.elapsedMs = now_ms32() - firstMs;
+}
+
+/**
+ * Checks and acts on a completely decoded packet.
+ */
+static void packet_done(void) {
+    uint8_t *raw = (uint8_t *)rxPkt;
+    uint16_t len = rxPkt->header[2] | (rxPkt->header[3] << 8);
+    uint32_t end = STREAM_HEADER_BYTES + len;
+    uint32_t padded = (end + 3) & ~3UL;
+    uint32_t crc;
+
+    if (len > STREAM_PAYLOAD_MAX || rxLen != end + STREAM_CRC_BYTES) {
+        stats.framingErrors++;
+        return;
+    }
+    memcpy(&crc, &raw[end], STREAM_CRC_BYTES);
+    memset(&raw[end], 0, padded - end);
+    if (crc32_hw((const uint32_t *)raw, padded / 4) != crc) {
+        stats.crcErrors++;
+        return;
+    }
+    if (stats.frames != 0) {
+        stats.lost += (uint8_t)(rxPkt->header[1] - lastSeq - 1);
+    }
+    lastSeq = rxPkt->header[1];
+
+    switch (rxPkt->header[0]) {
+        case STREAM_FULL:
+            if (len != LED_FRAME_BYTES) {
+                stats.framingErrors++;
+                return;
+            }
+            show_back();
+            break;
+        case STREAM_DELTA:
+        case STREAM_KEY: {
+            const uint8_t *ref = (rxPkt->header[0] == STREAM_DELTA) ? frames[backIdx ^ 1].payload : NULL;
+            uint32_t start = DWT->CYCCNT;
+            if (!frame_decode(deltaPkt.payload, len, ref, frames[backIdx].payload)) {
+                stats.framingErrors++;
+                return;
+            }
+            uint32_t cycles = DWT->CYCCNT - start;
+            if (cycles > stats.decodeCycles) {
+                stats.decodeCycles = cycles;
+            }
+            stats.deltas++;
+            show_back();
+            break;
+        }
+        case STREAM_EXIT:
+            exitRequested = 1;
+            break;
+        default:
+            stats.framingErrors++;
+            break;
+    }
+}
+
+/**
+ * Receive handler: decodes the bytes DMA delivered, in interrupt context.
+ */
+static void stream_rx(const uint8_t *data, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+        uint8_t b;
+
+        switch (cobs_decode_byte(&decoder, data[i], &b)) {
+            case COBS_DATA:
+                if (rxLen == 0) {
+                    // Full frames land in the back buffer, everything else in the delta buffer
+                    rxPkt = (b == STREAM_FULL) ? &frames[backIdx] : &deltaPkt;
+                }
+                if (rxLen < sizeof(stream_packet_t)) {
+                    ((uint8_t *)rxPkt)[rxLen] = b;
+                }
+                rxLen++;
+                break;
+            case COBS_END:
+                if (rxLen != 0) {
+                    packet_done();
+                }
+                rxLen = 0;
+                break;
+            case COBS_ERROR:
+                stats.framingErrors++;
+                rxLen = 0;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/**
+ * Enters streaming mode: reception switches to circular DMA and received frames
+ * replace the patterns on the cube until an exit packet arrives.
+ *
+ * Parameters:
+ * baud - The rate to stream at; 0 keeps the current one.
+ *
+ * Returns:
+ * int - 1 on success, 0 if the rate cannot be reached.
+ */
+int stream_start(uint32_t baud) {
+    savedBaud = USART2_GetBaud();
+    if (baud != 0 && baud != savedBaud) {
+        console_print("streaming at ");
+        console_print_u32(baud, 0);
+        console_print(" baud, send an exit packet to return\n\r");
+        if (!USART2_SetBaud(baud)) {
+            return 0;
+        }
+    }
+
+    crc_init();
+    memset(&stats, 0, sizeof(stats));
+    memset(frames[1].payload, 0, LED_FRAME_BYTES);
+    memset(&decoder, 0, sizeof(decoder));
+    backIdx = 0;
+    rxLen = 0;
+    exitRequested = 0;
+    LED_ShowFrame(frames[1].payload); // Start from a blank cube
+    active = 1;
+    uart_rx_dma_start(stream_rx);
+    return 1;
+}
+
+/**
+ * Returns 1 while streaming mode is active.
+ */
+int stream_active(void) {
+    return active;
+}
+
+/**
+ * Leaves streaming mode once an exit packet has arrived and prints the counters.
+ * Call regularly from the main context.
+ *
+ * Returns:
+ * int - 1 while streaming continues.
+ */
+int stream_poll(void) {
+    if (!active) {
+        return 0;
+    }
+    if (!exitRequested) {
+        return 1;
+    }
+    uart_rx_dma_stop();
+    LED_ShowFrame(NULL);
+    active = 0;
+    if (USART2_GetBaud() != savedBaud) {
+        USART2_SetBaud(savedBaud);
+    }
+    console_print("stream: ");
+    console_print_u32(stats.frames, 0);
+    console_print(" frames (");
+    console_print_u32(stats.deltas, 0);
+    console_print(" coded) in ");
+    console_print_u32(stats.elapsedMs, 0);
+    console_print(" ms, ");
+    console_print_u32(stats.crcErrors, 0);
+    console_print(" crc errors, ");
+    console_print_u32(stats.framingErrors, 0);
+    console_print(" framing errors, ");
+    console_print_u32(stats.lost, 0);
+    console_print(" lost\n\rstream: longest frame decode ");
+    console_print_u32(stats.decodeCycles, 0);
+    console_print(" cycles\n\r");
+    return 0;
+}
+
+/**
+ * Copies the reception counters.
+ *
+ * Parameters:
+ * out - Receives the counters.
+ */
+void stream_get_stats(stream_stats_t *out) {
+    *out = stats;
+}
@@ -0,0 +1,84 @@
+/*
+ * stream.h
+ *
+ * Description: Binary frame streaming into the cube over USART2.
+ * Packets are COBS framed (0x00 delimited) and laid out as:
+ *
+ *   type (1) | sequence (1) | payload length (2, little-endian) | payload | CRC-32 (4, little-endian)
+ *
+ * The CRC is the STM32 hardware CRC over the header and payload zero-padded to whole
+ * little-endian words. A full frame carries LED_FRAME_BYTES in framebuffer layout; a delta
+ * frame carries the frame_codec encoding against the frame on display and a key frame
+ * the encoding against a blank frame.
+ */
+
+#ifndef SRC_STREAM_H_
+#define SRC_STREAM_H_
+
+#include "stdint.h"
+#include "led.h"
+#include "frame_codec.h"
+
+#define STREAM_BAUD         1000000 // Default rate, exact at PCLK1 = 16 MHz
+#define STREAM_HEADER_BYTES 4
+#define STREAM_CRC_BYTES    4
+#define STREAM_PAYLOAD_MAX  FRAME_CODEC_MAX_ENCODED // Largest delta: every byte changed
+
+/**
+ * Packet types.
+ */
+typedef enum {
+    STREAM_FULL = 0x01,  // A complete frame
+    STREAM_DELTA = 0x02, // frame_codec encoding against the frame on display
+    STREAM_EXIT = 0x03,  // Leave streaming mode, no payload
+    STREAM_KEY = 0x04    // frame_codec encoding against a blank frame
+} stream_type_t;
+
+/**
+ * Reception counters since streaming started.
+ */
+typedef struct {
+    uint32_t frames;        // Frames shown, full and delta
+    uint32_t deltas;        // Of which delta and key frames
+    uint32_t crcErrors;     // Packets with a bad CRC
+    uint32_t framingErrors; // Malformed packets
+    uint32_t lost;          // Gaps in the sequence numbers
+    uint32_t elapsedMs;     // From the first frame to the last
+    uint32_t decodeCycles;  // Longest frame_codec decode
+} stream_stats_t;
+
+/**
+ * Enters streaming mode: reception switches to circular DMA and received frames
+ * replace the patterns on the cube until an exit packet arrives.
+ *
+ * Parameters:
+ * baud - The rate to stream at; 0 keeps the current one.
+ *
+ * Returns:
+ * int - 1 on success, 0 if the rate cannot be reached.
+ */
+int stream_start(uint32_t baud);
+
+/**
+ * Returns 1 while streaming mode is active.
+ */
+int stream_active(void);
+
+/**
+ * Leaves streaming mode once an exit packet has arrived and prints the counters.
+ * Call regularly from the main context.
+ *
+ * Returns:
+ * int - 1 while streaming continues.
+ */
+int stream_poll(void);
+
+/**
+ * Copies the reception counters.
+ *
+ * Parameters:
+ * out - Receives the counters.
+ */
+void stream_get_stats(stream_stats_t *out);
+
+#endif /* SRC_STREAM_H_ */
@@ -0,0 +1,142 @@
+/*
+ * telemetry.c
+ *
+ * Description: Binary sensor telemetry on USART2.
+ * Records are packed field by field, so their layout does not depend on struct padding.
+ */
+
+#include "telemetry.h"
+#include "stm32f4xx.h"
+#include "log.h"
+#include "timebase.h"
+#include "uart.h"
+#include "sensor_state.h"
+
+#define GFIFO_RECORD_MAX (TELEM_HEADER_BYTES + 1 + GESTURE_FIFO_DEPTH * 4)
+
+#if GFIFO_RECORD_MAX >= LOG_FRAME_MAX
+#error "LOG_FRAME_MAX cannot hold a full GFIFO record"
+#endif
+
+static uint32_t period;
+static uint32_t colorDue;
+static uint32_t timingDue;
+static uint32_t lastGesture;  // gestureTimestamp of the last GESTURE record
+static uint16_t sequence;
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+    p = put_u16(p, (uint16_t)v);
+    return put_u16(p, (uint16_t)(v >> 16));
+}
+
+/**
+ * Writes the sequence number and timestamp that start every record.
+ */
+static uint8_t *put_header(uint8_t *p, uint32_t timestamp) {
+    p = put_u16(p, sequence++);
+    return put_u32(p, timestamp);
+}
+
+/**
+ * Starts or stops the telemetry stream.
+ *
+ * Parameters:
+ * periodMs - COLOR record interval in milliseconds, 0 to stop.
+ */
+void telemetry_set_period(uint32_t periodMs) {
+    sensor_state_t snap;
+
+    sensor_state_read(&snap);
+    lastGesture = snap.gestureTimestamp; // Only gestures from now on
+    colorDue = timingDue = now_ms32();
+    period = periodMs;
+}
+
+/**
+ * Returns the COLOR record interval, 0 while telemetry is off.
+ */
+uint32_t telemetry_period(void) {
+    return period;
+}
+
+/**
+ * Sends the records that are due. Call regularly from the main context.
+ */
+void telemetry_poll(void) {
+    uint8_t rec[32];
+    uint8_t *p;
+    uint32_t now = now_ms32();
+    sensor_state_t snap;
+
+    if (period == 0) {
+        return;
+    }
+    if ((int32_t)(now - colorDue) >= 0) {
+        colorDue += period;
+        if ((int32_t)(now - colorDue) >= 0) {
+            colorDue = now + period; // Fell behind; skip rather than burst
+        }
+        sensor_state_read(&snap);
+        p = put_header(rec, snap.timestamp);
+        p = put_u16(p, snap.r);
+        p = put_u16(p, snap.g);
+        p = put_u16(p, snap.b);
+        p = put_u16(p, snap.c);
+        p = put_u32(p, snap.lux);
+        p = put_u16(p, snap.cct);
+        *p++ = (uint8_t)snap.color;
+        p = put_u32(p, TCS34725_ClassifyCycles());
+        log_send_frame(TELEM_FRAME_COLOR, rec, p - rec);
+
+        if (snap.gestureTimestamp != lastGesture) {
+            lastGesture = snap.gestureTimestamp;
+            p = put_header(rec, snap.gestureTimestamp);
+            *p++ = (uint8_t)snap.gesture;
+            p = put_u32(p, snap.gestCnt);
+            log_send_frame(TELEM_FRAME_GESTURE, rec, p - rec);
+        }
+    }
+    if ((int32_t)(now - timingDue) >= 0) {
+        timingDue = now + TELEMETRY_TIMING_MS;
+        p = put_header(rec, now);
+        p = put_u32(p, TCS34725_Samples());
+        p = put_u32(p, apds9960_datasets());
+        p = put_u32(p, uart_tx_dropped());
+        p = put_u32(p, log_dropped());
+        log_send_frame(TELEM_FRAME_TIMING, rec, p - rec);
+    }
+}
+
+/**
+ * Sends a burst of gesture FIFO datasets if telemetry is on.
+ *
+ * Parameters:
+ * samples - The datasets, oldest first.
+ * count   - Number of datasets.
+ */
+void telemetry_gfifo(const gesture_sample_t *samples, int count) {
+    uint8_t rec[GFIFO_RECORD_MAX];
+    uint8_t *p;
+
+    if (period == 0 || count <= 0) {
+        return;
+    }
+    if (count > GESTURE_FIFO_DEPTH) {
+        count = GESTURE_FIFO_DEPTH;
+    }
+    p = put_header(rec, now_ms32());
+    *p++ = (uint8_t)count;
+    for (int i = 0; i < count; i++) {
+        *p++ = samples[i].u;
+        *p++ = samples[i].d;
+        *p++ = samples[i].l;
+        *p++ = samples[i].r;
+    }
+    log_send_frame(TELEM_FRAME_GFIFO, rec, p - rec);
+}
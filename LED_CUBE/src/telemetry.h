@@ -0,0 +1,67 @@
+/*
+ * telemetry.h
+ *
+ * Description: Binary sensor telemetry on USART2 for host plotting (tools/telemetry_csv).
+ * Records are sent with log_send_frame(), so they share the tokenized log's COBS framing
+ * and interleave with it. Every record starts with a sequence number shared by all record
+ * types and a millisecond timestamp; all fields are little-endian:
+ *
+ *   COLOR   seq u16, ms u32, r g b c u16, lux u32, cct u16, colour u8, classify cycles u32
+ *   GFIFO   seq u16, ms u32, count u8, count x (U, D, L, R u8)
+ *   GESTURE seq u16, ms u32, gesture u8, gestures since reset u32
+ *   TIMING  seq u16, ms u32, colour samples u32, gesture datasets u32,
+ *           UART bytes dropped u32, log records dropped u32
+ *   TRACE   burst u16, ms u32, U, D, L, R u8
+ *
+ * COLOR goes out at the telemetry period, TIMING once a second, GFIFO with every FIFO
+ * burst and GESTURE with every detection. TRACE carries one recorded dataset of a
+ * gesture_trace_download() and has no sequence number: the download paces itself to
+ * the free transmit space instead of losing frames.
+ */
+
+#ifndef SRC_TELEMETRY_H_
+#define SRC_TELEMETRY_H_
+
+#include "stdint.h"
+#include "gesture_classify.h"
+
+#define TELEMETRY_PERIOD_MS 100  // Default COLOR record interval
+#define TELEMETRY_TIMING_MS 1000 // TIMING record interval
+
+// Frame types, following LOG_FRAME_EVENT
+#define TELEM_FRAME_COLOR   0x02
+#define TELEM_FRAME_GFIFO   0x03
+#define TELEM_FRAME_GESTURE 0x04
+#define TELEM_FRAME_TIMING  0x05
+#define TELEM_FRAME_TRACE   0x06
+
+#define TELEM_HEADER_BYTES  6 // Sequence number and timestamp
+
+/**
+ * Starts or stops the telemetry stream.
+ *
+ * Parameters:
+ * periodMs - COLOR record interval in milliseconds, 0 to stop.
+ */
+void telemetry_set_period(uint32_t periodMs);
+
+/**
+ * Returns the COLOR record interval, 0 while telemetry is off.
+ */
+uint32_t telemetry_period(void);
+
+/**
+ * Sends the records that are due. Call regularly from the main context.
+ */
+void telemetry_poll(void);
+
+/**
+ * Sends a burst of gesture FIFO datasets if telemetry is on.
+ *
+ * Parameters:
+ * samples - The datasets, oldest first.
+ * count   - Number of datasets.
+ */
+void telemetry_gfifo(const gesture_sample_t *samples, int count);
+
+#endif /* SRC_TELEMETRY_H_ */
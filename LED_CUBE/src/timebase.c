@@ -0,0 +1,139 @@
+/*
+ * timebase.c
+ *
+ * Description: Monotonic time base from SysTick.
+ * The handler counts milliseconds; the microseconds within the current millisecond come
+ * from the SysTick current value, which counts core clock cycles down to the next tick.
+ * SysTick keeps counting through WFI, where the DWT cycle counter stops with the core
+ * clock, so idling does not disturb the time.
+ */
+
+#include "timebase.h"
+#include "stm32f4xx.h"
+
+static volatile uint64_t ticksMs; // Milliseconds since start-up
+static uint32_t carryUs;          // Sub-millisecond part of the time added in Stop mode
+
+/**
+ * Starts the DWT cycle counter that the profiling counters and cycle timings read.
+ * Call once at start-up, before anything reads DWT->CYCCNT.
+ */
+void timebase_init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/**
+ * Advances the millisecond counter. Called from SysTick_Handler().
+ */
+void timebase_tick(void) {
+    ticksMs++;
+}
+
+/**
+ * Adds time that passed while SysTick was stopped (Stop mode). Call with interrupts
+ * masked.
+ *
+ * Parameters:
+ * us - Microseconds to add; remainders below a millisecond are carried over.
+ */
+void timebase_advance_us(uint32_t us) {
+    carryUs += us % 1000;
+    ticksMs += us / 1000 + carryUs / 1000;
+    carryUs %= 1000;
+}
+
+/**
+ * Returns the milliseconds since start-up.
+ */
+uint64_t now_ms(void) {
+    uint64_t ms;
+
+    // The 64-bit read takes two loads; read again if a tick came in between
+    do {
+        ms = ticksMs;
+    } while (ms != ticksMs);
+    return ms;
+}
+
+/**
+ * Returns the low 32 bits of now_ms(). It wraps after 49.7 days, so compare two
+ * readings by subtracting them.
+ */
+uint32_t now_ms32(void) {
+    return (uint32_t)ticksMs; // A single load, no retry needed
+}
+
+/**
+ * Returns the microseconds since start-up.
+ */
+uint64_t now_us(void) {
+    uint32_t load = SysTick->LOAD;
+    uint32_t cyclesPerUs = (load + 1) / 1000;
+    uint32_t val, val2, pending;
+    uint64_t ms;
+
+    do {
+        ms = ticksMs;
+        val = SysTick->VAL;
+        pending = SCB->ICSR & SCB_ICSR_PENDSTSET_Msk;
+        val2 = SysTick->VAL;
+    } while (ms != ticksMs);
+    if (val2 > val) {
+        // Reloaded between the two reads: the tick is pending and val2 belongs to it
+        val = val2;
+        pending = 1;
+    }
+    if (pending) {
+        ms++; // The tick has happened but its handler is held off by masked interrupts
+    }
+    return ms * 1000 + (load - val) / (cyclesPerUs ? cyclesPerUs : 1);
+}
+
+/**
+ * Returns the milliseconds elapsed since a now_ms() reading, saturated to 32 bits.
+ */
+uint32_t elapsed_ms(uint64_t sinceMs) {
+    uint64_t elapsed = now_ms() - sinceMs;
+
+    return (elapsed > UINT32_MAX) ? UINT32_MAX : (uint32_t)elapsed;
+}
+
+/**
+ * Returns the microseconds elapsed since a now_us() reading, saturated to 32 bits.
+ */
+uint32_t elapsed_us(uint64_t sinceUs) {
+    uint64_t elapsed = now_us() - sinceUs;
+
+    return (elapsed > UINT32_MAX) ? UINT32_MAX : (uint32_t)elapsed;
+}
+
+/**
+ * Returns a deadline a number of microseconds from now.
+ */
+deadline_t deadline_in_us(uint32_t us) {
+    return now_us() + us;
+}
+
+/**
+ * Returns a deadline a number of milliseconds from now.
+ */
+deadline_t deadline_in_ms(uint32_t ms) {
+    return now_us() + (uint64_t)ms * 1000;
+}
+
+/**
+ * Returns 1 once the deadline has been reached, 0 before.
+ */
+int deadline_expired(deadline_t deadline) {
+    return now_us() >= deadline;
+}
+
+/**
+ * Returns the whole milliseconds left until a deadline, 0 once it has expired.
+ */
+uint32_t deadline_left_ms(deadline_t deadline) {
+    uint64_t now = now_us();
+
+    return (now >= deadline) ? 0 : (uint32_t)((deadline - now) / 1000);
+}
@@ -0,0 +1,83 @@
+/*
+ * timebase.h
+ *
+ * Description: Monotonic time base.
+ * SysTick advances a 64-bit millisecond counter and its current value fills in the
+ * microseconds, so the time follows clock profile switches without help. Sensor
+ * readings, log records, telemetry and streamed frames all take their timestamps here.
+ */
+
+#ifndef SRC_TIMEBASE_H_
+#define SRC_TIMEBASE_H_
+
+#include "stdint.h"
+
+typedef uint64_t deadline_t; // Absolute time in microseconds
+
+/**
+ * Starts the DWT cycle counter that the profiling counters and cycle timings read.
+ * Call once at start-up, before anything reads DWT->CYCCNT.
+ */
+void timebase_init(void);
+
+/**
+ * Advances the millisecond counter. Called from SysTick_Handler().
+ */
+void timebase_tick(void);
+
+/**
+ * Adds time that passed while SysTick was stopped (Stop mode). Call with interrupts
+ * masked.
+ *
+ * Parameters:
+ * us - Microseconds to add; remainders below a millisecond are carried over.
+ */
+void timebase_advance_us(uint32_t us);
+
+/**
+ * Returns the milliseconds since start-up.
+ */
+uint64_t now_ms(void);
+
+/**
+ * Returns the low 32 bits of now_ms(). It wraps after 49.7 days, so compare two
+ * readings by subtracting them.
+ */
+uint32_t now_ms32(void);
+
+/**
+ * Returns the microseconds since start-up.
+ */
+uint64_t now_us(void);
+
+/**
+ * Returns the milliseconds elapsed since a now_ms() reading, saturated to 32 bits.
+ */
+uint32_t elapsed_ms(uint64_t sinceMs);
+
+/**
+ * Returns the microseconds elapsed since a now_us() reading, saturated to 32 bits.
+ */
+uint32_t elapsed_us(uint64_t sinceUs);
+
+/**
+ * Returns a deadline a number of microseconds from now.
+ */
+deadline_t deadline_in_us(uint32_t us);
+
+/**
+ * Returns a deadline a number of milliseconds from now.
+ */
+deadline_t deadline_in_ms(uint32_t ms);
+
+/**
+ * Returns 1 once the deadline has been reached, 0 before.
+ */
+int deadline_expired(deadline_t deadline);
+
+/**
+ * Returns the whole milliseconds left until a deadline, 0 once it has expired.
+ */
+uint32_t deadline_left_ms(deadline_t deadline);
+
+#endif /* SRC_TIMEBASE_H_ */
@@ -20,12 +20,91 @@
 #include "stdio.h"
 #include "string.h"
 #include "i2c.h"
+#include "uart_brr.h"
+#include "clock.h"
+#include "sched.h"
+
+
+// Transmit ring drained by DMA1 Stream6 (channel 4 = USART2_TX)
+static uint8_t txBuf[UART_TX_BUF_SIZE];
+static volatile uint16_t txHead;    // Next byte to fill
+static volatile uint16_t txTail;    // First byte not yet sent (start of the DMA block)
+static volatile uint16_t txDmaLen;  // Bytes in the running DMA block, 0 when idle
+static volatile uint32_t txDropped;
+static uart_tx_policy_t txPolicy = UART_TX_POLICY;
+static uint8_t txReady;             // DMA configured; output before that waits in the ring
+// Receive ring filled by the RXNE interrupt
+static uint8_t rxBuf[UART_RX_BUF_SIZE];
+static volatile uint8_t rxHead;     // Next slot the interrupt fills
+static volatile uint8_t rxTail;     // Next character to take
+static volatile uint32_t rxOverruns;
+// Circular receive buffer filled by DMA1 Stream5 (channel 4 = USART2_RX) in DMA mode
+static uint8_t rxDmaBuf[UART_RX_DMA_SIZE];
+static uint16_t rxDmaPos;           // First byte not yet handed to the handler
+static uart_rx_handler_t rxDmaHandler;
+
+static uint32_t baudRequested;      // Rate asked for, kept to re-derive BRR on clock changes
+static uint32_t baudActual;         // Rate the current BRR produces
+
+#define TX_USED() ((uint16_t)(txHead - txTail) & (UART_TX_BUF_SIZE - 1))
+
+/**
+ * Starts DMA on the next contiguous block of queued bytes if none is running.
+ * Called with interrupts masked or from the DMA interrupt.
+ */
+static void tx_kick(void) {
+    uint16_t len;
+
+    if (!txReady || txDmaLen != 0 || txHead == txTail) {
+        return;
+    }
+    // Stop at the end of the buffer; the wrapped part follows in the next block
+    len = (txHead > txTail) ? txHead - txTail : UART_TX_BUF_SIZE - txTail;
+    txDmaLen = len;
+
+    DMA1->HIFCR = DMA_HIFCR_CTCIF6 | DMA_HIFCR_CHTIF6 | DMA_HIFCR_CTEIF6 | DMA_HIFCR_CDMEIF6 | DMA_HIFCR_CFEIF6;
+    DMA1_Stream6->M0AR = (uint32_t)&txBuf[txTail];
+    DMA1_Stream6->NDTR = len;
+    DMA1_Stream6->CR |= DMA_SxCR_EN;
+}
+
+/**
+ * Writes BRR and OVER8 for a baud rate at the current APB1 clock.
+ * The USART must be disabled or idle.
+ *
+ * Returns:
+ * uint32_t - The rate actually set, or 0 if it cannot be reached.
+ */
+static uint32_t apply_baud(uint32_t baud) {
+    uint16_t brr;
+    int over8;
+    uint32_t actual = uart_brr_select(clock_pclk1_hz(), baud, &brr, &over8);
+
+    if (actual == 0) {
+        return 0;
+    }
+    USART2->CR1 &= ~USART_CR1_UE;
+    if (over8) {
+        USART2->CR1 |= USART_CR1_OVER8;
+    } else {
+        USART2->CR1 &= ~USART_CR1_OVER8;
+    }
+    USART2->BRR = brr;
+    USART2->CR1 |= USART_CR1_UE;
+    baudRequested = baud;
+    baudActual = actual;
+    return actual;
+}
 
 /**
  * Configures USART2 for UART communication.
  * Sets up GPIO pins for USART2, configures baud rate, and enables the transmitter and receiver.
+ * Transmission runs through DMA1 Stream6 with a transfer-complete interrupt.
+ *
+ * Parameters:
+ * baud - The baud rate, derived from the current APB1 clock.
  */
-void USART2_Config(void) {
+void USART2_Config(uint32_t baud) {
     // Enable USART2 and GPIOA clocks
     RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN;
     RCC->APB1ENR |= RCC_APB1ENR_USART2EN;
@@ -34,11 +113,137 @@ void USART2_Config(void) {
     GPIOA->AFR[0] = (7 << (4 * 2)) | (7 << (4 * 3));
     GPIOA->MODER = (GPIOA->MODER & ~(3 << (2 * 2))) | (2 << (2 * 2)) | (2 << (2 * 3));
 
-    // Configure USART2
-    USART2->BRR = 0x683; // 9600 baud rate @ 16MHz
-    USART2->CR1 = USART_CR1_TE | USART_CR1_RE  | USART_CR1_UE; // Enable transmitter and USART
+    // Configure USART2, falling back to 9600 baud if the rate is out of reach
+    USART2->CR1 = USART_CR1_TE | USART_CR1_RE; // Enable transmitter and receiver
+    if (!apply_baud(baud)) {
+        apply_baud(9600);
+    }
+    USART2->CR3 |= USART_CR3_DMAT; // Transmit requests go to DMA
+    USART2->CR1 |= USART_CR1_RXNEIE; // Received characters raise an interrupt
+    NVIC_EnableIRQ(USART2_IRQn);
+
+    // DMA1 Stream6, channel 4, memory to peripheral, byte transfers, memory increment
+    RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+    DMA1_Stream6->CR &= ~DMA_SxCR_EN;
+    while (DMA1_Stream6->CR & DMA_SxCR_EN);
+    DMA1_Stream6->PAR = (uint32_t)&USART2->DR;
+    DMA1_Stream6->CR = (4UL << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC | DMA_SxCR_DIR_0 |
+                       DMA_SxCR_TCIE | DMA_SxCR_TEIE;
+    NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+
+    // Send whatever was printed before the UART was ready
+    __disable_irq();
+    txReady = 1;
+    tx_kick();
+    __enable_irq();
+}
+
+/**
+ * Changes the baud rate, or re-derives it after an APB1 clock change.
+ * Pending output is sent at the old rate first.
+ *
+ * Parameters:
+ * baud - The new baud rate.
+ *
+ * Returns:
+ * uint32_t - The rate actually set, or 0 if it cannot be reached (the old rate is kept).
+ */
+uint32_t USART2_SetBaud(uint32_t baud) {
+    uint16_t brr;
+    int over8;
+
+    if (uart_brr_select(clock_pclk1_hz(), baud, &brr, &over8) == 0) {
+        return 0;
+    }
+    uart_tx_flush();
+    return apply_baud(baud);
+}
+
+/**
+ * Re-derives BRR for the requested rate after the APB1 clock has changed.
+ * Call uart_tx_flush() before changing the clock so no byte straddles the switch.
+ */
+void USART2_ClockChanged(void) {
+    if (baudRequested == 0) {
+        return; // Not initialized yet
+    }
+    apply_baud(baudRequested);
+}
+
+/**
+ * Returns the baud rate currently set.
+ */
+uint32_t USART2_GetBaud(void) {
+    return baudActual;
+}
+
+/**
+ * DMA1 Stream6 interrupt: releases the block just sent and starts the next one.
+ */
+void DMA1_Stream6_IRQHandler(void) {
+    uint32_t status = DMA1->HISR;
+
+    DMA1->HIFCR = DMA_HIFCR_CTCIF6 | DMA_HIFCR_CTEIF6;
+    if (status & DMA_HISR_TEIF6) {
+        txDropped += txDmaLen; // The block is lost, carry on with the rest
+    }
+    if (status & (DMA_HISR_TCIF6 | DMA_HISR_TEIF6)) {
+        txTail = (txTail + txDmaLen) & (UART_TX_BUF_SIZE - 1);
+        txDmaLen = 0;
+        tx_kick();
+    }
+}
+
+/**
+ * Selects what happens when the transmit ring is full.
+ *
+ * Parameters:
+ * policy - UART_TX_DROP, UART_TX_TRUNCATE or UART_TX_BLOCK.
+ *
+ * Returns:
+ * uart_tx_policy_t - The previous policy.
+ */
+uart_tx_policy_t uart_tx_set_policy(uart_tx_policy_t policy) {
+    uart_tx_policy_t old = txPolicy;
+    txPolicy = policy;
+    return old;
+}
+
+/**
+ * Waits until every queued byte has been sent, including the last one on the wire.
+ * Returns at once before USART2_Config(): nothing is on the wire, and bytes queued
+ * that early are sent once the UART runs.
+ */
+void uart_tx_flush(void) {
+    if (!txReady) {
+        return;
+    }
+    while (!uart_tx_idle());
+}
+
+/**
+ * Returns 1 when every queued byte has been sent, including the last one on the wire.
+ * USART2 is unclocked before USART2_Config(), so only the ring is checked then.
+ */
+int uart_tx_idle(void) {
+    if (!txReady) {
+        return txHead == txTail;
+    }
+    return (txHead == txTail) && (USART2->SR & USART_SR_TC);
+}
 
+/**
+ * Returns the number of bytes discarded because the transmit ring was full.
+ */
+uint32_t uart_tx_dropped(void) {
+    return txDropped;
+}
 
+/**
+ * Returns the number of bytes the transmit ring can take without dropping or waiting.
+ */
+uint32_t uart_tx_free(void) {
+    return UART_TX_BUF_SIZE - 1 - TX_USED();
 }
 
 /**
@@ -46,12 +251,7 @@ void USART2_Config(void) {
   * @param ch: Character to be transmitted
   */
 void UART2_TxChar(char ch) {
-    while (!(USART2->SR & USART_SR_TXE))
-    	{
-    	;
-    	}
-
-    USART2->DR = ch;
+    _write(1, &ch, 1);
 }
 
 /**
@@ -59,12 +259,149 @@ void UART2_TxChar(char ch) {
   * @return Received character
   */
 char UART2_RxChar() {
-    while (!(USART2->SR & USART_SR_RXNE));
-    return USART2->DR;
+    int ch;
+
+    while ((ch = uart_rx_getc()) < 0);
+    return (char)ch;
+}
+
+/**
+ * Hands the bytes DMA has written since the last call to the receive handler.
+ * Runs from the half-transfer, transfer-complete and IDLE interrupts, which share a
+ * priority, so it is never re-entered.
+ */
+static void rx_dma_service(void) {
+    uint16_t pos = (UART_RX_DMA_SIZE - DMA1_Stream5->NDTR) & (UART_RX_DMA_SIZE - 1);
+
+    if (rxDmaHandler == NULL) {
+        return;
+    }
+    if (pos < rxDmaPos) {
+        rxDmaHandler(&rxDmaBuf[rxDmaPos], UART_RX_DMA_SIZE - rxDmaPos);
+        rxDmaPos = 0;
+    }
+    if (pos > rxDmaPos) {
+        rxDmaHandler(&rxDmaBuf[rxDmaPos], pos - rxDmaPos);
+        rxDmaPos = pos;
+    }
+}
+
+/**
+ * Switches reception from the character ring to circular DMA.
+ * The buffer is serviced at half and full transfer and whenever the line goes idle,
+ * so a burst is delivered as soon as it ends without a per-byte interrupt.
+ *
+ * Parameters:
+ * handler - Called from interrupt context with each run of received bytes.
+ */
+void uart_rx_dma_start(uart_rx_handler_t handler) {
+    USART2->CR1 &= ~(USART_CR1_RXNEIE | USART_CR1_IDLEIE);
+    DMA1_Stream5->CR &= ~DMA_SxCR_EN;
+    while (DMA1_Stream5->CR & DMA_SxCR_EN);
+
+    rxDmaHandler = handler;
+    rxDmaPos = 0;
+    DMA1->HIFCR = DMA_HIFCR_CTCIF5 | DMA_HIFCR_CHTIF5 | DMA_HIFCR_CTEIF5 | DMA_HIFCR_CDMEIF5 | DMA_HIFCR_CFEIF5;
+    DMA1_Stream5->PAR = (uint32_t)&USART2->DR;
+    DMA1_Stream5->M0AR = (uint32_t)rxDmaBuf;
+    DMA1_Stream5->NDTR = UART_RX_DMA_SIZE;
+    // Channel 4, peripheral to memory, byte transfers, memory increment, circular
+    DMA1_Stream5->CR = (4UL << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC | DMA_SxCR_CIRC |
+                       DMA_SxCR_HTIE | DMA_SxCR_TCIE;
+    NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+
+    (void)USART2->SR; // Discard anything left over from character mode
+    (void)USART2->DR;
+    DMA1_Stream5->CR |= DMA_SxCR_EN;
+    USART2->CR3 |= USART_CR3_DMAR;
+    USART2->CR1 |= USART_CR1_IDLEIE;
+}
+
+/**
+ * Returns reception to the character ring used by uart_rx_getc().
+ * Must not be called from the receive handler.
+ */
+void uart_rx_dma_stop(void) {
+    USART2->CR1 &= ~USART_CR1_IDLEIE;
+    USART2->CR3 &= ~USART_CR3_DMAR;
+    DMA1_Stream5->CR &= ~DMA_SxCR_EN;
+    while (DMA1_Stream5->CR & DMA_SxCR_EN);
+    rxDmaHandler = NULL;
+
+    rxTail = rxHead;
+    (void)USART2->SR;
+    (void)USART2->DR;
+    USART2->CR1 |= USART_CR1_RXNEIE;
+}
+
+/**
+ * DMA1 Stream5 interrupt: half of the circular receive buffer has filled.
+ */
+void DMA1_Stream5_IRQHandler(void) {
+    DMA1->HIFCR = DMA_HIFCR_CTCIF5 | DMA_HIFCR_CHTIF5 | DMA_HIFCR_CTEIF5;
+    rx_dma_service();
+}
+
+/**
+ * USART2 interrupt: moves each received character into the receive ring, or in DMA
+ * mode passes on what arrived before the line went idle.
+ */
+void USART2_IRQHandler(void) {
+    uint32_t status = USART2->SR;
+    uint32_t cr1 = USART2->CR1;
+
+    if ((status & USART_SR_IDLE) && (cr1 & USART_CR1_IDLEIE)) {
+        (void)USART2->DR; // SR then DR clears IDLE; DMA has already taken the data
+        rx_dma_service();
+        return;
+    }
+    // In DMA mode RXNE belongs to the DMA request, so leave DR alone
+    if ((cr1 & USART_CR1_RXNEIE) && (status & (USART_SR_RXNE | USART_SR_ORE))) {
+        uint8_t ch = USART2->DR; // Reading DR also clears ORE
+        uint8_t next = (rxHead + 1) & (UART_RX_BUF_SIZE - 1);
+        if (status & USART_SR_ORE) {
+            rxOverruns++;
+        }
+        if (next == rxTail) {
+            rxOverruns++;
+        } else {
+            rxBuf[rxHead] = ch;
+            rxHead = next;
+        }
+        sched_signal(SCHED_EVENT_CONSOLE);
+    }
+}
+
+/**
+ * Takes a received character without waiting.
+ *
+ * Returns:
+ * int - The character, or -1 if none is pending.
+ */
+int uart_rx_getc(void) {
+    int ch;
+
+    if (rxTail == rxHead) {
+        return -1;
+    }
+    ch = rxBuf[rxTail];
+    rxTail = (rxTail + 1) & (UART_RX_BUF_SIZE - 1);
+    return ch;
+}
+
+/**
+ * Returns the number of received characters lost to a full ring or a USART overrun.
+ */
+uint32_t uart_rx_overruns(void) {
+    return rxOverruns;
 }
 
 /**
  * Overrides the _write function to redirect printf() to UART2.
+ * The characters are copied into the transmit ring and sent by DMA; when the ring is
+ * full the active uart_tx_policy_t decides between dropping, truncating and waiting.
+ * Until USART2_Config() has set up the DMA nothing drains the ring, so BLOCK falls
+ * back to DROP instead of waiting forever.
  *
  * Parameters:
  * file - File descriptor.
@@ -72,13 +409,42 @@ char UART2_RxChar() {
  * len  - Number of characters to transmit.
  *
  * Returns:
- * int - The number of characters transmitted.
+ * int - The number of characters accepted (len, so stdio never retries).
  */
 int _write(int file, char *ptr, int len) {
-    int i;
-    for (i = 0; i < len; i++) {
-        while (!(USART2->SR & USART_SR_TXE));  // Wait until TX buffer is empty
-        USART2->DR = (ptr[i] & 0xFF);  // Send a character
+    uart_tx_policy_t policy = (txPolicy == UART_TX_BLOCK && !txReady) ? UART_TX_DROP : txPolicy;
+    int done = 0;
+
+    while (done < len) {
+        int space = UART_TX_BUF_SIZE - 1 - TX_USED();
+        int chunk = len - done;
+
+        if (chunk > space) {
+            if (policy == UART_TX_DROP && done == 0) {
+                txDropped += len;
+                break;
+            }
+            if (policy != UART_TX_BLOCK) {
+                txDropped += chunk - space;
+            }
+            chunk = space;
+        }
+
+        // Only this function moves txHead, so the copy needs no locking
+        for (int i = 0; i < chunk; i++) {
+            txBuf[txHead] = ptr[done + i];
+            txHead = (txHead + 1) & (UART_TX_BUF_SIZE - 1);
+        }
+        done += chunk;
+
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        tx_kick();
+        __set_PRIMASK(primask);
+
+        if (policy != UART_TX_BLOCK) {
+            break;
+        }
     }
     return len;
 }
@@ -15,16 +15,99 @@
 #ifndef SRC_UART_H_
 #define SRC_UART_H_
 
+#include "stdint.h"
+
+#define UART_BAUD        115200 // Console rate; anything up to PCLK1 / 8 (2 Mbaud at 16 MHz)
+#define UART_TX_BUF_SIZE 1024 // Transmit ring size in bytes, a power of two
+#define UART_RX_BUF_SIZE 64   // Receive ring size in bytes, a power of two
+#define UART_RX_DMA_SIZE 512  // Circular DMA receive buffer in bytes, a power of two
+
+/**
+ * What _write() does when the transmit ring cannot take the whole message.
+ */
+typedef enum {
+    UART_TX_DROP,     // Discard the whole message
+    UART_TX_TRUNCATE, // Queue what fits, discard the rest
+    UART_TX_BLOCK     // Wait for DMA to make room (the old blocking behaviour); DROP before USART2_Config()
+} uart_tx_policy_t;
+
+#define UART_TX_POLICY UART_TX_TRUNCATE // Policy at start-up
+
+/**
+ * Receives the bytes DMA has written; called from interrupt context.
+ *
+ * Parameters:
+ * data - The received bytes.
+ * len  - Their count.
+ */
+typedef void (*uart_rx_handler_t)(const uint8_t *data, uint16_t len);
+
 /**
  * Configures USART2 for UART communication.
  * This function sets up the necessary registers and configurations for UART communication
  * using USART2, including baud rate, mode, and enabling necessary peripherals.
+ *
+ * Parameters:
+ * baud - The baud rate, derived from the current APB1 clock.
  */
-void USART2_Config(void);
+void USART2_Config(uint32_t baud);
+
+/**
+ * Changes the baud rate, or re-derives it after an APB1 clock change.
+ * Pending output is sent at the old rate first.
+ *
+ * Parameters:
+ * baud - The new baud rate.
+ *
+ * Returns:
+ * uint32_t - The rate actually set, or 0 if it cannot be reached (the old rate is kept).
+ */
+uint32_t USART2_SetBaud(uint32_t baud);
+
+/**
+ * Re-derives BRR for the requested rate after the APB1 clock has changed.
+ */
+void USART2_ClockChanged(void);
+
+/**
+ * Returns the baud rate currently set.
+ */
+uint32_t USART2_GetBaud(void);
+
+/**
+ * Selects what happens when the transmit ring is full.
+ *
+ * Parameters:
+ * policy - UART_TX_DROP, UART_TX_TRUNCATE or UART_TX_BLOCK.
+ *
+ * Returns:
+ * uart_tx_policy_t - The previous policy.
+ */
+uart_tx_policy_t uart_tx_set_policy(uart_tx_policy_t policy);
+
+/**
+ * Waits until every queued byte has been sent.
+ */
+void uart_tx_flush(void);
+
+/**
+ * Returns 1 when every queued byte has been sent, including the last one on the wire.
+ */
+int uart_tx_idle(void);
+
+/**
+ * Returns the number of bytes discarded because the transmit ring was full.
+ */
+uint32_t uart_tx_dropped(void);
+
+/**
+ * Returns the number of bytes the transmit ring can take without dropping or waiting.
+ */
+uint32_t uart_tx_free(void);
 
 /**
  * Transmits a single character over UART2.
- * This function sends a character via USART2, waiting until the transmission buffer is empty.
+ * The character is queued behind any pending output, in order with printf().
  *
  * Parameters:
  * ch - The character to be transmitted.
@@ -40,10 +123,37 @@ void UART2_TxChar(char ch);
  */
 char UART2_RxChar();
 
+/**
+ * Takes a received character without waiting.
+ *
+ * Returns:
+ * int - The character, or -1 if none is pending.
+ */
+int uart_rx_getc(void);
+
+/**
+ * Returns the number of received characters lost to a full ring or a USART overrun.
+ */
+uint32_t uart_rx_overruns(void);
+
+/**
+ * Switches reception from the character ring to circular DMA with IDLE-line detection.
+ *
+ * Parameters:
+ * handler - Called from interrupt context with each run of received bytes.
+ */
+void uart_rx_dma_start(uart_rx_handler_t handler);
+
+/**
+ * Returns reception to the character ring used by uart_rx_getc().
+ * Must not be called from the receive handler.
+ */
+void uart_rx_dma_stop(void);
+
 /**
  * Overrides the standard _write function for redirecting printf() output to UART.
- * This function sends a string of characters via USART2, allowing printf() to output
- * to the UART terminal.
+ * This function queues a string of characters for DMA transmission via USART2, allowing
+ * printf() to output to the UART terminal without waiting for the line.
  *
  * Parameters:
  * file - File descriptor (not used).
@@ -0,0 +1,93 @@
+/*
+ * uart_brr.c
+ *
+ * Description: Baud rate divisor arithmetic for the STM32F4 USART.
+ * BRR holds USARTDIV in fixed point, so 16 * USARTDIV (OVER8 = 0) or 8 * USARTDIV
+ * (OVER8 = 1) is simply pclk / baud rounded.
+ */
+
+#include "uart_brr.h"
+
+/**
+ * Computes BRR for one oversampling mode.
+ *
+ * Parameters:
+ * pclk  - Clock of the USART's APB bus in Hz.
+ * baud  - Requested baud rate.
+ * over8 - 1 for 8x oversampling, 0 for 16x.
+ *
+ * Returns:
+ * uint16_t - The BRR value, or 0 if the rate is out of range for this mode.
+ */
+uint16_t uart_brr(uint32_t pclk, uint32_t baud, int over8) {
+    uint32_t div;
+
+    if (baud == 0) {
+        return 0;
+    }
+    // div = USARTDIV * oversampling, rounded to the nearest step
+    div = (pclk + baud / 2) / baud;
+    if (over8) {
+        // USARTDIV >= 1 and a 12-bit mantissa; the 3-bit fraction stays in BRR[2:0]
+        if (div < 8 || (div >> 3) > 0xFFF) {
+            return 0;
+        }
+        return (uint16_t)(((div >> 3) << 4) | (div & 0x07));
+    }
+    if (div < 16 || div > 0xFFFF) {
+        return 0;
+    }
+    return (uint16_t)div;
+}
+
+/**
+ * Returns the baud rate a BRR value produces.
+ *
+ * Parameters:
+ * pclk  - Clock of the USART's APB bus in Hz.
+ * brr   - The BRR value.
+ * over8 - 1 for 8x oversampling, 0 for 16x.
+ */
+uint32_t uart_brr_baud(uint32_t pclk, uint16_t brr, int over8) {
+    uint32_t div = over8 ? (((uint32_t)(brr >> 4) << 3) | (brr & 0x07)) : brr;
+
+    return div ? (pclk + div / 2) / div : 0;
+}
+
+/**
+ * Returns the deviation of actual from requested in parts per million.
+ */
+static uint32_t error_ppm(uint32_t actual, uint32_t baud) {
+    uint32_t diff = (actual > baud) ? actual - baud : baud - actual;
+
+    return (uint32_t)(((uint64_t)diff * 1000000U) / baud);
+}
+
+/**
+ * Picks the oversampling mode and BRR for a baud rate.
+ *
+ * Parameters:
+ * pclk  - Clock of the USART's APB bus in Hz.
+ * baud  - Requested baud rate.
+ * brr   - Receives the BRR value.
+ * over8 - Receives 1 for 8x oversampling, 0 for 16x.
+ *
+ * Returns:
+ * uint32_t - The baud rate actually produced, or 0 if the rate cannot be reached
+ * within UART_BRR_MAX_ERROR_PPM.
+ */
+uint32_t uart_brr_select(uint32_t pclk, uint32_t baud, uint16_t *brr, int *over8) {
+    for (int mode = 0; mode <= 1; mode++) {
+        uint16_t value = uart_brr(pclk, baud, mode);
+        if (value == 0) {
+            continue;
+        }
+        uint32_t actual = uart_brr_baud(pclk, value, mode);
+        if (error_ppm(actual, baud) <= UART_BRR_MAX_ERROR_PPM) {
+            *brr = value;
+            *over8 = mode;
+            return actual;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+/*
+ * uart_brr.h
+ *
+ * Description: Baud rate divisor arithmetic for the STM32F4 USART.
+ * Computes BRR for a peripheral clock and baud rate with 16x or 8x oversampling.
+ */
+
+#ifndef SRC_UART_BRR_H_
+#define SRC_UART_BRR_H_
+
+#include "stdint.h"
+
+#define UART_BRR_MAX_ERROR_PPM 20000 // Largest accepted baud error (2 %)
+
+/**
+ * Computes BRR for one oversampling mode.
+ * USARTDIV = pclk / (8 * (2 - over8) * baud), rounded to the nearest 1/16 (OVER8 = 0)
+ * or 1/8 (OVER8 = 1); with OVER8 the fraction occupies BRR[2:0] and BRR[3] stays 0.
+ *
+ * Parameters:
+ * pclk  - Clock of the USART's APB bus in Hz.
+ * baud  - Requested baud rate.
+ * over8 - 1 for 8x oversampling, 0 for 16x.
+ *
+ * Returns:
+ * uint16_t - The BRR value, or 0 if the rate is out of range for this mode.
+ */
+uint16_t uart_brr(uint32_t pclk, uint32_t baud, int over8);
+
+/**
+ * Returns the baud rate a BRR value produces.
+ *
+ * Parameters:
+ * pclk  - Clock of the USART's APB bus in Hz.
+ * brr   - The BRR value.
+ * over8 - 1 for 8x oversampling, 0 for 16x.
+ */
+uint32_t uart_brr_baud(uint32_t pclk, uint16_t brr, int over8);
+
+/**
+ * Picks the oversampling mode and BRR for a baud rate. 16x oversampling is preferred
+ * for its noise tolerance; 8x is used when 16x cannot reach the rate or misses it by
+ * more than UART_BRR_MAX_ERROR_PPM.
+ *
+ * Parameters:
+ * pclk  - Clock of the USART's APB bus in Hz.
+ * baud  - Requested baud rate.
+ * brr   - Receives the BRR value.
+ * over8 - Receives 1 for 8x oversampling, 0 for 16x.
+ *
+ * Returns:
+ * uint32_t - The baud rate actually produced, or 0 if the rate cannot be reached
+ * within UART_BRR_MAX_ERROR_PPM.
+ */
+uint32_t uart_brr_select(uint32_t pclk, uint32_t baud, uint16_t *brr, int *over8);
+
+#endif /* SRC_UART_BRR_H_ */
@@ -0,0 +1,148 @@
+/*
+ * color_classify_check.c
+ *
+ * Description: Host check for the firmware's colour classifier (color_classify.c).
+ * Classifies a table of RGBC card readings and reports every sample whose class differs
+ * from the expected one. Colour CSV files written by telemetry_csv can be checked too:
+ * every row of a file is expected to carry the colour named before it, so a capture of
+ * each card held still under the sensor becomes a regression set.
+ *
+ * Build:
+ *   cc -O2 -I../LED_CUBE/src color_classify_check.c ../LED_CUBE/src/color_classify.c \
+ *      -o color_classify_check
+ *
+ * Usage:
+ *   color_classify_check [<colour> <run_color.csv> ...]
+ *   colour is one of red, green, blue, yellow, cyan, magenta, white, orange, unknown.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "color_classify.h"
+
+typedef struct {
+    uint16_t r, g, b, c;
+    PredominantColor expected;
+} color_sample_t;
+
+// Typical card readings at the firmware's gain and integration time, a near and a far
+// one per colour, plus the edge cases; captures passed on the command line extend them
+static const color_sample_t samples[] = {
+    {1450, 260, 240, 1980, RED},
+    {610, 118, 104, 840, RED},
+    {1120, 190, 310, 1640, RED},     // Red with a blue tint still short of magenta
+    {1380, 560, 210, 2150, ORANGE},
+    {690, 380, 110, 1150, ORANGE},
+    {1290, 1150, 300, 2700, YELLOW},
+    {520, 470, 130, 1110, YELLOW},
+    {330, 980, 420, 1720, GREEN},
+    {150, 420, 170, 740, GREEN},
+    {300, 900, 700, 1900, CYAN},
+    {160, 520, 540, 1210, CYAN},
+    {240, 420, 1180, 1820, BLUE},
+    {110, 190, 520, 820, BLUE},
+    {1020, 260, 950, 2210, MAGENTA},
+    {430, 120, 400, 950, MAGENTA},
+    {1500, 1460, 1390, 4300, WHITE}, // Paper
+    {420, 410, 380, 1200, WHITE},
+    {20, 12, 10, 30, UNKNOWN},       // No card, below COLOR_CLEAR_MIN
+    {0, 0, 0, 0, UNKNOWN},
+};
+
+/**
+ * Returns the colour with the given name, or -1.
+ */
+static int color_by_name(const char *name) {
+    for (int i = 0; i <= UNKNOWN; i++) {
+        if (strcmp(color_name((PredominantColor)i), name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Classifies one reading and reports a mismatch.
+ *
+ * Returns:
+ * int - 1 if the class differs from the expected one.
+ */
+static int check(const char *where, uint16_t r, uint16_t g, uint16_t b, uint16_t c, PredominantColor expected) {
+    color_hsv_t hsv;
+    PredominantColor got = classify_color(r, g, b, c, &hsv);
+
+    if (got == expected) {
+        return 0;
+    }
+    printf("FAIL %s: %u,%u,%u,%u (hue %u, sat %u) is %s, expected %s\n", where, r, g, b, c,
+           hsv.hue, hsv.saturation, color_name(got), color_name(expected));
+    return 1;
+}
+
+/**
+ * Checks every row of a colour CSV from telemetry_csv against one expected colour.
+ *
+ * Returns:
+ * int - Number of mismatches, or -1 if the file cannot be read.
+ */
+static int check_csv(const char *path, PredominantColor expected, int *rows) {
+    FILE *f = fopen(path, "r");
+    char line[256], where[300];
+    int failures = 0, n = 0;
+
+    if (f == NULL) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        unsigned seq, r, g, b, c;
+        unsigned long ms;
+
+        // seq,ms,r,g,b,c,...; the header and malformed lines are skipped
+        if (sscanf(line, "%u,%lu,%u,%u,%u,%u", &seq, &ms, &r, &g, &b, &c) != 6) {
+            continue;
+        }
+        n++;
+        snprintf(where, sizeof(where), "%s seq %u", path, seq);
+        failures += check(where, r, g, b, c, expected);
+    }
+    fclose(f);
+    *rows = n;
+    return failures;
+}
+
+int main(int argc, char **argv) {
+    int failures = 0, total = 0;
+    char where[32];
+
+    for (unsigned i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+        const color_sample_t *s = &samples[i];
+        snprintf(where, sizeof(where), "sample %u", i);
+        failures += check(where, s->r, s->g, s->b, s->c, s->expected);
+        total++;
+    }
+
+    if (argc % 2 == 0) {
+        fprintf(stderr, "usage: color_classify_check [<colour> <run_color.csv> ...]\n");
+        return 2;
+    }
+    for (int i = 1; i + 1 < argc; i += 2) {
+        int expected = color_by_name(argv[i]), rows = 0;
+        if (expected < 0) {
+            fprintf(stderr, "unknown colour '%s'\n", argv[i]);
+            return 2;
+        }
+        int n = check_csv(argv[i + 1], (PredominantColor)expected, &rows);
+        if (n < 0) {
+            fprintf(stderr, "cannot read %s\n", argv[i + 1]);
+            return 2;
+        }
+        printf("%s: %d of %d rows %s\n", argv[i + 1], rows - n, rows, argv[i]);
+        failures += n;
+        total += rows;
+    }
+
+    printf("%d of %d samples classified as expected\n", total - failures, total);
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,219 @@
+/*
+ * color_mux_bench.c
+ *
+ * Description: Host tool that runs the firmware's color_mux driver against a simulated
+ * TCA9548A bus. It checks channel selection and the per-sensor readings, and reports
+ * the cost of one sweep as bus bytes, the bus time this implies and host CPU time.
+ * The main colour sensor is simulated too, since it shares the sensor address.
+ *
+ * Build:
+ *   cc -O2 -I../LED_CUBE/src color_mux_bench.c ../LED_CUBE/src/color_mux.c \
+ *      ../LED_CUBE/src/color_classify.c -o color_mux_bench
+ *
+ * Usage:
+ *   color_mux_bench [-u] [channelMask]
+ *   channelMask selects the mux channels that carry an extra simulated sensor (default
+ *   0x0E). The main sensor sits on COLOR_MUX_PRIMARY; -u puts it upstream of the mux
+ *   instead, a wiring in which it answers alongside every channel, so the checks fail.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "color_mux.h"
+#include "color_classify.h"
+#include "i2c.h"
+
+#define BENCH_SWEEPS 100000
+
+#define UPSTREAM COLOR_MUX_CHANNELS // Register file of a main sensor wired upstream of the mux
+
+// Simulated bus: the mux control byte and one register file per channel, plus one for
+// a main sensor upstream of the mux
+struct i2c_bus {
+    int unused;
+};
+i2c_bus_t i2c_bus1, i2c_bus3;
+static uint8_t muxControl;
+static uint8_t presentMask;   // Channels with a sensor, the main one included
+static int upstream;          // 1: the main sensor is always connected
+static uint8_t regs[COLOR_MUX_CHANNELS + 1][32];
+static long busBytes;     // Bytes on the wire, address bytes included
+static long transactions; // START conditions
+static int conflicts;     // Sensor accesses with no or several sensors connected
+
+/**
+ * Returns how many sensors the sensor address currently reaches; dev receives the
+ * register file of the last one.
+ */
+static int reachable(int *dev) {
+    int n = 0;
+
+    if (upstream) {
+        *dev = UPSTREAM;
+        n++;
+    }
+    for (int i = 0; i < COLOR_MUX_CHANNELS; i++) {
+        if ((muxControl & presentMask) & (1 << i)) {
+            *dev = i;
+            n++;
+        }
+    }
+    return n;
+}
+
+/**
+ * Returns the register file the sensor address reaches, or -1 when it reaches none or
+ * several, whose answers would collide on the bus.
+ */
+static int addressed_device(uint8_t addr) {
+    int dev = -1;
+
+    if (addr != TCS34725_ADDRESS) {
+        return -1;
+    }
+    if (reachable(&dev) != 1) {
+        conflicts++;
+        return -1;
+    }
+    return dev;
+}
+
+int i2c_write_byte(i2c_bus_t *bus, uint8_t deviceAddr, uint8_t data) {
+    int dev;
+
+    (void)bus;
+    transactions++;
+    busBytes += 2;
+    if (deviceAddr == COLOR_MUX_ADDRESS) {
+        muxControl = data;
+        return 1;
+    }
+    if (deviceAddr != TCS34725_ADDRESS) {
+        return 0;
+    }
+    // Used as a probe: any connected sensor acknowledges, so several hide an empty channel
+    int n = reachable(&dev);
+    if (n > 1) {
+        conflicts++;
+    }
+    return n > 0;
+}
+
+int write_i2c(i2c_bus_t *bus, uint8_t deviceAddr, uint8_t reg, uint8_t data) {
+    int dev = addressed_device(deviceAddr);
+
+    (void)bus;
+    transactions++;
+    busBytes += 3;
+    if (dev >= 0) {
+        regs[dev][reg & 0x1F] = data;
+    }
+    return 1;
+}
+
+uint8_t read_i2c(i2c_bus_t *bus, uint8_t deviceAddr, uint8_t reg) {
+    int dev = addressed_device(deviceAddr);
+
+    (void)bus;
+    transactions += 2;
+    busBytes += 4;
+    return (dev >= 0) ? regs[dev][reg & 0x1F] : 0xFF;
+}
+
+int read_i2c_burst(i2c_bus_t *bus, uint8_t deviceAddr, uint8_t reg, uint8_t *buf, uint8_t len) {
+    int dev = addressed_device(deviceAddr);
+
+    (void)bus;
+    transactions += 2;
+    busBytes += 3 + len;
+    for (uint8_t i = 0; i < len; i++) {
+        buf[i] = (dev >= 0) ? regs[dev][(reg + i) & 0x1F] : 0xFF;
+    }
+    return 1;
+}
+
+static void set_counts(int ch, uint16_t r, uint16_t g, uint16_t b, uint16_t c) {
+    uint16_t v[4] = {c, r, g, b};
+    for (int i = 0; i < 4; i++) {
+        regs[ch][TCS34725_CDATAL + 2 * i] = v[i] & 0xFF;
+        regs[ch][TCS34725_CDATAL + 2 * i + 1] = v[i] >> 8;
+    }
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+    static const uint16_t samples[4][4] = {
+        {900, 150, 120, 1200}, {140, 800, 160, 1100}, {120, 180, 850, 1150}, {600, 600, 580, 1800}
+    };
+    int failures = 0;
+    int arg = 1;
+
+    if (argc > arg && strcmp(argv[arg], "-u") == 0) {
+        upstream = 1;
+        arg++;
+    }
+    presentMask = (argc > arg) ? (uint8_t)strtoul(argv[arg], 0, 0) : 0x0E;
+    presentMask &= ~(1 << COLOR_MUX_PRIMARY);
+    int expected = __builtin_popcount(presentMask);
+    int mainDev = upstream ? UPSTREAM : COLOR_MUX_PRIMARY;
+    if (!upstream) {
+        presentMask |= 1 << COLOR_MUX_PRIMARY;
+    }
+    for (int ch = 0; ch <= COLOR_MUX_CHANNELS; ch++) {
+        regs[ch][TCS34725_ID] = TCS34725_ID_VALUE;
+        set_counts(ch, samples[ch % 4][0], samples[ch % 4][1], samples[ch % 4][2], samples[ch % 4][3]);
+    }
+
+    // Functional checks
+    int found = color_mux_init(0xFF);
+    if (found != expected) {
+        printf("FAIL: found %d sensors, expected %d\n", found, expected);
+        failures++;
+    }
+    color_mux_sweep(1);
+    const color_mux_reading_t *rd = color_mux_readings();
+    for (int i = 0; i < found; i++) {
+        int ch = color_mux_channel(i);
+        if (rd[i].r != samples[ch % 4][0] || rd[i].c != samples[ch % 4][3] || rd[i].timestamp != 1) {
+            printf("FAIL: sensor %d (channel %d) read %u,%u,%u,%u\n", i, ch, rd[i].r, rd[i].g, rd[i].b, rd[i].c);
+            failures++;
+        }
+        printf("sensor %d on channel %d: %s\n", i, ch, color_name(rd[i].color));
+    }
+    int dev = -1;
+    if (reachable(&dev) != 1 || dev != mainDev) {
+        printf("FAIL: main sensor not the only one connected after sweep (mux 0x%02X)\n", muxControl);
+        failures++;
+    }
+    if (conflicts) {
+        printf("FAIL: %d accesses with no or several sensors connected\n", conflicts);
+        failures++;
+    }
+
+    // Cost of one sweep
+    busBytes = 0;
+    transactions = 0;
+    color_mux_sweep(2);
+    long bytes = busBytes, starts = transactions;
+    // 9 clocks per byte plus roughly 2 clocks for each START/STOP
+    double bits = bytes * 9.0 + starts * 2.0;
+
+    double t0 = now_ns();
+    for (int i = 0; i < BENCH_SWEEPS; i++) {
+        color_mux_sweep(3 + i);
+    }
+    double host = (now_ns() - t0) / BENCH_SWEEPS;
+
+    printf("sweep of %d sensors: %ld bytes, %ld transactions\n", found, bytes, starts);
+    printf("bus time: %.0f us at 100 kHz, %.0f us at 400 kHz\n", bits * 10.0, bits * 2.5);
+    printf("driver cost: %.1f ns per sweep on this host (bus excluded)\n", host);
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * cube_stream.c
+ *
+ * Description: Host sender for the cube's binary streaming mode (stream.c).
+ * Renders a sweeping plane animation, packs each frame into the framebuffer layout and
+ * sends it COBS framed with the STM32 hardware CRC computed in software. With -d, each
+ * frame goes out as whichever of a raw frame, a frame_codec delta or a frame_codec key
+ * frame is smallest. Start the receiver with the
+ * console command "stream [baud]" first; an exit packet is sent at the end.
+ *
+ * Build:
+ *   cc -O2 -I../LED_CUBE/src cube_stream.c ../LED_CUBE/src/cobs.c ../LED_CUBE/src/frame_codec.c \
+ *      -o cube_stream
+ *
+ * Usage:
+ *   cube_stream [-d] <device|-> [baud] [fps] [seconds]
+ *   Defaults: 1000000 baud, 60 fps, 10 s. "-" writes the byte stream to stdout.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "cobs.h"
+#include "frame_codec.h"
+
+#define CUBE 8
+#define FRAME_BYTES (3 * CUBE * CUBE)
+#define HEADER_BYTES 4
+#define PAYLOAD_MAX FRAME_CODEC_MAX_ENCODED
+
+enum { TYPE_FULL = 0x01, TYPE_DELTA = 0x02, TYPE_EXIT = 0x03, TYPE_KEY = 0x04 };
+
+static const struct {
+    unsigned long baud;
+    speed_t speed;
+} speeds[] = {
+    {115200, B115200}, {230400, B230400}, {460800, B460800}, {921600, B921600},
+    {1000000, B1000000}, {2000000, B2000000},
+};
+
+/**
+ * CRC-32 as computed by the STM32 CRC unit: polynomial 0x04C11DB7, initial value
+ * 0xFFFFFFFF, MSB first, fed little-endian words; the tail is zero-padded.
+ */
+static unsigned long crc32_stm32(const unsigned char *data, size_t len) {
+    unsigned long crc = 0xFFFFFFFFUL;
+
+    for (size_t i = 0; i < len; i += 4) {
+        unsigned long word = 0;
+        for (size_t b = 0; b < 4 && i + b < len; b++) {
+            word |= (unsigned long)data[i + b] << (8 * b);
+        }
+        crc ^= word;
+        for (int bit = 0; bit < 32; bit++) {
+            crc = (crc & 0x80000000UL) ? ((crc << 1) ^ 0x04C11DB7UL) : (crc << 1);
+            crc &= 0xFFFFFFFFUL;
+        }
+    }
+    return crc;
+}
+
+static int open_port(const char *path, unsigned long baud) {
+    struct termios tio;
+    int fd;
+    size_t i;
+
+    if (strcmp(path, "-") == 0) {
+        return STDOUT_FILENO;
+    }
+    for (i = 0; i < sizeof(speeds) / sizeof(speeds[0]) && speeds[i].baud != baud; i++);
+    if (i == sizeof(speeds) / sizeof(speeds[0])) {
+        fprintf(stderr, "unsupported baud %lu\n", baud);
+        return -1;
+    }
+    fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0 || tcgetattr(fd, &tio) != 0) {
+        perror(path);
+        return -1;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, speeds[i].speed);
+    cfsetospeed(&tio, speeds[i].speed);
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        perror(path);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Frames and writes one packet.
+ *
+ * Returns:
+ * Bytes written on the wire, delimiter included.
+ */
+static size_t send_packet(int fd, int type, unsigned seq, const unsigned char *payload, size_t len) {
+    unsigned char pkt[HEADER_BYTES + PAYLOAD_MAX + 4];
+    unsigned char wire[COBS_MAX_ENCODED(sizeof(pkt)) + 1];
+    unsigned long crc;
+    size_t n;
+
+    pkt[0] = (unsigned char)type;
+    pkt[1] = (unsigned char)seq;
+    pkt[2] = len & 0xFF;
+    pkt[3] = len >> 8;
+    if (len != 0) {
+        memcpy(&pkt[HEADER_BYTES], payload, len);
+    }
+    crc = crc32_stm32(pkt, HEADER_BYTES + len);
+    for (int b = 0; b < 4; b++) {
+        pkt[HEADER_BYTES + len + b] = (crc >> (8 * b)) & 0xFF;
+    }
+    n = cobs_encode(pkt, HEADER_BYTES + len + 4, wire);
+    wire[n++] = COBS_DELIMITER;
+    if (write(fd, wire, n) != (ssize_t)n) {
+        perror("write");
+        exit(1);
+    }
+    return n;
+}
+
+/**
+ * Renders animation step t: a plane sweeping back and forth through the layers,
+ * cycling through the colours and tilting every other pass.
+ */
+static void render(unsigned t, unsigned char frame[3][CUBE][CUBE]) {
+    unsigned pass = t / (2 * CUBE - 2);
+    unsigned pos = t % (2 * CUBE - 2);
+    unsigned layer = (pos < CUBE) ? pos : 2 * CUBE - 2 - pos;
+    unsigned mask = 1 + pass % 7; // Red, green, yellow, blue, magenta, cyan, white
+
+    memset(frame, 0, FRAME_BYTES);
+    for (int ch = 0; ch < 3; ch++) {
+        if (!(mask & (1U << ch))) {
+            continue;
+        }
+        for (int row = 0; row < CUBE; row++) {
+            if (pass & 1) {
+                frame[ch][(layer + row / 4) % CUBE][row] = 0xFF;
+            } else {
+                frame[ch][layer][row] = 0xFF;
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    unsigned char frame[3][CUBE][CUBE], shown[FRAME_BYTES], delta[PAYLOAD_MAX], key[PAYLOAD_MAX];
+    unsigned long baud = 1000000, bytes = 0;
+    int useDelta = 0, fps = 60, seconds = 10, fd;
+    unsigned seq = 0, coded = 0;
+
+    if (argc > 1 && strcmp(argv[1], "-d") == 0) {
+        useDelta = 1;
+        argv++;
+        argc--;
+    }
+    if (argc < 2) {
+        fprintf(stderr, "usage: cube_stream [-d] <device|-> [baud] [fps] [seconds]\n");
+        return 2;
+    }
+    if (argc > 2) baud = strtoul(argv[2], NULL, 10);
+    if (argc > 3) fps = atoi(argv[3]);
+    if (argc > 4) seconds = atoi(argv[4]);
+    if (fps < 1 || (fd = open_port(argv[1], baud)) < 0) {
+        return 1;
+    }
+
+    for (unsigned t = 0; t < (unsigned)(fps * seconds); t++) {
+        struct timespec period = {0, 1000000000L / fps};
+        size_t deltaLen = FRAME_BYTES, keyLen = FRAME_BYTES;
+
+        render(t / ((fps + 9) / 10), frame); // About ten animation steps per second
+        if (useDelta) {
+            keyLen = frame_encode(&frame[0][0][0], NULL, key);
+            if (t != 0) {
+                deltaLen = frame_encode(&frame[0][0][0], shown, delta);
+            }
+        }
+        if (deltaLen < FRAME_BYTES && deltaLen <= keyLen) {
+            bytes += send_packet(fd, TYPE_DELTA, seq++, delta, deltaLen);
+            coded++;
+        } else if (keyLen < FRAME_BYTES) {
+            bytes += send_packet(fd, TYPE_KEY, seq++, key, keyLen);
+            coded++;
+        } else {
+            bytes += send_packet(fd, TYPE_FULL, seq++, &frame[0][0][0], FRAME_BYTES);
+        }
+        memcpy(shown, frame, FRAME_BYTES);
+        if (fd != STDOUT_FILENO) {
+            nanosleep(&period, NULL);
+        }
+    }
+    bytes += send_packet(fd, TYPE_EXIT, seq, NULL, 0);
+    fprintf(stderr, "%u frames (%u coded), %lu bytes, %.1f bytes/frame, %.0f fps possible at %lu baud\n",
+            seq, coded, bytes, (double)bytes / (seq + 1), baud / 10.0 / ((double)bytes / (seq + 1)), baud);
+    return 0;
+}
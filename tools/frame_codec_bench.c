@@ -0,0 +1,207 @@
+/*
+ * frame_codec_bench.c
+ *
+ * Description: Host benchmark of the firmware's frame codec (frame_codec.c) over the
+ * built-in patterns of led.c, the cube_stream sweep and random frames as a worst case.
+ * Each sequence is encoded as deltas against the previous frame and as key frames; the
+ * table shows the compression ratio against raw 192-byte frames and the decode time.
+ * Every decode is checked against the original frame. On the cube the longest delta
+ * decode is reported in cycles when streaming ends.
+ *
+ * Build:
+ *   cc -O2 -I../LED_CUBE/src frame_codec_bench.c ../LED_CUBE/src/frame_codec.c -o frame_codec_bench
+ *
+ * Usage:
+ *   frame_codec_bench
+ *   Exits non-zero if a frame does not survive the round trip.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "frame_codec.h"
+
+#define CUBE 8
+#define MAX_FRAMES 1024
+#define DECODE_REPEATS 2000
+
+typedef uint8_t frame_t[3][CUBE][CUBE];
+
+static frame_t seq[MAX_FRAMES];
+
+/**
+ * Lights or clears a column of rows in one layer on the components in mask,
+ * as setLED()/clearLED() do.
+ */
+static void draw(frame_t f, int layer, int row, int col, int mask, int on) {
+    for (int ch = 0; ch < 3; ch++) {
+        if (on && (mask & (1 << ch))) {
+            f[ch][layer][row] |= 1U << col;
+        } else {
+            f[ch][layer][row] &= ~(1U << col);
+        }
+    }
+}
+
+/**
+ * Appends the working frame to the sequence, as each Delay_ms() of a pattern shows it.
+ */
+static void emit(int *n, frame_t f) {
+    if (*n < MAX_FRAMES) {
+        memcpy(seq[(*n)++], f, sizeof(frame_t));
+    }
+}
+
+/**
+ * displayUpPattern() and displayDownPattern(): whole layers on, then off.
+ */
+static int gen_layers(int mask, int down) {
+    frame_t f = {{{0}}};
+    int n = 0;
+
+    for (int i = 0; i < CUBE; i++) {
+        int layer = down ? CUBE - 1 - i : i;
+        for (int on = 1; on >= 0; on--) {
+            for (int row = 0; row < CUBE; row++) {
+                for (int col = 0; col < CUBE; col++) {
+                    draw(f, layer, row, col, mask, on);
+                }
+            }
+            emit(&n, f);
+        }
+    }
+    return n;
+}
+
+/**
+ * displayRightPattern() and displayLeftPattern(): a vertical line per column, on then off.
+ */
+static int gen_columns(int mask, int left) {
+    frame_t f = {{{0}}};
+    int n = 0;
+
+    for (int layer = 0; layer < CUBE; layer++) {
+        for (int i = 0; i < CUBE; i++) {
+            int col = left ? CUBE - 1 - i : i;
+            for (int on = 1; on >= 0; on--) {
+                for (int row = 0; row < CUBE; row++) {
+                    draw(f, layer, row, col, mask, on);
+                }
+                emit(&n, f);
+            }
+        }
+    }
+    return n;
+}
+
+/**
+ * The cube_stream animation: a plane sweeping through the layers, tilting every other pass.
+ */
+static int gen_sweep(int mask) {
+    int n = 0;
+
+    for (int t = 0; t < 7 * (2 * CUBE - 2); t++) {
+        int pass = t / (2 * CUBE - 2), pos = t % (2 * CUBE - 2);
+        int layer = (pos < CUBE) ? pos : 2 * CUBE - 2 - pos;
+        frame_t f = {{{0}}};
+        for (int row = 0; row < CUBE; row++) {
+            for (int col = 0; col < CUBE; col++) {
+                draw(f, (pass & 1) ? (layer + row / 4) % CUBE : layer, row, col, 1 + (mask + pass) % 7, 1);
+            }
+        }
+        emit(&n, f);
+    }
+    return n;
+}
+
+/**
+ * Random frames: nothing to exploit, the codec's worst case.
+ */
+static int gen_random(int mask) {
+    srand(mask);
+    for (int n = 0; n < 64; n++) {
+        uint8_t *raw = &seq[n][0][0][0];
+        for (size_t i = 0; i < sizeof(frame_t); i++) {
+            raw[i] = (uint8_t)rand();
+        }
+    }
+    return 64;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * Encodes a sequence as deltas and as key frames, verifies and times the decodes.
+ *
+ * Returns:
+ * 0 on success, 1 if a frame did not round-trip.
+ */
+static int bench(const char *name, int n) {
+    static uint8_t enc[MAX_FRAMES][FRAME_CODEC_MAX_ENCODED];
+    static uint16_t len[MAX_FRAMES];
+    uint8_t out[FRAME_CODEC_FRAME_BYTES], key[FRAME_CODEC_MAX_ENCODED];
+    unsigned long raw = (unsigned long)n * FRAME_CODEC_FRAME_BYTES, deltaBytes = 0, keyBytes = 0;
+    double worst = 0, total = 0;
+
+    for (int i = 0; i < n; i++) {
+        const uint8_t *ref = i ? &seq[i - 1][0][0][0] : NULL;
+        uint16_t k;
+
+        len[i] = frame_encode(&seq[i][0][0][0], ref, enc[i]);
+        k = frame_encode(&seq[i][0][0][0], NULL, key);
+        deltaBytes += len[i];
+        keyBytes += k;
+        if (!frame_decode(enc[i], len[i], ref, out) || memcmp(out, seq[i], sizeof(out)) != 0 ||
+            !frame_decode(key, k, NULL, out) || memcmp(out, seq[i], sizeof(out)) != 0) {
+            printf("%s: frame %d does not round-trip\n", name, i);
+            return 1;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        const uint8_t *ref = i ? &seq[i - 1][0][0][0] : NULL;
+        double start = now_ns(), ns;
+
+        for (int r = 0; r < DECODE_REPEATS; r++) {
+            frame_decode(enc[i], len[i], ref, out);
+            __asm__ volatile("" ::: "memory");
+        }
+        ns = (now_ns() - start) / DECODE_REPEATS;
+        total += ns;
+        worst = (ns > worst) ? ns : worst;
+    }
+    printf("%-14s %6d %8lu %8lu %6.1fx %8lu %6.1fx %8.1f %8.1f\n", name, n, raw, deltaBytes,
+           (double)raw / (deltaBytes ? deltaBytes : 1), keyBytes, (double)raw / (keyBytes ? keyBytes : 1),
+           total / n, worst);
+    return 0;
+}
+
+int main(void) {
+    static const struct {
+        const char *name;
+        int (*gen)(int mask, int reverse);
+        int mask;
+        int reverse;
+    } cases[] = {
+        {"up red", gen_layers, 1, 0},    {"up white", gen_layers, 7, 0},
+        {"down blue", gen_layers, 4, 1}, {"right red", gen_columns, 1, 0},
+        {"right white", gen_columns, 7, 0}, {"left cyan", gen_columns, 6, 1},
+    };
+    int failed = 0;
+
+    printf("%-14s %6s %8s %8s %7s %8s %7s %8s %8s\n", "sequence", "frames", "raw", "delta", "ratio",
+           "key", "ratio", "dec ns", "max ns");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        failed |= bench(cases[i].name, cases[i].gen(cases[i].mask, cases[i].reverse));
+    }
+    failed |= bench("sweep", gen_sweep(0));
+    failed |= bench("random", gen_random(1));
+    printf("worst-case encoded frame %d bytes; decode writes each of the %d bytes once\n",
+           FRAME_CODEC_MAX_ENCODED, FRAME_CODEC_FRAME_BYTES);
+    printf(failed ? "FAILED\n" : "OK\n");
+    return failed;
+}
@@ -0,0 +1,276 @@
+/*
+ * gesture_replay.c
+ *
+ * Description: Host tool that replays gesture traces downloaded with gesture_trace_download()
+ * through the firmware's classify_gesture() and reports accuracy, decision latency and cost.
+ * The extended recognizer (template matching, then classify_gesture() for the four
+ * swipes, as detect_gesture_ext() does) is replayed too, with its own accuracy and cost.
+ * With -t the traces are instead averaged per label into a template table to paste into
+ * gesture_template.c.
+ *
+ * Build:
+ *   cc -O2 -I../LED_CUBE/src gesture_replay.c ../LED_CUBE/src/gesture_classify.c \
+ *      ../LED_CUBE/src/gesture_template.c -o gesture_replay
+ *
+ * Usage:
+ *   gesture_replay [-t] <label> <trace.csv> [<label> <trace.csv> ...]
+ *   trace.csv is the <prefix>_trace.csv that telemetry_csv writes from a download.
+ *   label names the gesture performed in that trace: none, up, down, left, right,
+ *   circle_cw, circle_ccw, double_left, double_right or push_pull.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "gesture_classify.h"
+#include "gesture_template.h"
+
+#define MAX_BURSTS 1024
+#define BENCH_REPEATS 2000
+
+typedef struct {
+    gesture_sample_t samples[GESTURE_FIFO_DEPTH];
+    int count;
+} burst_t;
+
+static char labelNames[GESTURE_EXT_COUNT][16];
+
+/**
+ * Builds the command line labels from the firmware's names: "CIRCLE CW" is circle_cw.
+ */
+static void init_labels(void) {
+    for (int g = 0; g < GESTURE_EXT_COUNT; g++) {
+        const char *name = gesture_ext_name((gesture_ext_t)g);
+        int i;
+        for (i = 0; name[i] != 0 && i < (int)sizeof(labelNames[g]) - 1; i++) {
+            labelNames[g][i] = (name[i] == ' ') ? '_' : (char)tolower((unsigned char)name[i]);
+        }
+        labelNames[g][i] = 0;
+    }
+}
+
+static int parse_label(const char *s) {
+    for (int i = 0; i < GESTURE_EXT_COUNT; i++) {
+        if (strcmp(s, labelNames[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * The extended decision, as detect_gesture_ext() makes it on the target.
+ */
+static gesture_ext_t classify_ext(const burst_t *b) {
+    gesture_ext_t ext = match_gesture_template(b->samples, b->count, 0);
+
+    if (ext <= GESTURE_EXT_RIGHT) {
+        ext = (gesture_ext_t)classify_gesture(b->samples, b->count);
+    }
+    return ext;
+}
+
+/**
+ * Prints a confusion matrix over the first n gestures.
+ */
+static void print_confusion(const char *title, int confusion[GESTURE_EXT_COUNT][GESTURE_EXT_COUNT], int n) {
+    printf("\n%s (rows = performed, columns = detected)\n%13s", title, "");
+    for (int g = 0; g < n; g++) {
+        printf("%13s", labelNames[g]);
+    }
+    printf("\n");
+    for (int l = 0; l < n; l++) {
+        printf("%13s", labelNames[l]);
+        for (int g = 0; g < n; g++) {
+            printf("%13d", confusion[l][g]);
+        }
+        printf("\n");
+    }
+}
+
+/**
+ * Prints the mean feature tracks of each label as a gesture_template.c table.
+ */
+static void print_templates(int64_t sums[GESTURE_EXT_COUNT][GESTURE_TEMPLATE_FEATURES][GESTURE_TEMPLATE_LEN],
+                            const long *counts) {
+    printf("// Built by gesture_replay -t from recorded traces\n");
+    printf("static gesture_template_t templates[] = {\n");
+    for (int g = GESTURE_EXT_UP; g < GESTURE_EXT_COUNT; g++) {
+        if (counts[g] == 0) {
+            continue;
+        }
+        printf("    { GESTURE_EXT_");
+        for (const char *c = labelNames[g]; *c; c++) {
+            putchar(toupper((unsigned char)*c));
+        }
+        printf(", {  // %ld traces\n", counts[g]);
+        for (int f = 0; f < GESTURE_TEMPLATE_FEATURES; f++) {
+            printf("        {");
+            for (int p = 0; p < GESTURE_TEMPLATE_LEN; p++) {
+                printf("%s%d", p ? ", " : "", (int)(sums[g][f][p] / counts[g]));
+            }
+            printf("},\n");
+        }
+        printf("    } },\n");
+    }
+    printf("};\n");
+}
+
+/**
+ * Loads a trace file, grouping datasets by burst index.
+ *
+ * Returns:
+ * Number of bursts loaded, or -1 if the file cannot be opened.
+ */
+static int load_trace(const char *path, burst_t *bursts, int max) {
+    FILE *f = fopen(path, "r");
+    char line[128];
+    int n = 0;
+    long lastBurst = -1;
+
+    if (f == NULL) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        unsigned burst, u, d, l, r;
+        unsigned long ts;
+        if (line[0] == '#' || sscanf(line, "%u,%lu,%u,%u,%u,%u", &burst, &ts, &u, &d, &l, &r) != 6) {
+            continue;
+        }
+        if ((long)burst != lastBurst) {
+            if (n == max) {
+                break;
+            }
+            lastBurst = burst;
+            bursts[n++].count = 0;
+        }
+        burst_t *b = &bursts[n - 1];
+        if (b->count < GESTURE_FIFO_DEPTH) {
+            b->samples[b->count].u = u;
+            b->samples[b->count].d = d;
+            b->samples[b->count].l = l;
+            b->samples[b->count].r = r;
+            b->count++;
+        }
+    }
+    fclose(f);
+    return n;
+}
+
+/**
+ * Number of datasets after which the decision equals the final one and stays there.
+ */
+static int decision_latency(const burst_t *b, gesture_t final) {
+    int latency = b->count;
+    for (int k = b->count; k >= 1; k--) {
+        if (classify_gesture(b->samples, k) != final) {
+            break;
+        }
+        latency = k;
+    }
+    return latency;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+    static burst_t bursts[MAX_BURSTS];
+    static int64_t sums[GESTURE_EXT_COUNT][GESTURE_TEMPLATE_FEATURES][GESTURE_TEMPLATE_LEN];
+    long counts[GESTURE_EXT_COUNT] = {0};
+    int confusion[GESTURE_EXT_COUNT][GESTURE_EXT_COUNT] = {{0}};
+    int confusionExt[GESTURE_EXT_COUNT][GESTURE_EXT_COUNT] = {{0}};
+    long total = 0, correct = 0, latencySum = 0, datasets = 0;
+    long totalExt = 0, correctExt = 0;
+    double elapsed = 0, elapsedExt = 0;
+    long decisions = 0;
+    volatile gesture_t sink;
+    int first = 1, build = 0;
+
+    init_labels();
+    if (argc > 1 && strcmp(argv[1], "-t") == 0) {
+        build = 1;
+        first = 2;
+    }
+    if (argc - first < 2 || (argc - first) % 2 != 0) {
+        fprintf(stderr, "usage: %s [-t] <label> <trace.csv> [<label> <trace.csv> ...]\n", argv[0]);
+        return 2;
+    }
+
+    for (int a = first; a < argc; a += 2) {
+        int label = parse_label(argv[a]);
+        int n = load_trace(argv[a + 1], bursts, MAX_BURSTS);
+        if (label < 0 || n < 0) {
+            fprintf(stderr, "cannot use %s %s\n", argv[a], argv[a + 1]);
+            return 2;
+        }
+        for (int i = 0; i < n; i++) {
+            if (build) {
+                int16_t track[GESTURE_TEMPLATE_FEATURES][GESTURE_TEMPLATE_LEN];
+                if (bursts[i].count < GESTURE_TEMPLATE_MIN_LEN) {
+                    continue;
+                }
+                gesture_template_features(bursts[i].samples, bursts[i].count, track);
+                for (int f = 0; f < GESTURE_TEMPLATE_FEATURES; f++) {
+                    for (int p = 0; p < GESTURE_TEMPLATE_LEN; p++) {
+                        sums[label][f][p] += track[f][p];
+                    }
+                }
+                counts[label]++;
+                continue;
+            }
+
+            gesture_ext_t ext = classify_ext(&bursts[i]);
+            confusionExt[label][ext]++;
+            totalExt++;
+            correctExt += ((int)ext == label);
+
+            if (label <= GESTURE_EXT_RIGHT) {
+                gesture_t g = classify_gesture(bursts[i].samples, bursts[i].count);
+                confusion[label][g]++;
+                total++;
+                if ((int)g == label) {
+                    correct++;
+                    latencySum += decision_latency(&bursts[i], g);
+                }
+            }
+
+            double t0 = now_ns();
+            for (int rep = 0; rep < BENCH_REPEATS; rep++) {
+                sink = classify_gesture(bursts[i].samples, bursts[i].count);
+            }
+            elapsed += now_ns() - t0;
+            datasets += (long)bursts[i].count * BENCH_REPEATS;
+
+            t0 = now_ns();
+            for (int rep = 0; rep < BENCH_REPEATS; rep++) {
+                sink = (gesture_t)classify_ext(&bursts[i]);
+            }
+            elapsedExt += now_ns() - t0;
+            decisions += BENCH_REPEATS;
+        }
+    }
+    (void)sink;
+
+    if (build) {
+        print_templates(sums, counts);
+        return 0;
+    }
+    printf("swipe bursts: %ld  correct: %ld  accuracy: %.1f%%\n", total, correct,
+           total ? 100.0 * correct / total : 0.0);
+    printf("mean decision latency: %.2f datasets (correct bursts only)\n",
+           correct ? (double)latencySum / correct : 0.0);
+    printf("cost: %.1f ns per dataset on this host\n", datasets ? elapsed / datasets : 0.0);
+    printf("extended bursts: %ld  correct: %ld  accuracy: %.1f%%\n", totalExt, correctExt,
+           totalExt ? 100.0 * correctExt / totalExt : 0.0);
+    printf("extended recognizer: %.1f ns per decision on this host (see \"prof\" for target cycles)\n",
+           decisions ? elapsedExt / decisions : 0.0);
+    print_confusion("swipe confusion", confusion, GESTURE_EXT_RIGHT + 1);
+    print_confusion("extended confusion", confusionExt, GESTURE_EXT_COUNT);
+    return 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * log_decode.c
+ *
+ * Description: Host decoder for the firmware's tokenized log (log.c).
+ * Reads the raw USART2 byte stream, rebuilds each log record's text from the message
+ * table in log_ids.h and passes the console's plain text through unchanged.
+ *
+ * Build:
+ *   cc -O2 -I../LED_CUBE/src log_decode.c ../LED_CUBE/src/cobs.c \
+ *      ../LED_CUBE/src/color_classify.c ../LED_CUBE/src/gesture_template.c -o log_decode
+ *
+ * Usage:
+ *   stty -F /dev/ttyACM0 115200 raw && log_decode /dev/ttyACM0
+ *   log_decode < capture.bin
+ *   log_decode -l    lists the message table
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cobs.h"
+#include "log.h"
+#include "color_classify.h"
+#include "gesture_template.h"
+
+#define SEGMENT_MAX 4096
+
+#define LOG_FORMAT_ENTRY(id, fmt) fmt,
+static const char *formats[LOG_ID_COUNT] = {LOG_MESSAGES(LOG_FORMAT_ENTRY)};
+
+#define LOG_NAME_ENTRY(id, fmt) #id,
+static const char *names[LOG_ID_COUNT] = {LOG_MESSAGES(LOG_NAME_ENTRY)};
+
+/**
+ * Reads an unsigned LEB128 varint.
+ *
+ * Returns:
+ * Bytes consumed, or 0 if the data ends first.
+ */
+static size_t get_varint(const unsigned char *in, size_t len, unsigned long *value) {
+    *value = 0;
+    for (size_t i = 0; i < len && i < 5; i++) {
+        *value |= (unsigned long)(in[i] & 0x7F) << (7 * i);
+        if (!(in[i] & 0x80)) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Formats a record's text into out from its arguments.
+ *
+ * Returns:
+ * Number of arguments the format consumed.
+ */
+static int format_record(const char *fmt, const unsigned long *args, int nargs, char *out, size_t size) {
+    size_t n = 0;
+    int used = 0;
+
+    while (*fmt && n + 1 < size) {
+        char spec[16];
+        size_t s = 0;
+        unsigned long v;
+
+        if (*fmt != '%') {
+            out[n++] = *fmt++;
+            continue;
+        }
+        spec[s++] = *fmt++;
+        while (*fmt && strchr("-+ #0123456789", *fmt) && s < sizeof(spec) - 3) {
+            spec[s++] = *fmt++;
+        }
+        while (*fmt == 'l' || *fmt == 'h') {
+            fmt++; // Every argument travels as 32 bits
+        }
+        if (*fmt == '%') {
+            out[n++] = '%';
+            fmt++;
+            continue;
+        }
+        v = (used < nargs) ? args[used] : 0;
+        used++;
+        switch (*fmt) {
+            case 'C':
+                n += snprintf(out + n, size - n, "%s", color_name((PredominantColor)v));
+                break;
+            case 'G':
+                n += snprintf(out + n, size - n, "%s", gesture_ext_name((gesture_ext_t)v));
+                break;
+            case 'd':
+            case 'i':
+                spec[s++] = 'l';
+                spec[s++] = 'd';
+                spec[s] = '\0';
+                n += snprintf(out + n, size - n, spec, (long)(int32_t)v);
+                break;
+            default:
+                spec[s++] = 'l';
+                spec[s++] = *fmt;
+                spec[s] = '\0';
+                n += snprintf(out + n, size - n, spec, v);
+                break;
+        }
+        if (*fmt) {
+            fmt++;
+        }
+        if (n >= size) {
+            n = size - 1;
+        }
+    }
+    out[n] = '\0';
+    return used;
+}
+
+/**
+ * Decodes one delimited segment as a log frame.
+ *
+ * Returns:
+ * 1 if it was a valid record and has been printed, 0 otherwise.
+ */
+static int print_record(const unsigned char *seg, size_t len) {
+    unsigned char raw[SEGMENT_MAX];
+    cobs_decoder_t dec = {0};
+    unsigned long timestamp, args[LOG_ARGS_MAX];
+    size_t n = 0, pos, used;
+    char text[512];
+    int nargs = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        unsigned char b;
+        if (cobs_decode_byte(&dec, seg[i], &b) == COBS_DATA) {
+            raw[n++] = b;
+        }
+    }
+    if (cobs_decode_byte(&dec, COBS_DELIMITER, raw) != COBS_END || n < 3 || raw[0] != LOG_FRAME_EVENT ||
+        raw[1] >= LOG_ID_COUNT) {
+        return 0;
+    }
+    pos = 2;
+    if ((used = get_varint(&raw[pos], n - pos, &timestamp)) == 0) {
+        return 0;
+    }
+    pos += used;
+    while (pos < n && nargs < LOG_ARGS_MAX) {
+        if ((used = get_varint(&raw[pos], n - pos, &args[nargs])) == 0) {
+            return 0;
+        }
+        pos += used;
+        nargs++;
+    }
+    if (pos != n || format_record(formats[raw[1]], args, nargs, text, sizeof(text)) != nargs) {
+        return 0;
+    }
+    printf("[%10lu ms] %s\n", timestamp, text);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    static unsigned char seg[SEGMENT_MAX];
+    FILE *in = stdin;
+    size_t len = 0;
+    int ch;
+
+    if (argc > 1 && strcmp(argv[1], "-l") == 0) {
+        for (int i = 0; i < LOG_ID_COUNT; i++) {
+            printf("%3d %-24s \"%s\"\n", i, names[i], formats[i]);
+        }
+        return 0;
+    }
+    if (argc > 1 && (in = fopen(argv[1], "rb")) == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    while ((ch = fgetc(in)) != EOF) {
+        if (ch != COBS_DELIMITER && len < SEGMENT_MAX) {
+            seg[len++] = (unsigned char)ch;
+            continue;
+        }
+        if (len != 0 && !print_record(seg, len)) {
+            fwrite(seg, 1, len, stdout); // Console text
+        }
+        len = 0;
+        fflush(stdout);
+    }
+    if (len != 0) {
+        fwrite(seg, 1, len, stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * sched_host_test.c
+ *
+ * Description: Host port of the firmware's task scheduler (sched.c) with deterministic
+ * tests. Time is a virtual millisecond counter that only moves when the harness idles or
+ * a task "works", so every run produces the same trace; each scenario's trace is
+ * compared with the expected one.
+ *
+ * Build:
+ *   cc -O2 -I../LED_CUBE/src sched_host_test.c ../LED_CUBE/src/sched.c -o sched_host_test
+ *
+ * Usage:
+ *   sched_host_test
+ *   Exits non-zero if any scenario fails.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "sched.h"
+
+static uint32_t now;
+static char trace[2048];
+static int failures;
+
+/* Port */
+
+uint32_t sched_port_now(void) {
+    return now;
+}
+
+uint32_t sched_port_lock(void) {
+    return 0;
+}
+
+void sched_port_unlock(uint32_t state) {
+    (void)state;
+}
+
+void sched_port_idle(uint32_t idleMs) {
+    (void)idleMs;
+    now++; // SysTick wakes the target every millisecond
+}
+
+/* Harness */
+
+static void note(const char *what) {
+    char entry[32];
+    snprintf(entry, sizeof(entry), "%s@%u ", what, (unsigned)now);
+    strncat(trace, entry, sizeof(trace) - strlen(trace) - 1);
+}
+
+/**
+ * Runs the scheduler as sched_run() does until the virtual clock passes endMs.
+ * Idling advances the clock a millisecond at a time, as SysTick wakes the target, and
+ * calls hook (if any) after each step to model interrupts.
+ */
+static void run_until(uint32_t endMs, void (*hook)(void)) {
+    while (now <= endMs) {
+        sched_run_pending();
+        while (sched_idle_ms() != 0 && now <= endMs) {
+            sched_port_idle(1);
+            if (hook) {
+                hook();
+            }
+        }
+    }
+}
+
+static void reset(void) {
+    for (int id = 0; id < SCHED_MAX_TASKS; id++) {
+        sched_cancel(id);
+    }
+    now = 0;
+    trace[0] = '\0';
+}
+
+static void check(const char *scenario, const char *expected) {
+    if (strcmp(trace, expected) != 0) {
+        printf("%s: FAIL\n  expected: %s\n  got:      %s\n", scenario, expected, trace);
+        failures++;
+    } else {
+        printf("%s: ok\n", scenario);
+    }
+}
+
+/* Tasks */
+
+static void task_a(void) { note("A"); }
+static void task_b(void) { note("B"); }
+static void task_once(void) { note("once"); }
+static void task_event(void) { note("ev"); }
+static void task_slow(void) { note("slow"); now += 25; }
+
+static int rearmCount;
+static void task_rearm(void) {
+    note("rearm");
+    if (++rearmCount < 3) {
+        sched_after("rearm", task_rearm, 7);
+    }
+}
+
+static void signal_at_13(void) {
+    static int done;
+    if (now >= 13 && !done) {
+        done = 1;
+        sched_signal(0x2);
+    }
+}
+
+int main(void) {
+    sched_info_t info;
+    int id;
+
+    // Periodic tasks run in table order at their periods
+    reset();
+    sched_add("a", task_a, 10, 0);
+    sched_add("b", task_b, 25, 0);
+    run_until(50, NULL);
+    check("periodic", "A@0 B@0 A@10 A@20 B@25 A@30 A@40 A@50 B@50 ");
+
+    // A one-shot runs once and frees its slot
+    reset();
+    id = sched_after("once", task_once, 30);
+    sched_add("a", task_a, 20, 0);
+    run_until(60, NULL);
+    check("one-shot", "A@0 A@20 once@30 A@40 A@60 ");
+    if (sched_task_info(id, &info)) {
+        printf("one-shot: FAIL, slot still in use\n");
+        failures++;
+    }
+
+    // One-shots can re-arm themselves
+    reset();
+    rearmCount = 0;
+    sched_after("rearm", task_rearm, 5);
+    run_until(40, NULL);
+    check("re-arm", "rearm@5 rearm@12 rearm@19 ");
+
+    // Event-only tasks run on the next pass after the signal, a mixed task on either
+    reset();
+    sched_add("ev", task_event, 0, 0x2);
+    sched_add("a", task_a, 10, 0);
+    run_until(30, signal_at_13);
+    check("events", "A@0 A@10 ev@13 A@20 A@30 ");
+
+    // A task that overruns skips the missed periods instead of catching up
+    reset();
+    sched_add("slow", task_slow, 10, 0);
+    run_until(80, NULL);
+    check("overrun", "slow@0 slow@25 slow@50 slow@75 ");
+
+    // Re-phasing and period changes
+    reset();
+    id = sched_add("a", task_a, 10, 0);
+    sched_run_pending();
+    sched_restart(id, 3);
+    sched_set_period(id, 20);
+    run_until(45, NULL);
+    check("restart", "A@0 A@3 A@23 A@43 ");
+
+    // Idle time reports the nearest due task, or SCHED_NEVER
+    reset();
+    sched_add("ev", task_event, 0, 0x4);
+    if (sched_idle_ms() != SCHED_NEVER) {
+        printf("idle: FAIL, expected SCHED_NEVER\n");
+        failures++;
+    }
+    sched_after("once", task_once, 17);
+    now = 5;
+    if (sched_idle_ms() != 12) {
+        printf("idle: FAIL, expected 12 got %u\n", (unsigned)sched_idle_ms());
+        failures++;
+    }
+    sched_signal(0x4);
+    if (sched_idle_ms() != 0) {
+        printf("idle: FAIL, expected 0 with an event pending\n");
+        failures++;
+    } else {
+        printf("idle: ok\n");
+    }
+
+    printf(failures ? "FAILED\n" : "OK\n");
+    return failures != 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * telemetry_csv.c
+ *
+ * Description: Host reader for the firmware's binary telemetry (telemetry.c).
+ * Reads the raw USART2 byte stream, decodes the telemetry records and writes one CSV
+ * file per record type. Log records and console text are skipped. Gaps in the sequence
+ * numbers are counted and reported at the end. Gesture trace downloads land in
+ * <prefix>_trace.csv, ready for gesture_replay.
+ *
+ * Build:
+ *   cc -O2 -I../LED_CUBE/src telemetry_csv.c ../LED_CUBE/src/cobs.c -o telemetry_csv
+ *
+ * Usage:
+ *   stty -F /dev/ttyACM0 115200 raw && telemetry_csv /dev/ttyACM0 run1
+ *   telemetry_csv capture.bin run1
+ *   Writes run1_color.csv, run1_gfifo.csv, run1_gesture.csv, run1_timing.csv and
+ *   run1_trace.csv; start the stream on the cube with "telem on". Stop with Ctrl-C on
+ *   a live port.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cobs.h"
+#include "telemetry.h"
+
+#define SEGMENT_MAX 1024
+
+enum { OUT_COLOR, OUT_GFIFO, OUT_GESTURE, OUT_TIMING, OUT_TRACE, OUT_COUNT };
+
+static const char *suffixes[OUT_COUNT] = {"color", "gfifo", "gesture", "timing", "trace"};
+static const char *headers[OUT_COUNT] = {
+    "seq,ms,r,g,b,c,lux,cct,color,classify_cycles",
+    "seq,ms,index,u,d,l,r",
+    "seq,ms,gesture,count",
+    "seq,ms,color_samples,gesture_datasets,uart_dropped,log_dropped",
+    "burst,ms,u,d,l,r",
+};
+
+static FILE *out[OUT_COUNT];
+static unsigned long records, lost;
+static volatile sig_atomic_t stop;
+
+static unsigned get_u16(const unsigned char *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static unsigned long get_u32(const unsigned char *p) {
+    return get_u16(p) | ((unsigned long)get_u16(p + 2) << 16);
+}
+
+/**
+ * Writes one decoded telemetry record; other frames are ignored.
+ */
+static void handle_record(const unsigned char *rec, size_t len) {
+    static int haveSeq;
+    static unsigned lastSeq;
+    const unsigned char *p = rec + 1 + TELEM_HEADER_BYTES;
+    unsigned seq;
+    unsigned long ms;
+
+    if (len == 11 && rec[0] == TELEM_FRAME_TRACE) {
+        // Trace datasets carry no sequence number
+        fprintf(out[OUT_TRACE], "%u,%lu,%u,%u,%u,%u\n", get_u16(rec + 1), get_u32(rec + 3), rec[7], rec[8],
+                rec[9], rec[10]);
+        return;
+    }
+    if (len < 1 + TELEM_HEADER_BYTES || rec[0] < TELEM_FRAME_COLOR || rec[0] > TELEM_FRAME_TIMING) {
+        return;
+    }
+    seq = get_u16(rec + 1);
+    ms = get_u32(rec + 3);
+    len -= 1 + TELEM_HEADER_BYTES;
+
+    switch (rec[0]) {
+        case TELEM_FRAME_COLOR:
+            if (len != 19) return;
+            fprintf(out[OUT_COLOR], "%u,%lu,%u,%u,%u,%u,%lu,%u,%u,%lu\n", seq, ms, get_u16(p), get_u16(p + 2),
+                    get_u16(p + 4), get_u16(p + 6), get_u32(p + 8), get_u16(p + 12), p[14], get_u32(p + 15));
+            break;
+        case TELEM_FRAME_GFIFO:
+            if (len < 1 || len != 1 + 4 * (size_t)p[0]) return;
+            for (int i = 0; i < p[0]; i++) {
+                const unsigned char *s = p + 1 + 4 * i;
+                fprintf(out[OUT_GFIFO], "%u,%lu,%d,%u,%u,%u,%u\n", seq, ms, i, s[0], s[1], s[2], s[3]);
+            }
+            break;
+        case TELEM_FRAME_GESTURE:
+            if (len != 5) return;
+            fprintf(out[OUT_GESTURE], "%u,%lu,%u,%lu\n", seq, ms, p[0], get_u32(p + 1));
+            break;
+        case TELEM_FRAME_TIMING:
+            if (len != 16) return;
+            fprintf(out[OUT_TIMING], "%u,%lu,%lu,%lu,%lu,%lu\n", seq, ms, get_u32(p), get_u32(p + 4),
+                    get_u32(p + 8), get_u32(p + 12));
+            break;
+    }
+    if (haveSeq) {
+        lost += (seq - lastSeq - 1) & 0xFFFF;
+    }
+    haveSeq = 1;
+    lastSeq = seq;
+    records++;
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+int main(int argc, char **argv) {
+    static unsigned char rec[SEGMENT_MAX];
+    cobs_decoder_t dec = {0};
+    size_t len = 0;
+    FILE *in;
+    int ch;
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: telemetry_csv <capture|device> <output prefix>\n");
+        return 2;
+    }
+    if ((in = fopen(argv[1], "rb")) == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    for (int i = 0; i < OUT_COUNT; i++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s_%s.csv", argv[2], suffixes[i]);
+        if ((out[i] = fopen(path, "w")) == NULL) {
+            perror(path);
+            return 1;
+        }
+        fprintf(out[i], "%s\n", headers[i]);
+    }
+    signal(SIGINT, on_signal);
+
+    while (!stop && (ch = fgetc(in)) != EOF) {
+        unsigned char b;
+        switch (cobs_decode_byte(&dec, (unsigned char)ch, &b)) {
+            case COBS_DATA:
+                if (len < SEGMENT_MAX) {
+                    rec[len++] = b;
+                }
+                break;
+            case COBS_END:
+                handle_record(rec, len);
+                len = 0;
+                break;
+            case COBS_ERROR:
+                len = 0; // Console text or a damaged frame
+                break;
+            default:
+                break;
+        }
+    }
+    for (int i = 0; i < OUT_COUNT; i++) {
+        fclose(out[i]);
+    }
+    fprintf(stderr, "%lu records, %lu lost\n", records, lost);
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * uart_brr_check.c
+ *
+ * Description: Host check of the firmware's USART baud rate arithmetic (uart_brr.c).
+ * Every rate from 9600 to 2 Mbaud is computed across several APB1 clock configurations
+ * and compared with the USARTDIV definition in the reference manual; the table shows
+ * the chosen oversampling, BRR and error.
+ *
+ * Build:
+ *   cc -O2 -I../LED_CUBE/src uart_brr_check.c ../LED_CUBE/src/uart_brr.c -lm -o uart_brr_check
+ *
+ * Usage:
+ *   uart_brr_check
+ *   Exits non-zero if any check fails.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include "uart_brr.h"
+
+static const struct {
+    const char *name;
+    uint32_t pclk;
+} clocks[] = {
+    {"HSI 16 MHz, APB1 /1", 16000000},
+    {"HSE 25 MHz, APB1 /1", 25000000},
+    {"PLL 84 MHz, APB1 /2", 42000000},
+    {"PLL 96 MHz, APB1 /2", 48000000},
+    {"PLL 100 MHz, APB1 /2", 50000000},
+};
+
+static const uint32_t bauds[] = {
+    9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600, 1000000, 1500000, 2000000
+};
+
+/**
+ * Reference BRR from the reference manual: USARTDIV = pclk / (8 * (2 - OVER8) * baud),
+ * mantissa in BRR[15:4], fraction in BRR[3:0] (BRR[2:0] with OVER8).
+ */
+static int reference_brr(uint32_t pclk, uint32_t baud, int over8) {
+    double usartdiv = (double)pclk / (8.0 * (2 - over8) * baud);
+    int steps = over8 ? 8 : 16;
+    long scaled = lround(usartdiv * steps);
+    long mantissa = scaled / steps, fraction = scaled % steps;
+
+    if (mantissa < 1 || mantissa > 0xFFF) {
+        return 0;
+    }
+    return (int)((mantissa << 4) | fraction);
+}
+
+int main(void) {
+    int failures = 0;
+
+    // The value the firmware used to hard-code
+    if (uart_brr(16000000, 9600, 0) != 0x683) {
+        printf("FAIL: 9600 baud at 16 MHz gives 0x%X, expected 0x683\n", uart_brr(16000000, 9600, 0));
+        failures++;
+    }
+
+    for (unsigned c = 0; c < sizeof(clocks) / sizeof(clocks[0]); c++) {
+        printf("\n%s\n%10s %6s %7s %10s %9s\n", clocks[c].name, "baud", "over8", "BRR", "actual", "error");
+        for (unsigned b = 0; b < sizeof(bauds) / sizeof(bauds[0]); b++) {
+            uint32_t pclk = clocks[c].pclk, baud = bauds[b];
+            uint16_t brr;
+            int over8;
+
+            for (int mode = 0; mode <= 1; mode++) {
+                if (uart_brr(pclk, baud, mode) != reference_brr(pclk, baud, mode)) {
+                    printf("FAIL: %u baud at %u Hz, over8 %d: 0x%X, reference 0x%X\n", baud, pclk, mode,
+                           uart_brr(pclk, baud, mode), reference_brr(pclk, baud, mode));
+                    failures++;
+                }
+            }
+
+            uint32_t actual = uart_brr_select(pclk, baud, &brr, &over8);
+            if (actual == 0) {
+                printf("%10u %6s %7s %10s %9s\n", baud, "-", "-", "-", "no fit");
+                // Only correct if no divisor at all gets within the tolerance
+                double best = (double)pclk / lround((double)pclk / baud);
+                if (pclk / baud >= 8 && fabs(best - baud) / baud <= UART_BRR_MAX_ERROR_PPM / 1e6) {
+                    printf("FAIL: %u baud at %u Hz rejected\n", baud, pclk);
+                    failures++;
+                }
+                continue;
+            }
+            double error = 100.0 * ((double)pclk / (over8 ? ((brr >> 4) * 8 + (brr & 7)) : brr) - baud) / baud;
+            printf("%10u %6d  0x%04X %10u %8.2f%%\n", baud, over8, brr, actual, error);
+            if (fabs(error) > UART_BRR_MAX_ERROR_PPM / 10000.0 || (over8 && (brr & 0x08))) {
+                printf("FAIL: %u baud at %u Hz out of tolerance or BRR[3] set\n", baud, pclk);
+                failures++;
+            }
+        }
+    }
+
+    printf("\n%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}